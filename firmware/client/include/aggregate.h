@@ -0,0 +1,13 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <Arduino.h>
+#include "message_struct.h"
+
+// Running statistics of the samples taken since the last aggregate frame, kept in RTC memory
+void aggregate_reset();
+float aggregate_add(float humidity, float distance, float temperature, uint16_t luminosity);
+uint8_t aggregate_count();
+void aggregate_fill(SensorAggregateMessage& msg);
+
+#endif // AGGREGATE_H
@@ -0,0 +1,21 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+
+// Settings the gateway can change over the air (ACK_FLAG_CONFIG downlinks). Stored in NVS,
+// read once per power-on and then served from RTC memory, so timer wakes never touch flash.
+struct client_config_t {
+    uint32_t tx_interval_ms;
+    float    humidity_threshold;    // %
+    float    distance_threshold;    // cm
+    uint8_t  readings_per_frame;    // Capped at READINGS_PER_FRAME (RTC buffer size)
+};
+
+extern struct client_config_t client_config;
+
+void config_load();
+bool config_set(uint8_t key, uint32_t value);
+uint32_t config_sample_interval_ms();
+
+#endif // CONFIG_STORE_H
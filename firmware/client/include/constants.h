@@ -35,6 +35,7 @@
 #define LORA_TX_POWER           10          // Transmission power in dBm
 #define LORA_PREAMBLE_LENGTH    8           // Preamble symbols
 #define LORA_MAX_PACKET_SIZE    256         // Maximum LoRa packet size
+#define FRAME_CRC16_ENABLED     true        // CRC-16 frame trailer; false sends the legacy XOR byte (old gateways)
 
 #define BATCH_ON
 #define BATCH_SIZE              5
@@ -47,6 +48,8 @@
 #define BH1750_I2C_ADDRESS      0x23        // BH1750 default I2C address (0x23 or 0x5C)
 #define VL53L0X_I2C_ADDRESS     0x29        // VL53L0X default I2C address
 #define AHT10_I2C_ADDRESS       0x38        // AHT10 default I2C address
+#define AHT10_CONVERSION_MS     80          // AHT10 measurement time after a trigger
+#define SENSOR_READ_TIMEOUT_MS  500         // Give up on a conversion after this long
 
 #define SIM_HUMIDITY_BASE       55.0        // Base humidity value (%)
 #define SIM_HUMIDITY_VARIATION  35.0        // +/- variation range
@@ -57,15 +60,49 @@
 #define SIM_LUMINOSITY_BASE     500.0       // Base luminosity value (lux)
 #define SIM_LUMINOSITY_VARIATION 400.0      // +/- variation range
 
+// Defaults for the settings kept in NVS (config_store), changed over the air by the gateway
 #define TX_INTERVAL_MS          30000       // Time between transmissions (milliseconds)
 #define TX_MAX_RETRIES          3           // Max retry attempts on TX failure
 
+#define LORA_RX_WINDOW_MS       500         // Listen time for a gateway downlink after an uplink
+
+#define LBT_ENABLED             true        // Listen before talk: CAD scan before every transmission
+#define CAD_MAX_ATTEMPTS        4           // Busy scans before transmitting anyway
+#define CAD_BACKOFF_MIN_MS      50          // Random wait after a busy scan
+#define CAD_BACKOFF_MAX_MS      400
+
+#define CONFIRMED_UPLINK_ENABLED false      // Request an ACK per frame, retransmit only when it is missing
+#define CONFIRMED_MAX_ATTEMPTS  3           // Transmissions per confirmed frame, first one included
+#define CONFIRMED_BACKOFF_MIN_MS 200        // Random backoff before a retransmission, doubled per attempt
+#define CONFIRMED_BACKOFF_MAX_MS 1000
+#define ADR_LISTEN_INTERVAL     8           // Open an RX window every N uplinks (ADR commands)
+#define LORA_TX_POWER_MIN       -9          // SX1262 output power range accepted from ADR (dBm)
+#define LORA_TX_POWER_MAX       22
+
 #define ADAPTIVE_TX_ENABLED     true       // Enable/disable adaptive transmission
 #define HUMIDITY_CHANGE_THRESHOLD   2.0     // Min humidity change (%) to trigger TX
 #define DISTANCE_CHANGE_THRESHOLD   10.0    // Min distance change (cm) to trigger TX
 
+#define MULTI_READING_ENABLED   true        // Sample every cycle, send several readings per frame
+#define READINGS_PER_FRAME      6           // Cycles buffered in RTC memory per frame (max 8, NVS default)
+
+#define AGGREGATION_ENABLED     false       // Sample AGGREGATE_SAMPLES times per TX interval, send min/max/mean
+                                            // (needs MULTI_READING_ENABLED false)
+#define AGGREGATE_SAMPLES       6           // Samples per aggregate frame (max 255)
+#define DISTANCE_MEDIAN_WINDOW  5           // Distance samples in the median filter (odd, max 9)
+
 #define DEEP_SLEEP_ENABLED      true       // Use deep sleep between transmissions (DISABLED for USB CDC debug)
-#define DEEP_SLEEP_TIME_US      (TX_INTERVAL_MS * 1000ULL)  // Sleep duration in microseconds
+#define SLEEP_JITTER_MS         3000        // Random +/- offset per sleep so nodes drift apart
+#define SLEEP_JITTER_FRACTION   4           // ... and at most 1/4 of the sleep interval
+#define SLEEP_MIN_MS            1000        // Shortest timer wakeup, whatever the interval and jitter
+#define TX_INTERVAL_MIN_MS      5000        // Shortest TX interval accepted from NVS or a downlink
+
+#define WAKE_ON_EVENT_ENABLED   false       // Wake on VL53L0X distance events; timer wakes only check humidity
+                                            // (needs REAL_SENSORS_ENABLED, MULTI_READING_ENABLED and
+                                            // AGGREGATION_ENABLED false)
+#define VL53L0X_PIN_GPIO1       3           // VL53L0X GPIO1 interrupt output (RTC GPIO, active low)
+#define VL53L0X_EVENT_PERIOD_MS 1000        // VL53L0X autonomous ranging period while the ESP32 sleeps
+#define HEARTBEAT_INTERVAL_MS   600000      // Transmit at least this often in wake-on-event mode
 
 #define REAL_SENSORS_ENABLED    false       // true = real hardware, false = simulation
 
@@ -13,22 +13,38 @@ class LoRaRadio {
           total_tx_packets(0),
           total_tx_success(0),
           total_tx_failed(0),
-          total_tx_skipped(0) {}
+          total_tx_skipped(0),
+          total_rx_downlinks(0),
+          total_tx_acked(0),
+          total_tx_retransmits(0),
+          total_cad_busy(0),
+          total_cad_forced(0),
+          total_collisions(0) {}
 
         uint32_t total_tx_packets;
         uint32_t total_tx_success;
         uint32_t total_tx_failed;
         uint32_t total_tx_skipped;
+        uint32_t total_rx_downlinks;
+        uint32_t total_tx_acked;        // Confirmed frames acknowledged by the gateway
+        uint32_t total_tx_retransmits;  // Retransmissions after a missing ACK
+        uint32_t total_cad_busy;        // CAD scans that found the channel in use
+        uint32_t total_cad_forced;      // Frames sent although every scan was busy
+        uint32_t total_collisions;      // Confirmed frames sent on a clear channel but never ACKed
     };
 
     static LoRaRadio& get_instance();
     void setup();
-    bool transmit(const uint8_t* data, size_t length);
+    void sleep();
+    bool transmit(const uint8_t* data, size_t length, bool open_rx_window = false);
+    bool transmit_confirmed(const uint8_t* data, size_t length, uint16_t sequence);
+    bool rx_window_due();
     void increment_skipped();
     void increment_total();
     bool is_ready() const {
         return ready;
     }
+    int8_t tx_power_dbm() const;    // Reported in every data frame, so the gateway can confirm ADR
     Stats get_stats() const {
         return stats;
     }
@@ -37,6 +53,13 @@ class LoRaRadio {
     LoRaRadio();
     static LoRaRadio* loRaRadio;
     
+    int cold_start();
+    int warm_start();
+    int send_packet(const uint8_t* data, size_t length);
+    bool receive_downlink(AckMessage& ack);
+    void apply_downlink(const AckMessage& ack);
+    void apply_radio_settings(const AckMessage& ack);
+
     SX1262 lora_handler;
     
     Stats stats;
@@ -8,14 +8,29 @@
 
 class Sensors {
   public:
+    // Milliseconds from the start of the conversions until each value was collected
+    struct Timings {
+        uint32_t vl53l0x_ms;
+        uint32_t aht10_ms;
+        uint32_t bh1750_ms;
+        uint32_t total_ms;
+    };
+
     static Sensors& get_instance();
     void setup();
+    void setup_humidity();
     void read_all(float& out_humidity, float& out_distance, float& out_temperature, uint16_t& out_luminosity);
     
-    float get_prev_humidity() const { return prev_humidity; }
-    float get_prev_distance() const { return prev_distance; }
-    void set_prev_humidity(float value) { prev_humidity = value; }
-    void set_prev_distance(float value) { prev_distance = value; }
+    float read_humidity();
+    void arm_distance_event(float distance_cm);
+    
+    float get_prev_humidity() const;
+    float get_prev_distance() const;
+    void set_prev_humidity(float value);
+    void set_prev_distance(float value);
+    const Timings& get_timings() const {
+        return timings;
+    }
 
   private:
     Sensors();
@@ -24,18 +39,24 @@ class Sensors {
     BH1750 lux_sensor;
     VL53L0X distance_sensor;
     Adafruit_AHTX0 aht;
-    float prev_humidity;
-    float prev_distance;
     
     // Sensor initialization status flags
     bool bh1750_initialized;
     bool vl53l0x_initialized;
     bool aht10_initialized;
+    bool i2c_started;
     
-    float read_humidity();
-    float read_distance();
-    float read_temperature();
-    uint16_t read_luminosity();
+    uint32_t conversion_start_ms;
+    Timings timings;
+    
+    void start_i2c();
+    bool scan_i2c_bus();
+    void start_conversions();
+    bool start_aht10();
+    bool read_aht10(float& humidity, float& temperature);
+    void collect_climate(float& humidity, float& temperature);
+    float collect_distance();
+    uint16_t collect_luminosity();
     float generate_simulated_value(float base_value, float variation);
 };
 
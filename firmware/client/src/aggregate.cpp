@@ -0,0 +1,109 @@
+#include "aggregate.h"
+#include "constants.h"
+#include "utils.h"
+
+static_assert(DISTANCE_MEDIAN_WINDOW % 2 == 1 && DISTANCE_MEDIAN_WINDOW <= 9, "DISTANCE_MEDIAN_WINDOW must be odd, max 9");
+
+// Values in their frame encoding (temperature/humidity * 100, distance cm, lux)
+struct RunningStats {
+    int32_t min;
+    int32_t max;
+    int32_t sum;
+};
+
+struct AggregateState {
+    RunningStats temperature;
+    RunningStats humidity;
+    RunningStats distance;
+    RunningStats luminosity;
+    uint8_t count;
+    uint16_t distance_window[DISTANCE_MEDIAN_WINDOW];   // Latest raw distances, oldest overwritten
+    uint8_t window_next;
+    uint8_t window_filled;
+};
+
+RTC_DATA_ATTR static AggregateState state;
+
+static void add_value(RunningStats& stats, int32_t value, bool first) {
+    if (first) {
+        stats.min = value;
+        stats.max = value;
+        stats.sum = 0;
+    }
+    if (value < stats.min) {
+        stats.min = value;
+    }
+    if (value > stats.max) {
+        stats.max = value;
+    }
+    stats.sum += value;
+}
+
+static int32_t mean_of(const RunningStats& stats, uint8_t count) {
+    return (stats.sum + (stats.sum >= 0 ? count / 2 : -(count / 2))) / count;
+}
+
+// Median of the filled part of the window; isolated VL53L0X outliers never reach the statistics
+static uint16_t distance_median() {
+    uint16_t sorted[DISTANCE_MEDIAN_WINDOW];
+    uint8_t n = state.window_filled;
+    for (uint8_t i = 0; i < n; i++) {
+        uint16_t value = state.distance_window[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    return sorted[n / 2];
+}
+
+// The median window spans frames, so it is not cleared with the statistics
+void aggregate_reset() {
+    state.count = 0;
+}
+
+// Adds one sample; returns the median-filtered distance used for the statistics
+float aggregate_add(float humidity, float distance, float temperature, uint16_t luminosity) {
+    state.distance_window[state.window_next] = static_cast<uint16_t>(distance);
+    state.window_next = (state.window_next + 1) % DISTANCE_MEDIAN_WINDOW;
+    if (state.window_filled < DISTANCE_MEDIAN_WINDOW) {
+        state.window_filled++;
+    }
+    uint16_t filtered_distance = distance_median();
+
+    if (state.count == UINT8_MAX) {
+        return filtered_distance;  // Frame overdue; keep the statistics of the first 255 samples
+    }
+    bool first = state.count == 0;
+    add_value(state.temperature, encode_temperature(temperature), first);
+    add_value(state.humidity, encode_humidity(humidity), first);
+    add_value(state.distance, filtered_distance, first);
+    add_value(state.luminosity, luminosity, first);
+    state.count++;
+    return filtered_distance;
+}
+
+uint8_t aggregate_count() {
+    return state.count;
+}
+
+void aggregate_fill(SensorAggregateMessage& msg) {
+    msg.count = state.count;
+    if (state.count == 0) {
+        return;
+    }
+    msg.temperature_min  = state.temperature.min;
+    msg.temperature_max  = state.temperature.max;
+    msg.temperature_mean = mean_of(state.temperature, state.count);
+    msg.humidity_min     = state.humidity.min;
+    msg.humidity_max     = state.humidity.max;
+    msg.humidity_mean    = mean_of(state.humidity, state.count);
+    msg.distance_min     = state.distance.min;
+    msg.distance_max     = state.distance.max;
+    msg.distance_mean    = mean_of(state.distance, state.count);
+    msg.luminosity_min   = state.luminosity.min;
+    msg.luminosity_max   = state.luminosity.max;
+    msg.luminosity_mean  = mean_of(state.luminosity, state.count);
+}
@@ -0,0 +1,106 @@
+#include "config_store.h"
+#include "constants.h"
+#include "message_struct.h"
+#include "utils.h"
+#include <Preferences.h>
+
+#define CONFIG_NAMESPACE        "node"
+
+RTC_DATA_ATTR struct client_config_t client_config = {
+    TX_INTERVAL_MS,
+    HUMIDITY_CHANGE_THRESHOLD,
+    DISTANCE_CHANGE_THRESHOLD,
+    READINGS_PER_FRAME
+};
+RTC_DATA_ATTR static bool config_loaded = false;
+
+// With aggregation each TX interval is split into AGGREGATE_SAMPLES sleeps; each must stay
+// well above the sleep jitter so the wakeup never comes out negative or zero
+static bool tx_interval_valid(uint32_t tx_interval_ms) {
+    if (tx_interval_ms < TX_INTERVAL_MIN_MS || tx_interval_ms > 86400UL * 1000) {
+        return false;
+    }
+#if AGGREGATION_ENABLED
+    return tx_interval_ms / AGGREGATE_SAMPLES >= 2 * SLEEP_JITTER_MS;
+#else
+    return true;
+#endif
+}
+
+void config_load() {
+    if (config_loaded) {
+        return;  // Timer wake: RTC copy is current
+    }
+    config_loaded = true;
+
+    Preferences preferences;
+    if (!preferences.begin(CONFIG_NAMESPACE, true)) {
+        print_log("Config: no stored settings, using defaults\n");
+        return;
+    }
+    client_config.tx_interval_ms = preferences.getUInt("tx_ms", client_config.tx_interval_ms);
+    client_config.humidity_threshold = preferences.getFloat("hum_th", client_config.humidity_threshold);
+    client_config.distance_threshold = preferences.getFloat("dist_th", client_config.distance_threshold);
+    client_config.readings_per_frame = preferences.getUChar("readings", client_config.readings_per_frame);
+    preferences.end();
+
+    // A value the firmware cannot use (e.g. READINGS_PER_FRAME lowered) falls back to the default
+    if (!tx_interval_valid(client_config.tx_interval_ms)) {
+        client_config.tx_interval_ms = TX_INTERVAL_MS;
+    }
+    if (client_config.readings_per_frame < 1 || client_config.readings_per_frame > READINGS_PER_FRAME) {
+        client_config.readings_per_frame = READINGS_PER_FRAME;
+    }
+
+    print_log("Config: TX every %u s | thresholds %.1f%%, %.0f cm | %u readings per frame\n",
+          client_config.tx_interval_ms / 1000, client_config.humidity_threshold,
+          client_config.distance_threshold, client_config.readings_per_frame);
+}
+
+// Validates and stores one setting from a gateway downlink; returns false if rejected
+bool config_set(uint8_t key, uint32_t value) {
+    struct client_config_t updated = client_config;
+    switch (key) {
+    case CONFIG_KEY_TX_INTERVAL_S:
+        if (value > 86400 || !tx_interval_valid(value * 1000)) return false;
+        updated.tx_interval_ms = value * 1000;
+        break;
+    case CONFIG_KEY_HUMIDITY_THRESHOLD:
+        if (value > 10000) return false;
+        updated.humidity_threshold = value / 100.0f;
+        break;
+    case CONFIG_KEY_DISTANCE_THRESHOLD:
+        if (value > 2000) return false;
+        updated.distance_threshold = value;
+        break;
+    case CONFIG_KEY_READINGS_PER_FRAME:
+        if (value < 1 || value > READINGS_PER_FRAME) return false;
+        updated.readings_per_frame = value;
+        break;
+    default:
+        return false;
+    }
+
+    Preferences preferences;
+    if (!preferences.begin(CONFIG_NAMESPACE, false)) {
+        return false;
+    }
+    preferences.putUInt("tx_ms", updated.tx_interval_ms);
+    preferences.putFloat("hum_th", updated.humidity_threshold);
+    preferences.putFloat("dist_th", updated.distance_threshold);
+    preferences.putUChar("readings", updated.readings_per_frame);
+    preferences.end();
+
+    client_config = updated;
+    print_log("Config: key 0x%02X set to %u\n", key, value);
+    return true;
+}
+
+// Time between wakes: with aggregation every TX interval is split into AGGREGATE_SAMPLES wakes
+uint32_t config_sample_interval_ms() {
+#if AGGREGATION_ENABLED
+    return client_config.tx_interval_ms / AGGREGATE_SAMPLES;
+#else
+    return client_config.tx_interval_ms;
+#endif
+}
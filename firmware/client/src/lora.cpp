@@ -1,8 +1,16 @@
 #include "lora.h"
 #include "utils.h"
+#include "config_store.h"
+#include <driver/gpio.h>
 
 LoRaRadio* LoRaRadio::loRaRadio = nullptr;
 
+// Radio settings assigned by the gateway (ADR), kept across deep sleep
+RTC_DATA_ATTR static uint8_t rtc_spreading_factor = LORA_SPREADING_FACTOR;
+RTC_DATA_ATTR static int8_t rtc_tx_power = LORA_TX_POWER;
+RTC_DATA_ATTR static uint8_t uplinks_since_rx_window = ADR_LISTEN_INTERVAL;  // First uplink listens
+RTC_DATA_ATTR static bool rtc_radio_warm = false;   // Radio left in warm sleep by the previous cycle
+
 LoRaRadio& LoRaRadio::get_instance() {
     if (loRaRadio == nullptr) {
         loRaRadio = new LoRaRadio();
@@ -19,8 +27,39 @@ LoRaRadio::LoRaRadio() :
 
 void LoRaRadio::setup() {
   print_log("Initializing LoRa radio at %.1f MHz, SF%d, %d dBm\n", 
-        LORA_FREQUENCY_MHZ, LORA_SPREADING_FACTOR, LORA_TX_POWER);
+        LORA_FREQUENCY_MHZ, rtc_spreading_factor, rtc_tx_power);
+
+  // Pins were held through deep sleep so the radio stayed asleep and configured
+  gpio_hold_dis(static_cast<gpio_num_t>(LORA_PIN_CS));
+  gpio_hold_dis(static_cast<gpio_num_t>(LORA_PIN_RST));
+
+  // Initialize SPI
+  SPI.begin(LORA_PIN_SCK, LORA_PIN_MISO, LORA_PIN_MOSI, LORA_PIN_CS);
+  SPI.setFrequency(2000000);
+
+  int status_code = RADIOLIB_ERR_UNKNOWN;
+  if (rtc_radio_warm) {
+      status_code = warm_start();
+      if (status_code != RADIOLIB_ERR_NONE) {
+          print_log("LoRa warm start failed with error %d, reinitializing\n", status_code);
+      }
+  }
+  if (status_code != RADIOLIB_ERR_NONE) {
+      status_code = cold_start();
+  }
+
+  if (status_code == RADIOLIB_ERR_NONE) {
+      ready = true;
+      print_log("LoRa radio initialized successfully\n");
+  } else {
+      ready = false;
+      rtc_radio_warm = false;
+      print_log("LoRa radio initialization failed with error %d\n", status_code);
+  }
+}
 
+// Power-on path: hardware reset and full begin(), calibrations included
+int LoRaRadio::cold_start() {
   // Hardware reset
   pinMode(LORA_PIN_RST, OUTPUT);
   digitalWrite(LORA_PIN_RST, LOW);
@@ -28,43 +67,89 @@ void LoRaRadio::setup() {
   digitalWrite(LORA_PIN_RST, HIGH);
   delay(10);
 
-  // Initialize SPI
-  SPI.begin(LORA_PIN_SCK, LORA_PIN_MISO, LORA_PIN_MOSI, LORA_PIN_CS);
-  SPI.setFrequency(2000000);
-  delay(100);
-
   int status_code = lora_handler.begin(
       LORA_FREQUENCY_MHZ,
       LORA_BANDWIDTH_KHZ,
-      LORA_SPREADING_FACTOR,
+      rtc_spreading_factor,
       LORA_CODING_RATE,
       LORA_SYNC_WORD,
-      LORA_TX_POWER,
+      rtc_tx_power,
       LORA_PREAMBLE_LENGTH
   );
-
   if (status_code == RADIOLIB_ERR_NONE) {
-      ready = true;
       lora_handler.setCurrentLimit(140);
-      print_log("LoRa radio initialized successfully\n");
-  } else {
-      ready = false;
-      print_log("LoRa radio initialization failed with error %d\n", status_code);
   }
+  return status_code;
+}
+
+// Timer wake path: the SX1262 kept its configuration in warm sleep, so it is woken
+// with a standby command and only the settings RadioLib caches are written again
+int LoRaRadio::warm_start() {
+  lora_handler.getMod()->init();
+
+  int status_code = lora_handler.standby();
+  if (status_code != RADIOLIB_ERR_NONE) {
+      return status_code;
+  }
+
+  status_code = lora_handler.setBandwidth(LORA_BANDWIDTH_KHZ);
+  if (status_code == RADIOLIB_ERR_NONE) {
+      status_code = lora_handler.setSpreadingFactor(rtc_spreading_factor);
+  }
+  if (status_code == RADIOLIB_ERR_NONE) {
+      status_code = lora_handler.setCodingRate(LORA_CODING_RATE);
+  }
+  if (status_code == RADIOLIB_ERR_NONE) {
+      status_code = lora_handler.explicitHeader();
+  }
+  if (status_code == RADIOLIB_ERR_NONE) {
+      status_code = lora_handler.invertIQ(false);
+  }
+  if (status_code == RADIOLIB_ERR_NONE) {
+      status_code = lora_handler.setCRC(true);
+  }
+  if (status_code == RADIOLIB_ERR_NONE) {
+      status_code = lora_handler.setPreambleLength(LORA_PREAMBLE_LENGTH);
+  }
+  return status_code;
+}
+
+// Puts the SX1262 in warm sleep (configuration retained) and holds CS/RST high so the
+// floating pins cannot wake or reset it while the ESP32 is in deep sleep
+void LoRaRadio::sleep() {
+  if (!ready) {
+      return;  // Not started this cycle (or failed): the RTC state is already right
+  }
+  if (lora_handler.sleep(true) != RADIOLIB_ERR_NONE) {
+      rtc_radio_warm = false;
+      return;
+  }
+  rtc_radio_warm = true;
+
+  pinMode(LORA_PIN_RST, OUTPUT);
+  digitalWrite(LORA_PIN_RST, HIGH);
+  digitalWrite(LORA_PIN_CS, HIGH);
+  gpio_hold_en(static_cast<gpio_num_t>(LORA_PIN_CS));
+  gpio_hold_en(static_cast<gpio_num_t>(LORA_PIN_RST));
+  gpio_deep_sleep_hold_en();
 }
 
-bool LoRaRadio::transmit(const uint8_t* data, size_t length) {
+bool LoRaRadio::transmit(const uint8_t* data, size_t length, bool open_rx_window) {
     if (!ready) {
         print_log("Transmission error: LoRa radio not initialized\n");
         return false;
     }
 
     for (int attempt = 1; attempt <= TX_MAX_RETRIES; attempt++) {
-        int result = lora_handler.transmit(const_cast<uint8_t*>(data), length);
+        int result = send_packet(data, length);
         
         if (result == RADIOLIB_ERR_NONE) {
             print_log("Transmission successful\n");
             stats.total_tx_success++;
+            AckMessage ack;
+            if (open_rx_window && receive_downlink(ack)) {
+                apply_downlink(ack);
+            }
             return true;
         }
 
@@ -77,6 +162,137 @@ bool LoRaRadio::transmit(const uint8_t* data, size_t length) {
     return false;
 }
 
+// Transmits one packet; with LBT the channel is scanned (CAD) first and a busy
+// channel defers the transmission by a random backoff
+int LoRaRadio::send_packet(const uint8_t* data, size_t length) {
+#if LBT_ENABLED
+    bool clear = false;
+    for (int scan = 1; scan <= CAD_MAX_ATTEMPTS; scan++) {
+        int cad = lora_handler.scanChannel();
+        if (cad != RADIOLIB_LORA_DETECTED) {
+            clear = true;
+            break;
+        }
+        stats.total_cad_busy++;
+        uint32_t backoff_ms = random(CAD_BACKOFF_MIN_MS, CAD_BACKOFF_MAX_MS);
+        print_log("Channel busy (scan %d), backing off %u ms\n", scan, backoff_ms);
+        delay(backoff_ms);
+    }
+    if (!clear) {
+        stats.total_cad_forced++;
+    }
+#endif
+    return lora_handler.transmit(const_cast<uint8_t*>(data), length);
+}
+
+// Every ADR_LISTEN_INTERVAL uplinks the node listens, so the gateway can adjust its settings
+bool LoRaRadio::rx_window_due() {
+    if (++uplinks_since_rx_window < ADR_LISTEN_INTERVAL) {
+        return false;
+    }
+    uplinks_since_rx_window = 0;
+    return true;
+}
+
+// Sends a frame flagged SENSOR_FLAG_CONFIRMED and waits for its ACK; only a missing ACK
+// triggers a retransmission, after a randomized, growing backoff
+bool LoRaRadio::transmit_confirmed(const uint8_t* data, size_t length, uint16_t sequence) {
+    if (!ready) {
+        print_log("Transmission error: LoRa radio not initialized\n");
+        return false;
+    }
+
+    for (int attempt = 1; attempt <= CONFIRMED_MAX_ATTEMPTS; attempt++) {
+        if (attempt > 1) {
+            uint32_t backoff_ms = random(CONFIRMED_BACKOFF_MIN_MS, CONFIRMED_BACKOFF_MAX_MS) << (attempt - 2);
+            print_log("No ACK for seq %u, retransmitting in %u ms\n", sequence, backoff_ms);
+            delay(backoff_ms);
+            stats.total_tx_retransmits++;
+        }
+
+        int result = send_packet(data, length);
+        if (result != RADIOLIB_ERR_NONE) {
+            print_log("Transmission attempt %d failed with error %d\n", attempt, result);
+            continue;
+        }
+
+        AckMessage ack;
+        if (receive_downlink(ack) && (ack.flags & ACK_FLAG_CONFIRMED) && ack.sequence == sequence) {
+            print_log("Transmission acknowledged (seq %u, attempt %d)\n", sequence, attempt);
+            apply_downlink(ack);
+            stats.total_tx_success++;
+            stats.total_tx_acked++;
+            return true;
+        }
+        // Sent on a clear channel but not heard: most likely a collision at the gateway
+        stats.total_collisions++;
+    }
+
+    print_log("Confirmed transmission of seq %u not acknowledged\n", sequence);
+    stats.total_tx_failed++;
+    return false;
+}
+
+// Listens for up to LORA_RX_WINDOW_MS for a downlink addressed to this node; DIO1 rises on RX done
+bool LoRaRadio::receive_downlink(AckMessage& ack) {
+    bool received = false;
+    uint8_t buffer[LORA_MAX_PACKET_SIZE];
+    lora_handler.startReceive();
+
+    uint32_t start = millis();
+    while (millis() - start < LORA_RX_WINDOW_MS) {
+        if (digitalRead(LORA_PIN_IRQ) == HIGH) {
+            size_t length = lora_handler.getPacketLength();
+            int state = (length > 0 && length <= sizeof(buffer))
+                ? lora_handler.readData(buffer, length) : RADIOLIB_ERR_RX_TIMEOUT;
+            if (state == RADIOLIB_ERR_NONE && protocol_frame_ok<AckMessage>(buffer, length)) {
+                memcpy(&ack, buffer, sizeof(ack));
+                if (ack.client_id == NODE_ID) {
+                    stats.total_rx_downlinks++;
+                    received = true;
+                    break;
+                }
+            }
+            lora_handler.startReceive();
+        }
+        delay(1);
+    }
+    lora_handler.standby();
+    return received;
+}
+
+void LoRaRadio::apply_downlink(const AckMessage& ack) {
+    apply_radio_settings(ack);
+    if ((ack.flags & ACK_FLAG_CONFIG) && !config_set(ack.config_key, ack.config_value)) {
+        print_log("Config downlink rejected: key 0x%02X, value %u\n", ack.config_key, ack.config_value);
+    }
+}
+
+void LoRaRadio::apply_radio_settings(const AckMessage& ack) {
+    if (!(ack.flags & ACK_FLAG_RADIO_SETTINGS)) {
+        return;
+    }
+    if (ack.spreading_factor < 7 || ack.spreading_factor > 12 ||
+        ack.tx_power_dbm < LORA_TX_POWER_MIN || ack.tx_power_dbm > LORA_TX_POWER_MAX) {
+        print_log("ADR settings out of range ignored: SF%u, %d dBm\n", ack.spreading_factor, ack.tx_power_dbm);
+        return;
+    }
+
+    if (ack.spreading_factor != rtc_spreading_factor &&
+        lora_handler.setSpreadingFactor(ack.spreading_factor) == RADIOLIB_ERR_NONE) {
+        rtc_spreading_factor = ack.spreading_factor;
+    }
+    if (ack.tx_power_dbm != rtc_tx_power &&
+        lora_handler.setOutputPower(ack.tx_power_dbm) == RADIOLIB_ERR_NONE) {
+        rtc_tx_power = ack.tx_power_dbm;
+    }
+    print_log("ADR settings applied: SF%u, %d dBm\n", rtc_spreading_factor, rtc_tx_power);
+}
+
+int8_t LoRaRadio::tx_power_dbm() const {
+    return rtc_tx_power;
+}
+
 void LoRaRadio::increment_skipped() {
     stats.total_tx_skipped++;
 }
@@ -6,20 +6,81 @@
 #include "utils.h"
 #include "lora.h"
 #include "sensors.h"
+#include "aggregate.h"
+#include "config_store.h"
+#if WAKE_ON_EVENT_ENABLED
+#include <driver/rtc_io.h>
+#endif
 
 
 // Persisted across deep sleep (stored in RTC memory)
 RTC_DATA_ATTR static uint32_t boot_count = 0;
+RTC_DATA_ATTR static uint16_t tx_sequence = 0;    // Next frame sequence number, lets the gateway count losses
+RTC_DATA_ATTR static uint16_t last_awake_ms = 0;  // Wake-to-sleep time of the previous cycle, reported in frames
+
+#if WAKE_ON_EVENT_ENABLED
+#if !REAL_SENSORS_ENABLED || MULTI_READING_ENABLED || AGGREGATION_ENABLED
+#error "WAKE_ON_EVENT_ENABLED needs REAL_SENSORS_ENABLED, MULTI_READING_ENABLED and AGGREGATION_ENABLED false"
+#endif
+#define HEARTBEAT_WAKES (HEARTBEAT_INTERVAL_MS / client_config.tx_interval_ms)
+RTC_DATA_ATTR static uint16_t wakes_since_tx = 0;  // Timer wakes that ended without a transmission
+#endif
+
+#if MULTI_READING_ENABLED && AGGREGATION_ENABLED
+#error "MULTI_READING_ENABLED and AGGREGATION_ENABLED are mutually exclusive"
+#endif
+
+#if MULTI_READING_ENABLED
+static_assert(READINGS_PER_FRAME <= SENSOR_BATCH_MAX_READINGS, "READINGS_PER_FRAME too large");
 
+struct BufferedReading {
+    int16_t temperature;
+    uint16_t humidity;
+    uint16_t distance_cm;
+    uint16_t luminosity_lux;
+};
+RTC_DATA_ATTR static BufferedReading buffered_readings[READINGS_PER_FRAME];
+RTC_DATA_ATTR static uint8_t buffered_count = 0;
+#endif
+
+
+#if WAKE_ON_EVENT_ENABLED
+// Wakes other than the timer (VL53L0X event, power-on) always run the full cycle; a timer
+// wake only reads the AHT10 unless the heartbeat is due
+static bool event_cycle_due() {
+    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+    if (wakeup_reason != ESP_SLEEP_WAKEUP_TIMER) {
+        return true;
+    }
+    if (++wakes_since_tx >= HEARTBEAT_WAKES) {
+        return true;
+    }
+    float humidity = Sensors::get_instance().read_humidity();
+    return fabsf(humidity - Sensors::get_instance().get_prev_humidity()) > client_config.humidity_threshold;
+}
+#endif
 
+static bool threshold_crossed(float humidity, float distance);
 static bool should_transmit(float humidity, float distance);
 static bool transmit_sensor_data(float humidity, float distance, float temperature, uint16_t luminosity);
+#if MULTI_READING_ENABLED
+static bool buffer_reading(float humidity, float distance, float temperature, uint16_t luminosity);
+static bool transmit_buffered_readings();
+#endif
+#if AGGREGATION_ENABLED
+static bool transmit_aggregate();
+#endif
 
+#if WAKE_ON_EVENT_ENABLED
+static bool event_cycle_due();
+#endif
+static void start_devices();
 static void enter_deep_sleep();
 
 static void print_statistics();
 
 void setup() {
+#ifdef DEBUG
     Serial.begin(SERIAL_BAUD_RATE);
     
     // Wait for USB CDC to be ready (important for ESP32-S3)
@@ -28,8 +89,10 @@ void setup() {
         delay(10);
     }
     delay(500);  // Extra delay for stability
+#endif
     
     boot_count++;
+    config_load();
     
     // Check wakeup reason
     esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
@@ -41,6 +104,9 @@ void setup() {
         case ESP_SLEEP_WAKEUP_TIMER:
             print_log("Wakeup caused by timer (from deep sleep)\n");
             break;
+        case ESP_SLEEP_WAKEUP_EXT1:
+            print_log("Wakeup caused by VL53L0X distance event\n");
+            break;
         case ESP_SLEEP_WAKEUP_UNDEFINED:
         default:
             print_log("Wakeup caused by reset or power-on\n");
@@ -48,7 +114,16 @@ void setup() {
     }
     print_log("========================================\n");
 
-    LoRaRadio::get_instance().setup();
+#if WAKE_ON_EVENT_ENABLED
+    // The other sensors are started by loop() only when the wake needs a full cycle
+    Sensors::get_instance().setup_humidity();
+#else
+    start_devices();
+#endif
+}
+
+// The radio is not started here: send_frame() starts it, so wakes that only sample skip it
+static void start_devices() {
     Sensors::get_instance().setup();
 
     // Store initial readings on first boot
@@ -63,6 +138,16 @@ void setup() {
 }
 
 void loop() {
+#if WAKE_ON_EVENT_ENABLED
+    if (!event_cycle_due()) {
+        print_log("No distance event, humidity unchanged (%u/%u wakes to heartbeat)\n",
+              wakes_since_tx, HEARTBEAT_WAKES);
+        enter_deep_sleep();
+    }
+    wakes_since_tx = 0;
+    start_devices();
+#endif
+
     float humidity, distance, temperature;
     uint16_t luminosity;
     Sensors::get_instance().read_all(humidity, distance, temperature, luminosity);
@@ -72,9 +157,47 @@ void loop() {
     print_log("Humidity %.1f%%, distance %.0fcm, temperature %.1f°C, luminosity %u lux, presence %s\n", 
           humidity, distance, temperature, luminosity, presence_detected ? "detected" : "not detected");
     
-    bool should_send = true;
+#if MULTI_READING_ENABLED
+    // Sample every cycle; transmit once the frame is full, or early on a significant change
+    bool frame_full = buffer_reading(humidity, distance, temperature, luminosity);
+    bool should_send = frame_full || boot_count == 1;
+#if ADAPTIVE_TX_ENABLED
+    should_send = should_send || threshold_crossed(humidity, distance);
+#endif
 
+    if (should_send) {
+        if (transmit_buffered_readings()) {
+            Sensors::get_instance().set_prev_humidity(humidity);
+            Sensors::get_instance().set_prev_distance(distance);
+        }
+    } else {
+        print_log("Reading buffered (%u/%u)\n", buffered_count, client_config.readings_per_frame);
+        LoRaRadio::get_instance().increment_skipped();
+    }
+#elif AGGREGATION_ENABLED
+    // Sample every wake; thresholds are checked against the median-filtered distance so a
+    // single noisy VL53L0X range does not trigger a frame
+    float filtered_distance = aggregate_add(humidity, distance, temperature, luminosity);
+    bool should_send = aggregate_count() >= AGGREGATE_SAMPLES || boot_count == 1;
 #if ADAPTIVE_TX_ENABLED
+    should_send = should_send || threshold_crossed(humidity, filtered_distance);
+#endif
+
+    if (should_send) {
+        if (transmit_aggregate()) {
+            Sensors::get_instance().set_prev_humidity(humidity);
+            Sensors::get_instance().set_prev_distance(filtered_distance);
+        }
+    } else {
+        print_log("Sample aggregated (%u/%u), filtered distance %.0fcm\n",
+              aggregate_count(), AGGREGATE_SAMPLES, filtered_distance);
+        LoRaRadio::get_instance().increment_skipped();
+    }
+#else
+    bool should_send = true;
+
+    // In wake-on-event mode event_cycle_due() already decided to send
+#if ADAPTIVE_TX_ENABLED && !WAKE_ON_EVENT_ENABLED
     should_send = should_transmit(humidity, distance);
     if (!should_send) {
         print_log("Skipping transmission, values unchanged\n");
@@ -88,38 +211,85 @@ void loop() {
             Sensors::get_instance().set_prev_distance(distance);
         }
     }
+#endif
 
     LoRaRadio::get_instance().increment_total();
 
     print_statistics();
 
+#if WAKE_ON_EVENT_ENABLED
+    Sensors::get_instance().arm_distance_event(distance);
+#endif
+
 #if DEEP_SLEEP_ENABLED
-    print_log("Deep sleep mode starting for %d seconds\n", TX_INTERVAL_MS / 1000);
-    delay(50);
+    print_log("Deep sleep mode starting for %u seconds\n", config_sample_interval_ms() / 1000);
     enter_deep_sleep();
 #else
-    delay(TX_INTERVAL_MS);
+    delay(config_sample_interval_ms());
 #endif
 }
 
-static bool should_transmit(float humidity, float distance) {
-    if (boot_count == 1) {
+static bool threshold_crossed(float humidity, float distance) {
+    if (fabsf(humidity - Sensors::get_instance().get_prev_humidity()) > client_config.humidity_threshold) {
         return true;
     }
     
-    if (boot_count % 10 == 0) {
+    if (fabsf(distance - Sensors::get_instance().get_prev_distance()) > client_config.distance_threshold) {
         return true;
     }
     
-    if (fabsf(humidity - Sensors::get_instance().get_prev_humidity()) > HUMIDITY_CHANGE_THRESHOLD) {
+    return false;
+}
+
+static bool should_transmit(float humidity, float distance) {
+    if (boot_count == 1) {
         return true;
     }
     
-    if (fabsf(distance - Sensors::get_instance().get_prev_distance()) > DISTANCE_CHANGE_THRESHOLD) {
+    if (boot_count % 10 == 0) {
         return true;
     }
     
-    return false;
+    return threshold_crossed(humidity, distance);
+}
+
+// Battery level for every frame type. Placeholder: the board has no battery ADC wired yet,
+// so every node reports a full charge and low-battery alerts never fire for real nodes.
+static uint8_t read_battery_percent() {
+    // TODO: implement battery monitoring
+    return 100;
+}
+
+// Flags for the next frame; tx_sequence must still hold its first sequence number
+static uint8_t frame_flags(bool listen) {
+    uint8_t flags = (tx_sequence == 0) ? SENSOR_FLAG_SEQUENCE_RESTART : 0;
+    if (listen) {
+        flags |= SENSOR_FLAG_RX_WINDOW;
+    }
+#if CONFIRMED_UPLINK_ENABLED
+    flags |= SENSOR_FLAG_CONFIRMED;
+#endif
+    flags |= encode_tx_power(LoRaRadio::get_instance().tx_power_dbm());
+    return flags;
+}
+
+// Seals a frame laid out as its struct with the trailer and sends it.
+// Confirmed frames are acknowledged with their last sequence number
+static bool send_frame(const uint8_t* message, size_t legacy_length, uint16_t last_sequence, bool listen) {
+    static bool radio_started = false;
+    if (!radio_started) {
+        radio_started = true;
+        LoRaRadio::get_instance().setup();
+    }
+
+    uint8_t frame[LORA_MAX_PACKET_SIZE];
+    memcpy(frame, message, legacy_length);
+    size_t length = protocol_seal(frame, legacy_length, FRAME_CRC16_ENABLED ? FRAME_TRAILER_CRC16 : FRAME_TRAILER_XOR);
+#if CONFIRMED_UPLINK_ENABLED
+    return LoRaRadio::get_instance().transmit_confirmed(frame, length, last_sequence);
+#else
+    return LoRaRadio::get_instance().transmit(frame, length, listen);
+#endif
 }
 
 static bool transmit_sensor_data(float humidity, float distance, float temperature, uint16_t luminosity) {
@@ -131,23 +301,157 @@ static bool transmit_sensor_data(float humidity, float distance, float temperatu
     msg.temperature   = encode_temperature(temperature);
     msg.humidity      = encode_humidity(humidity);
     msg.distance_cm   = static_cast<uint16_t>(distance);
-    msg.battery       = 100;  // TODO: implement battery monitoring
+    msg.battery       = read_battery_percent();
     msg.luminosity_lux = luminosity;
-    msg.reserved      = 0;
-    msg.checksum      = calculate_checksum(reinterpret_cast<uint8_t*>(&msg), sizeof(msg));
+    msg.sequence      = tx_sequence;
+    bool listen       = LoRaRadio::get_instance().rx_window_due();
+    msg.flags         = frame_flags(listen);
+    msg.awake_ms      = last_awake_ms;
+    tx_sequence++;
+
+    return send_frame(reinterpret_cast<uint8_t*>(&msg), sizeof(msg), msg.sequence, listen);
+}
+
+#if MULTI_READING_ENABLED
+static bool delta_fits(int32_t delta, int32_t min_value, int32_t max_value) {
+    return delta >= min_value && delta <= max_value;
+}
+
+// Appends a reading to the RTC buffer; returns true when the frame is full
+static bool buffer_reading(float humidity, float distance, float temperature, uint16_t luminosity) {
+    BufferedReading reading;
+    reading.temperature    = encode_temperature(temperature);
+    reading.humidity       = encode_humidity(humidity);
+    reading.distance_cm    = static_cast<uint16_t>(distance);
+    reading.luminosity_lux = luminosity;
+
+    if (buffered_count > 0) {
+        // Deltas are taken against the first reading; one that does not fit starts a new frame
+        const BufferedReading& first = buffered_readings[0];
+        int32_t temperature_step = (reading.temperature - first.temperature) / SENSOR_BATCH_DELTA_SCALE;
+        int32_t humidity_step = (reading.humidity - first.humidity) / SENSOR_BATCH_DELTA_SCALE;
+        if (!delta_fits(temperature_step, INT8_MIN, INT8_MAX) ||
+            !delta_fits(humidity_step, INT8_MIN, INT8_MAX) ||
+            !delta_fits(reading.distance_cm - first.distance_cm, INT16_MIN, INT16_MAX) ||
+            !delta_fits(reading.luminosity_lux - first.luminosity_lux, INT16_MIN, INT16_MAX)) {
+            print_log("Reading delta out of range, sending buffered readings first\n");
+            transmit_buffered_readings();
+        }
+    }
+
+    buffered_readings[buffered_count++] = reading;
+    return buffered_count >= client_config.readings_per_frame;
+}
+
+// Sends the buffered readings as one MSG_TYPE_SENSOR_BATCH frame (or a plain reading if only one)
+static bool transmit_buffered_readings() {
+    if (buffered_count == 0) {
+        return true;
+    }
+
+    if (buffered_count == 1) {
+        const BufferedReading& only = buffered_readings[0];
+        buffered_count = 0;
+        return transmit_sensor_data(
+            decode_humidity(only.humidity),
+            only.distance_cm,
+            decode_temperature(only.temperature),
+            only.luminosity_lux
+        );
+    }
+
+    uint8_t frame[SENSOR_BATCH_FRAME_SIZE(SENSOR_BATCH_MAX_READINGS)];
+    const BufferedReading& first = buffered_readings[0];
 
-    return LoRaRadio::get_instance().transmit(reinterpret_cast<uint8_t*>(&msg), sizeof(msg));
+    SensorBatchHeader header;
+    header.msg_type       = MSG_TYPE_SENSOR_BATCH;
+    header.client_id      = NODE_ID;
+    header.timestamp      = millis();
+    header.sequence       = tx_sequence;
+    bool listen           = LoRaRadio::get_instance().rx_window_due();
+    header.flags          = frame_flags(listen);
+    header.count          = buffered_count;
+    header.interval_s     = config_sample_interval_ms() / 1000;
+    header.temperature    = first.temperature;
+    header.humidity       = first.humidity;
+    header.distance_cm    = first.distance_cm;
+    header.luminosity_lux = first.luminosity_lux;
+    header.battery        = read_battery_percent();
+    header.awake_ms       = last_awake_ms;
+    memcpy(frame, &header, sizeof(header));
+
+    for (uint8_t i = 1; i < buffered_count; i++) {
+        const BufferedReading& reading = buffered_readings[i];
+        SensorBatchRecord record;
+        record.temperature_delta = (reading.temperature - first.temperature) / SENSOR_BATCH_DELTA_SCALE;
+        record.humidity_delta    = (reading.humidity - first.humidity) / SENSOR_BATCH_DELTA_SCALE;
+        record.distance_delta    = reading.distance_cm - first.distance_cm;
+        record.luminosity_delta  = reading.luminosity_lux - first.luminosity_lux;
+        memcpy(frame + sizeof(header) + (i - 1) * sizeof(record), &record, sizeof(record));
+    }
+
+    size_t length = SENSOR_BATCH_FRAME_SIZE(buffered_count);
+
+    print_log("Sending %u buffered readings in one frame (%u bytes)\n", buffered_count, length);
+    // Each reading consumes a sequence number, so the gateway accounts for them one by one
+    uint16_t last_sequence = tx_sequence + buffered_count - 1;
+    tx_sequence += buffered_count;
+    buffered_count = 0;
+
+    return send_frame(frame, length, last_sequence, listen);
 }
+#endif
+
+#if AGGREGATION_ENABLED
+// Sends the statistics of the samples aggregated since the last frame
+static bool transmit_aggregate() {
+    SensorAggregateMessage msg;
+    msg.msg_type   = MSG_TYPE_SENSOR_AGGREGATE;
+    msg.client_id  = NODE_ID;
+    msg.timestamp  = millis();
+    msg.sequence   = tx_sequence;
+    bool listen    = LoRaRadio::get_instance().rx_window_due();
+    msg.flags      = frame_flags(listen);
+    msg.interval_s = config_sample_interval_ms() / 1000;
+    aggregate_fill(msg);
+    msg.battery    = read_battery_percent();
+    msg.awake_ms   = last_awake_ms;
+    tx_sequence++;
+    aggregate_reset();
+
+    print_log("Sending aggregate of %u samples\n", msg.count);
+    return send_frame(reinterpret_cast<uint8_t*>(&msg), sizeof(msg), msg.sequence, listen);
+}
+#endif
 
 static void enter_deep_sleep() {
-    Serial.flush();  // Ensure all serial data is sent before sleeping
-    delay(100);      // Give time for serial to finish
-    
-    esp_sleep_enable_timer_wakeup(DEEP_SLEEP_TIME_US);
+    LoRaRadio::get_instance().sleep();
+
+    // Random jitter keeps nodes that booted together from sharing the same TX slot forever;
+    // bounded by the interval, so a short one cannot turn the wakeup negative
+    int64_t interval_ms = config_sample_interval_ms();
+    int64_t jitter_ms = interval_ms / SLEEP_JITTER_FRACTION;
+    if (jitter_ms > SLEEP_JITTER_MS) {
+        jitter_ms = SLEEP_JITTER_MS;
+    }
+    int64_t sleep_ms = interval_ms + random(static_cast<long>(-jitter_ms), static_cast<long>(jitter_ms + 1));
+    if (sleep_ms < SLEEP_MIN_MS) {
+        sleep_ms = SLEEP_MIN_MS;
+    }
+    esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(sleep_ms) * 1000ULL);
+#if WAKE_ON_EVENT_ENABLED
+    // VL53L0X GPIO1 is open drain, pulled up in the RTC domain so it holds through sleep
+    rtc_gpio_pullup_en(static_cast<gpio_num_t>(VL53L0X_PIN_GPIO1));
+    rtc_gpio_pulldown_dis(static_cast<gpio_num_t>(VL53L0X_PIN_GPIO1));
+    esp_sleep_enable_ext1_wakeup(1ULL << VL53L0X_PIN_GPIO1, ESP_EXT1_WAKEUP_ANY_LOW);
+#endif
     
-    print_log("Entering deep sleep now...\n");
-    Serial.flush();
-    delay(100);
+    uint32_t awake_ms = millis();
+    last_awake_ms = awake_ms > UINT16_MAX ? UINT16_MAX : awake_ms;
+    print_log("Entering deep sleep now, awake for %u ms\n", awake_ms);
+#ifdef DEBUG
+    Serial.flush();  // Ensure all serial data is sent before sleeping
+#endif
     
     esp_deep_sleep_start();
 }
@@ -161,4 +465,12 @@ static void print_statistics() {
               lora_stats.total_tx_packets, lora_stats.total_tx_success, lora_stats.total_tx_failed, 
               lora_stats.total_tx_skipped, success_rate);
     }
+#if CONFIRMED_UPLINK_ENABLED
+    print_log("Confirmed uplink: %u acknowledged, %u retransmissions, %u presumed collisions\n",
+          lora_stats.total_tx_acked, lora_stats.total_tx_retransmits, lora_stats.total_collisions);
+#endif
+#if LBT_ENABLED
+    print_log("Listen before talk: %u busy scans, %u forced transmissions\n",
+          lora_stats.total_cad_busy, lora_stats.total_cad_forced);
+#endif
 }
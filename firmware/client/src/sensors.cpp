@@ -1,11 +1,22 @@
 #include "sensors.h"
 #include "constants.h"
 #include "utils.h"
+#include "config_store.h"
 #include <Wire.h>
 #include <math.h>
 
 Sensors* Sensors::instance = nullptr;
 
+// Last transmitted values, compared against on every wake
+RTC_DATA_ATTR static float prev_humidity = 0.0f;
+RTC_DATA_ATTR static float prev_distance = 0.0f;
+
+#if REAL_SENSORS_ENABLED
+// Result of the power-on I2C scan, reused on timer wakes instead of probing 126 addresses again
+RTC_DATA_ATTR static bool i2c_scan_done = false;
+RTC_DATA_ATTR static bool bh1750_present = false;
+#endif
+
 Sensors& Sensors::get_instance() {
     if (instance == nullptr) {
         instance = new Sensors();
@@ -15,46 +26,44 @@ Sensors& Sensors::get_instance() {
 
 Sensors::Sensors() :
     lux_sensor(BH1750_I2C_ADDRESS),
-    prev_humidity(0.0f),
-    prev_distance(0.0f),
     bh1750_initialized(false),
     vl53l0x_initialized(false),
-    aht10_initialized(false) {
+    aht10_initialized(false),
+    i2c_started(false),
+    conversion_start_ms(0),
+    timings() {
     // Constructors for VL53L0X and AHTX0 are called automatically
 }
 
+float Sensors::get_prev_humidity() const {
+    return prev_humidity;
+}
+
+float Sensors::get_prev_distance() const {
+    return prev_distance;
+}
+
+void Sensors::set_prev_humidity(float value) {
+    prev_humidity = value;
+}
+
+void Sensors::set_prev_distance(float value) {
+    prev_distance = value;
+}
+
 void Sensors::setup() {
 #if REAL_SENSORS_ENABLED
-    // Initialize I2C bus
-    Wire.begin(PIN_I2C_SDA, PIN_I2C_SCL);
-    delay(100);  // Give I2C time to initialize
-    
-    // Scan I2C bus to find connected devices
-    print_log("Scanning I2C bus...\n");
-    byte error, address;
-    int nDevices = 0;
-    bool bh1750_at_0x23 = false;
-    bool bh1750_at_0x5C = false;
+    start_i2c();
     
-    for(address = 1; address < 127; address++) {
-        Wire.beginTransmission(address);
-        error = Wire.endTransmission();
-        if (error == 0) {
-            print_log("I2C device found at address 0x%02X\n", address);
-            nDevices++;
-            if (address == 0x23) bh1750_at_0x23 = true;
-            if (address == 0x5C) bh1750_at_0x5C = true;
-        }
-    }
-    if (nDevices == 0) {
-        print_log("No I2C devices found! Check wiring.\n");
-    } else {
-        print_log("Found %d I2C device(s)\n", nDevices);
+    if (!i2c_scan_done) {
+        bh1750_present = scan_i2c_bus();
+        i2c_scan_done = true;
     }
     
-    // Initialize BH1750 luminosity sensor
-    if (bh1750_at_0x23 || bh1750_at_0x5C) {
-        bh1750_initialized = lux_sensor.begin(BH1750::CONTINUOUS_HIGH_RES_MODE);
+    // Sensors are started back to back: the first BH1750 conversion (~120 ms) runs while
+    // the VL53L0X and AHT10 are being initialized
+    if (bh1750_present) {
+        bh1750_initialized = lux_sensor.begin(BH1750::ONE_TIME_HIGH_RES_MODE);
         if (bh1750_initialized) {
             print_log("BH1750 luminosity sensor initialized\n");
         } else {
@@ -66,7 +75,10 @@ void Sensors::setup() {
     }
     
     // Initialize VL53L0X distance sensor
-    distance_sensor.setTimeout(500);
+    distance_sensor.setTimeout(SENSOR_READ_TIMEOUT_MS);
+#if WAKE_ON_EVENT_ENABLED
+    distance_sensor.writeReg(VL53L0X::SYSRANGE_START, 0x01);  // Stop the ranging left running by arm_distance_event()
+#endif
     vl53l0x_initialized = distance_sensor.init();
     if (vl53l0x_initialized) {
         distance_sensor.startContinuous();
@@ -75,6 +87,22 @@ void Sensors::setup() {
         print_log("Warning: VL53L0X initialization failed - will return empty data\n");
     }
     
+    setup_humidity();
+    
+    print_log("Hardware sensors setup complete\n");
+#else
+    setup_humidity();
+#endif
+}
+
+// AHT10 only: enough for the humidity check of a wake-on-event timer wake
+void Sensors::setup_humidity() {
+#if REAL_SENSORS_ENABLED
+    if (aht10_initialized) {
+        return;
+    }
+    start_i2c();
+    
     // Initialize AHT10 temperature/humidity sensor
     aht10_initialized = aht.begin();
     if (aht10_initialized) {
@@ -82,8 +110,6 @@ void Sensors::setup() {
     } else {
         print_log("Warning: AHT10 initialization failed - will return empty data\n");
     }
-    
-    print_log("Hardware sensors setup complete\n");
 #else
     // Initialize random seed for simulation mode using ESP32 hardware RNG
     randomSeed(esp_random());
@@ -91,11 +117,93 @@ void Sensors::setup() {
 #endif
 }
 
+#if REAL_SENSORS_ENABLED
+// Initialize I2C bus; every sensor on it supports fast mode
+void Sensors::start_i2c() {
+    if (i2c_started) {
+        return;
+    }
+    Wire.begin(PIN_I2C_SDA, PIN_I2C_SCL);
+    Wire.setClock(400000);
+    i2c_started = true;
+}
+#endif
+
+#if REAL_SENSORS_ENABLED
+// Probes the whole bus once per power-on; returns whether a BH1750 answered
+bool Sensors::scan_i2c_bus() {
+    print_log("Scanning I2C bus...\n");
+    byte error, address;
+    int nDevices = 0;
+    bool bh1750_found = false;
+    
+    for(address = 1; address < 127; address++) {
+        Wire.beginTransmission(address);
+        error = Wire.endTransmission();
+        if (error == 0) {
+            print_log("I2C device found at address 0x%02X\n", address);
+            nDevices++;
+            if (address == 0x23 || address == 0x5C) bh1750_found = true;
+        }
+    }
+    if (nDevices == 0) {
+        print_log("No I2C devices found! Check wiring.\n");
+    } else {
+        print_log("Found %d I2C device(s)\n", nDevices);
+    }
+    return bh1750_found;
+}
+#endif
+
+// Leaves the VL53L0X ranging on its own every VL53L0X_EVENT_PERIOD_MS while the ESP32 sleeps;
+// GPIO1 goes low once a range falls outside distance_cm +/- the distance threshold
+void Sensors::arm_distance_event(float distance_cm) {
+#if REAL_SENSORS_ENABLED
+    if (!vl53l0x_initialized) {
+        return;
+    }
+    
+    // Threshold registers hold millimeters / 2
+    float low_mm = (distance_cm - client_config.distance_threshold) * 10.0f;
+    float high_mm = (distance_cm + client_config.distance_threshold) * 10.0f;
+    uint16_t low = static_cast<uint16_t>(constrain(low_mm, 0.0f, 8190.0f) / 2);
+    uint16_t high = static_cast<uint16_t>(constrain(high_mm, 0.0f, 8190.0f) / 2);
+    
+    distance_sensor.stopContinuous();
+    distance_sensor.writeReg16Bit(VL53L0X::SYSTEM_THRESH_LOW, low);
+    distance_sensor.writeReg16Bit(VL53L0X::SYSTEM_THRESH_HIGH, high);
+    distance_sensor.writeReg(VL53L0X::SYSTEM_INTERRUPT_CONFIG_GPIO, 0x03);  // Out of window
+    distance_sensor.writeReg(VL53L0X::SYSTEM_INTERRUPT_CLEAR, 0x01);
+    distance_sensor.startContinuous(VL53L0X_EVENT_PERIOD_MS);
+    print_log("VL53L0X armed: wake outside %.0f-%.0f mm\n", low * 2.0f, high * 2.0f);
+#endif
+}
+
+// One measurement per physical sensor: every conversion is started first and the results are
+// collected fastest first, so a read costs the slowest sensor instead of the sum of all four
 void Sensors::read_all(float& out_humidity, float& out_distance, float& out_temperature, uint16_t& out_luminosity) {
-    out_humidity = read_humidity();
-    out_distance = read_distance();
-    out_temperature = read_temperature();
-    out_luminosity = read_luminosity();
+#if REAL_SENSORS_ENABLED
+    start_conversions();
+    
+    out_distance = collect_distance();
+    timings.vl53l0x_ms = millis() - conversion_start_ms;
+    collect_climate(out_humidity, out_temperature);
+    timings.aht10_ms = millis() - conversion_start_ms;
+    out_luminosity = collect_luminosity();
+    timings.bh1750_ms = millis() - conversion_start_ms;
+    timings.total_ms = timings.bh1750_ms;
+    
+    print_log("Sensor timings: VL53L0X %u ms, AHT10 %u ms, BH1750 %u ms, total %u ms\n",
+          timings.vl53l0x_ms, timings.aht10_ms, timings.bh1750_ms, timings.total_ms);
+#else
+    out_humidity = generate_simulated_value(SIM_HUMIDITY_BASE, SIM_HUMIDITY_VARIATION);
+    out_distance = generate_simulated_value(SIM_DISTANCE_BASE, SIM_DISTANCE_VARIATION);
+    out_temperature = generate_simulated_value(SIM_TEMPERATURE_BASE, SIM_TEMPERATURE_VARIATION);
+    out_luminosity = static_cast<uint16_t>(constrain(
+        generate_simulated_value(SIM_LUMINOSITY_BASE, SIM_LUMINOSITY_VARIATION), 0.0f, 65535.0f));
+    print_log("[SIM] Humidity: %.1f%%, distance: %.1f cm, temperature: %.1f C, luminosity: %u lux\n",
+          out_humidity, out_distance, out_temperature, out_luminosity);
+#endif
     
     // Ensure values are within valid ranges
     out_humidity = constrain(out_humidity, 0.0f, 100.0f);
@@ -103,19 +211,16 @@ void Sensors::read_all(float& out_humidity, float& out_distance, float& out_temp
     out_temperature = constrain(out_temperature, -40.0f, 80.0f);
 }
 
+// AHT10 alone, e.g. for the humidity check of a wake-on-event timer wake
 float Sensors::read_humidity() {
 #if REAL_SENSORS_ENABLED
-    if (!aht10_initialized) {
-        return 0.0f;  // Sensor not connected, return empty value
-    }
-    
-    sensors_event_t humidity_event, temp_event;
-    if (aht.getEvent(&humidity_event, &temp_event)) {
-        return constrain(humidity_event.relative_humidity, 0.0f, 100.0f);
-    } else {
-        print_log("AHT10 humidity read error, returning empty value\n");
-        return 0.0f;  // Read error, return empty value
+    float humidity = 0.0f;
+    float temperature = 0.0f;
+    conversion_start_ms = millis();
+    if (start_aht10()) {
+        collect_climate(humidity, temperature);
     }
+    return humidity;
 #else
     float humidity = generate_simulated_value(SIM_HUMIDITY_BASE, SIM_HUMIDITY_VARIATION);
     print_log("[SIM] Humidity: %.1f%%\n", humidity);
@@ -123,8 +228,76 @@ float Sensors::read_humidity() {
 #endif
 }
 
-float Sensors::read_distance() {
 #if REAL_SENSORS_ENABLED
+// The VL53L0X is already ranging continuously (started in setup); the AHT10 and the
+// BH1750 (one-time mode, powers down by itself afterwards) are triggered here
+void Sensors::start_conversions() {
+    conversion_start_ms = millis();
+    if (aht10_initialized && !start_aht10()) {
+        print_log("AHT10 trigger failed\n");
+    }
+    if (bh1750_initialized && !lux_sensor.configure(BH1750::ONE_TIME_HIGH_RES_MODE)) {
+        print_log("BH1750 trigger failed\n");
+    }
+}
+
+// Measurement command; both values come back from the same conversion
+bool Sensors::start_aht10() {
+    if (!aht10_initialized) {
+        return false;
+    }
+    Wire.beginTransmission(AHT10_I2C_ADDRESS);
+    Wire.write(0xAC);
+    Wire.write(0x33);
+    Wire.write(0x00);
+    return Wire.endTransmission() == 0;
+}
+
+// Reads the 6-byte result: status, 20-bit humidity, 20-bit temperature
+bool Sensors::read_aht10(float& humidity, float& temperature) {
+    uint32_t elapsed = millis() - conversion_start_ms;
+    if (elapsed < AHT10_CONVERSION_MS) {
+        delay(AHT10_CONVERSION_MS - elapsed);
+    }
+    
+    uint8_t data[6];
+    do {
+        if (Wire.requestFrom(static_cast<uint8_t>(AHT10_I2C_ADDRESS), static_cast<uint8_t>(sizeof(data))) != sizeof(data)) {
+            return false;
+        }
+        for (size_t i = 0; i < sizeof(data); i++) {
+            data[i] = Wire.read();
+        }
+        if (!(data[0] & 0x80)) {  // Busy bit cleared
+            uint32_t raw_humidity = (static_cast<uint32_t>(data[1]) << 12) | (data[2] << 4) | (data[3] >> 4);
+            uint32_t raw_temperature = (static_cast<uint32_t>(data[3] & 0x0F) << 16) | (data[4] << 8) | data[5];
+            humidity = raw_humidity * 100.0f / 1048576.0f;
+            temperature = raw_temperature * 200.0f / 1048576.0f - 50.0f;
+            return true;
+        }
+        delay(5);
+    } while (millis() - conversion_start_ms < SENSOR_READ_TIMEOUT_MS);
+    return false;
+}
+
+void Sensors::collect_climate(float& humidity, float& temperature) {
+    humidity = 0.0f;
+    temperature = 0.0f;
+    if (!aht10_initialized) {
+        return;  // Sensor not connected, return empty values
+    }
+    
+    if (read_aht10(humidity, temperature)) {
+        humidity = constrain(humidity, 0.0f, 100.0f);
+        temperature = constrain(temperature, -40.0f, 80.0f);
+    } else {
+        print_log("AHT10 read error, returning empty values\n");
+        humidity = 0.0f;
+        temperature = 0.0f;
+    }
+}
+
+float Sensors::collect_distance() {
     if (!vl53l0x_initialized) {
         return 0.0f;  // Sensor not connected, return empty value
     }
@@ -140,52 +313,28 @@ float Sensors::read_distance() {
     // Convert mm to cm for consistency with rest of code
     float distance_cm = distance_mm / 10.0f;
     return constrain(distance_cm, 0.0f, 200.0f);  // VL53L0X effective range ~2m
-#else
-    float distance = generate_simulated_value(SIM_DISTANCE_BASE, SIM_DISTANCE_VARIATION);
-    print_log("[SIM] Distance: %.1f cm\n", distance);
-    return distance;
-#endif
-}
-
-float Sensors::read_temperature() {
-#if REAL_SENSORS_ENABLED
-    if (!aht10_initialized) {
-        return 0.0f;  // Sensor not connected, return empty value
-    }
-    
-    sensors_event_t humidity_event, temp_event;
-    if (aht.getEvent(&humidity_event, &temp_event)) {
-        return constrain(temp_event.temperature, -40.0f, 80.0f);
-    } else {
-        print_log("AHT10 temperature read error, returning empty value\n");
-        return 0.0f;  // Read error, return empty value
-    }
-#else
-    float temperature = generate_simulated_value(SIM_TEMPERATURE_BASE, SIM_TEMPERATURE_VARIATION);
-    print_log("[SIM] Temperature: %.1f C\n", temperature);
-    return temperature;
-#endif
 }
 
-uint16_t Sensors::read_luminosity() {
-#if REAL_SENSORS_ENABLED
+uint16_t Sensors::collect_luminosity() {
     if (!bh1750_initialized) {
         return 0;  // Sensor not connected, return empty value
     }
     
+    // Worst-case conversion time of the mode, counted from configure()
+    while (!lux_sensor.measurementReady(true)) {
+        if (millis() - conversion_start_ms > SENSOR_READ_TIMEOUT_MS) {
+            break;
+        }
+        delay(1);
+    }
     float lux = lux_sensor.readLightLevel();
     if (lux < 0) {
         print_log("BH1750 read error, returning empty value\n");
         return 0;  // Read error, return empty value
     }
     return static_cast<uint16_t>(constrain(lux, 0.0f, 65535.0f));
-#else
-    float lux = generate_simulated_value(SIM_LUMINOSITY_BASE, SIM_LUMINOSITY_VARIATION);
-    uint16_t lux_value = static_cast<uint16_t>(constrain(lux, 0.0f, 65535.0f));
-    print_log("[SIM] Luminosity: %u lux\n", lux_value);
-    return lux_value;
-#endif
 }
+#endif
 
 float Sensors::generate_simulated_value(float base_value, float variation) {
     // random() generates pseudo-random values
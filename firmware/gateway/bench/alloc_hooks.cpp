@@ -0,0 +1,85 @@
+// Heap accounting for the bench: wraps the glibc allocator, so operator new, ArduinoJson
+// and String all show up in the counters. The LittleFS shim allocates from __libc_malloc
+// directly, file contents live in flash on the device.
+
+#include "bench.h"
+
+#include <atomic>
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void  __libc_free(void* ptr);
+}
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> frees(0);
+static std::atomic<uint64_t> bytes_allocated(0);
+static std::atomic<int64_t> live_bytes(0);
+static std::atomic<int64_t> peak_live_bytes(0);
+
+static void on_allocated(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    size_t size = malloc_usable_size(ptr);
+    allocations++;
+    bytes_allocated += size;
+    int64_t live = live_bytes += static_cast<int64_t>(size);
+    int64_t peak = peak_live_bytes.load();
+    while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live)) {
+    }
+}
+
+static void on_freeing(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    frees++;
+    live_bytes -= static_cast<int64_t>(malloc_usable_size(ptr));
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    void* ptr = __libc_malloc(size);
+    on_allocated(ptr);
+    return ptr;
+}
+
+void* calloc(size_t count, size_t size) {
+    void* ptr = __libc_calloc(count, size);
+    on_allocated(ptr);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    on_freeing(ptr);
+    void* moved = __libc_realloc(ptr, size);
+    on_allocated(moved);
+    return moved;
+}
+
+void free(void* ptr) {
+    on_freeing(ptr);
+    __libc_free(ptr);
+}
+
+}
+
+struct alloc_stats_t alloc_snapshot() {
+    struct alloc_stats_t snapshot = {
+        allocations.load(),
+        frees.load(),
+        bytes_allocated.load(),
+        live_bytes.load(),
+        peak_live_bytes.load()
+    };
+    return snapshot;
+}
+
+void alloc_reset_peak() {
+    peak_live_bytes = live_bytes.load();
+}
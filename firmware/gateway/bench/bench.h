@@ -0,0 +1,43 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Host benchmark of the gateway RX pipeline (env:native)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "constants.h"
+
+struct BenchFrame {
+    uint8_t data[LORA_MAX_PACKET_SIZE];
+    size_t length;
+    float rssi;
+    float snr;
+};
+
+struct bench_mix_t {
+    uint16_t nodes;             // Distinct client_ids, 1..255
+    float duplicate_rate;       // Frames re-sent verbatim
+    float corrupt_rate;         // Frames with a flipped byte or a truncated length
+    bool all_types;             // Heartbeats, alerts, batches and aggregates besides 0x01
+    float legacy_rate;          // Nodes on the original firmware: V1 readings, XOR trailer
+    float reboot_rate;          // Frames preceded by a power cycle whose restart frame is lost
+};
+
+struct alloc_stats_t {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes_allocated;
+    int64_t  live_bytes;
+    int64_t  peak_live_bytes;
+};
+
+// alloc_hooks.cpp: counts every malloc/new while the bench runs
+struct alloc_stats_t alloc_snapshot();
+void alloc_reset_peak();
+
+// frame_gen.cpp
+void generate_frames(const struct bench_mix_t& mix, size_t count, uint32_t seed, std::vector<BenchFrame>& out);
+bool load_capture(const char* path, std::vector<BenchFrame>& out);
+
+#endif // BENCH_H
@@ -0,0 +1,239 @@
+// Host benchmark of the gateway RX pipeline (pio run -e native).
+//
+// Boots the real setup(), then feeds frames into LoRaRadio::push_frame() the way the RX
+// task does and runs the real loop() after every burst, so dedup, the node table, JSON
+// encoding, batching, the uplink queue and the spool all run unmodified. Frames are
+// generated before the clock starts. Gateway logs go to stdout (discarded unless
+// --verbose), the report to stderr.
+
+#include <Arduino.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "bench.h"
+#include "native_shim.h"
+#include "lora.h"
+#include "processing.h"
+#include "node_table.h"
+#include "uplink.h"
+#include "wifi.h"
+#include "spool.h"
+#include "alerts.h"
+#include "trace.h"
+#include "protocol.h"
+
+void setup();
+void loop();
+
+struct bench_options_t {
+    size_t frames;
+    uint16_t nodes;
+    uint16_t burst;             // Frames pushed before each loop() in the "burst" scenario
+    uint32_t seed;
+    float legacy_rate;          // Nodes still on the original firmware
+    const char* scenario;       // nullptr = all synthetic scenarios
+    const char* capture;        // Replay file, see load_capture()
+    bool verbose;
+};
+
+struct bench_scenario_t {
+    const char* name;
+    struct bench_mix_t mix;
+    bool bursty;
+};
+
+static void usage(const char* program) {
+    fprintf(stderr,
+      "usage: %s [--frames N] [--nodes N] [--burst N] [--seed N] [--http-latency-us N] [--http-fail-percent N]\n"
+      "          [--legacy-percent N] [--scenario steady|burst|duplicates|corrupt|reboots|mixed] [--capture FILE] [--verbose]\n",
+      program);
+}
+
+static bool parse_options(int argc, char** argv, struct bench_options_t& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--verbose") == 0) {
+            options.verbose = true;
+            continue;
+        }
+        if (value == nullptr) {
+            return false;
+        }
+        if (strcmp(arg, "--frames") == 0) {
+            options.frames = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--nodes") == 0) {
+            options.nodes = static_cast<uint16_t>(strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--burst") == 0) {
+            options.burst = static_cast<uint16_t>(strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--http-latency-us") == 0) {
+            native_http_latency_us = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--http-fail-percent") == 0) {
+            native_http_fail_percent = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--legacy-percent") == 0) {
+            options.legacy_rate = strtoul(value, nullptr, 10) / 100.0f;
+        } else if (strcmp(arg, "--scenario") == 0) {
+            options.scenario = value;
+        } else if (strcmp(arg, "--capture") == 0) {
+            options.capture = value;
+        } else {
+            return false;
+        }
+        i++;
+    }
+    // client_id is one byte and 0 marks a free node table slot
+    if (options.nodes < 1 || options.nodes > 255) {
+        fprintf(stderr, "--nodes must be 1-255 (client_id is 8 bits)\n");
+        return false;
+    }
+    return options.frames > 0 && options.burst > 0;
+}
+
+static void print_header() {
+    fprintf(stderr, "%-11s %8s %10s %9s %8s %9s %10s %7s %6s %6s %7s %7s\n",
+      "scenario", "frames", "frames/s", "ns/frame", "allocs/f", "bytes/f", "peak_heap",
+      "dropped", "dups", "cksum", "invalid", "posts");
+}
+
+// Runs the frames through the pipeline and prints one report line of counter deltas
+static void run_scenario(const char* name, const std::vector<BenchFrame>& frames, uint16_t burst) {
+    LoRaRadio& radio = LoRaRadio::get_instance();
+    const LoRaRadio::Stats rx_before = radio.get_stats();
+    uint32_t duplicates_before = get_duplicate_count();
+    struct native_http_stats_t http_before = native_http_snapshot();
+
+    alloc_reset_peak();
+    struct alloc_stats_t heap_before = alloc_snapshot();
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < frames.size(); i += burst) {
+        size_t end = i + burst < frames.size() ? i + burst : frames.size();
+        for (size_t j = i; j < end; j++) {
+            radio.push_frame(frames[j].data, frames[j].length, frames[j].rssi, frames[j].snr);
+        }
+        loop();
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    struct alloc_stats_t heap_after = alloc_snapshot();
+    const LoRaRadio::Stats& rx_after = radio.get_stats();
+    struct native_http_stats_t http_after = native_http_snapshot();
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double count = static_cast<double>(frames.size());
+    fprintf(stderr, "%-11s %8zu %10.0f %9.0f %8.2f %9.1f %10lld %7u %6u %6u %7u %7u\n",
+      name,
+      frames.size(),
+      count / seconds,
+      seconds * 1e9 / count,
+      (heap_after.allocations - heap_before.allocations) / count,
+      (heap_after.bytes_allocated - heap_before.bytes_allocated) / count,
+      static_cast<long long>(heap_after.peak_live_bytes - heap_before.live_bytes),
+      rx_after.total_rx_dropped - rx_before.total_rx_dropped,
+      get_duplicate_count() - duplicates_before,
+      rx_after.total_checksum_errors - rx_before.total_checksum_errors,
+      rx_after.total_rx_invalids - rx_before.total_rx_invalids,
+      http_after.requests - http_before.requests);
+}
+
+// Trailer check alone, XOR against CRC-16 on the same payloads (the mixed scenario's frames)
+static void report_trailer_cost(const struct bench_options_t& options) {
+    const int rounds = 20;
+    const FrameTrailer trailers[] = {FRAME_TRAILER_XOR, FRAME_TRAILER_CRC16};
+    double ns_per_frame[2];
+    double bytes = 0;
+
+    for (int t = 0; t < 2; t++) {
+        struct bench_mix_t mix = {options.nodes, 0.0f, 0.0f, true, trailers[t] == FRAME_TRAILER_XOR ? 1.0f : 0.0f, 0.0f};
+        std::vector<BenchFrame> frames;
+        generate_frames(mix, options.frames, options.seed, frames);
+
+        volatile uint32_t passed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (const BenchFrame& frame : frames) {
+                passed = passed + protocol_verify(frame.data, frame.length, trailers[t]);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ns_per_frame[t] = seconds * 1e9 / (static_cast<double>(frames.size()) * rounds);
+        if (t == 1) {
+            for (const BenchFrame& frame : frames) {
+                bytes += frame.length;
+            }
+            bytes /= frames.size();
+        }
+    }
+    fprintf(stderr, "trailer check (avg %.1f bytes): xor %.1f ns/frame | crc16 %.1f ns/frame\n",
+      bytes, ns_per_frame[0], ns_per_frame[1]);
+}
+
+int main(int argc, char** argv) {
+    struct bench_options_t options = {100000, 255, 24, 1, 0.0f, nullptr, nullptr, false};
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!options.verbose) {
+        freopen("/dev/null", "w", stdout);
+    }
+
+    setup();
+
+    const struct bench_scenario_t scenarios[] = {
+        {"steady",     {options.nodes, 0.0f,  0.0f,  false, options.legacy_rate, 0.0f},  false},
+        {"burst",      {options.nodes, 0.0f,  0.0f,  false, options.legacy_rate, 0.0f},  true},
+        {"duplicates", {options.nodes, 0.30f, 0.0f,  false, options.legacy_rate, 0.0f},  false},
+        {"corrupt",    {options.nodes, 0.0f,  0.20f, false, options.legacy_rate, 0.0f},  false},
+        {"reboots",    {options.nodes, 0.0f,  0.0f,  false, options.legacy_rate, 0.05f}, false},
+        {"mixed",      {options.nodes, 0.05f, 0.02f, true,  options.legacy_rate, 0.01f}, false},
+    };
+
+    print_header();
+    std::vector<BenchFrame> frames;
+    if (options.capture != nullptr) {
+        if (!load_capture(options.capture, frames) || frames.empty()) {
+            fprintf(stderr, "no frames read from %s\n", options.capture);
+            return 1;
+        }
+        run_scenario("capture", frames, 1);
+    } else {
+        for (const struct bench_scenario_t& scenario : scenarios) {
+            if (options.scenario != nullptr && strcmp(options.scenario, scenario.name) != 0) {
+                continue;
+            }
+            frames.clear();
+            generate_frames(scenario.mix, options.frames, options.seed, frames);
+            run_scenario(scenario.name, frames, scenario.bursty ? options.burst : 1);
+        }
+        report_trailer_cost(options);
+    }
+
+    struct native_http_stats_t http = native_http_snapshot();
+    fprintf(stderr, "nodes tracked %u | inserts %u | evictions %u | uplink enqueued %u dropped %u undelivered %u"
+      " | spool stored %u replayed %u\n",
+      node_table_stats.tracked, node_table_stats.inserts, node_table_stats.evictions,
+      uplink_stats.enqueued, uplink_stats.dropped, uplink_stats.undelivered, spool_stats.stored, spool_stats.replayed);
+    fprintf(stderr, "http requests %u | failed %u | malformed %u\n", http.requests, http.failed, http.malformed);
+    String stats_json = build_gateway_stats_json();
+    fprintf(stderr, "stats body %u bytes (limit %u)\n", static_cast<unsigned>(stats_json.length()), UPLINK_MAX_BODY_SIZE);
+#ifdef ALERTS_ON
+    fprintf(stderr, "alerts raised %u | delivered %u | dropped %u\n",
+      alert_stats.raised, alert_stats.delivered, alert_stats.dropped);
+#endif
+#ifdef TRACE_ON
+    fprintf(stderr, "\n%-10s %9s %9s %9s %9s\n", "stage", "count", "p50_us", "p99_us", "max_us");
+    for (uint8_t s = 0; s < TRACE_STAGE_COUNT; s++) {
+        struct trace_summary_t summary;
+        trace_summary(static_cast<TraceStage>(s), summary);
+        fprintf(stderr, "%-10s %9u %9.2f %9.2f %9.2f\n", trace_stage_name(static_cast<TraceStage>(s)),
+          summary.count, summary.p50_us, summary.p99_us, summary.max_us);
+    }
+#endif
+    fflush(stderr);
+
+    // The RX and uplink tasks never return; skip static destructors they may still use
+    _exit(0);
+}
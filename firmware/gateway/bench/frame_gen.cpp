@@ -0,0 +1,292 @@
+// Synthetic and captured LoRa frames for the bench, encoded exactly as the nodes send them
+
+#include "bench.h"
+#include "protocol.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+
+struct NodeSim {
+    uint16_t sequence;
+    uint32_t clock_ms;          // Node millis(), advances one TX period per frame
+    bool     started;           // First frame carries SENSOR_FLAG_SEQUENCE_RESTART
+    bool     legacy;            // Original firmware: V1 readings, XOR trailer
+    bool     has_last;
+    BenchFrame last;
+};
+
+static std::mt19937 rng;
+
+static float uniform(float low, float high) {
+    return std::uniform_real_distribution<float>(low, high)(rng);
+}
+
+static bool chance(float rate) {
+    return uniform(0.0f, 1.0f) < rate;
+}
+
+static uint32_t pick(uint32_t count) {
+    return rng() % count;
+}
+
+struct Reading {
+    int16_t temperature;
+    uint16_t humidity;
+    uint16_t distance_cm;
+    uint16_t luminosity_lux;
+};
+
+// Mostly nominal readings; about 1 in 100 crosses a rules.cpp threshold
+static struct Reading sample() {
+    bool outlier = chance(0.01f);
+    struct Reading reading;
+    reading.temperature = encode_temperature(outlier ? uniform(-5.0f, 50.0f) : uniform(15.0f, 35.0f));
+    reading.humidity = encode_humidity(outlier ? uniform(5.0f, 99.0f) : uniform(30.0f, 75.0f));
+    reading.distance_cm = static_cast<uint16_t>(outlier ? uniform(2.0f, 40.0f) : uniform(150.0f, 400.0f));
+    reading.luminosity_lux = static_cast<uint16_t>(uniform(0.0f, 2000.0f));
+    return reading;
+}
+
+static uint8_t next_flags(NodeSim& node) {
+    uint8_t flags = node.started ? 0 : SENSOR_FLAG_SEQUENCE_RESTART;
+    node.started = true;
+    if (chance(0.1f)) {
+        flags |= SENSOR_FLAG_CONFIRMED;
+    }
+    if (!node.legacy) {
+        flags |= encode_tx_power(LORA_TX_POWER);    // Never applies ADR: settings are resent
+    }
+    return flags;
+}
+
+static void encode_sensor_data(uint8_t client_id, NodeSim& node, BenchFrame& frame) {
+    SensorDataMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = MSG_TYPE_SENSOR_DATA;
+    msg.client_id = client_id;
+    msg.timestamp = node.clock_ms;
+    struct Reading reading = sample();
+    msg.temperature = reading.temperature;
+    msg.humidity = reading.humidity;
+    msg.distance_cm = reading.distance_cm;
+    msg.luminosity_lux = reading.luminosity_lux;
+    msg.battery = static_cast<uint8_t>(uniform(40.0f, 100.0f));
+    msg.sequence = node.sequence++;
+    msg.flags = next_flags(node);
+    msg.awake_ms = static_cast<uint16_t>(uniform(80.0f, 400.0f));
+    memcpy(frame.data, &msg, sizeof(msg));
+    frame.length = sizeof(msg);
+}
+
+// Original firmware: 17-byte layout without sequence, flags or awake time
+static void encode_sensor_data_v1(uint8_t client_id, NodeSim& node, BenchFrame& frame) {
+    SensorDataMessageV1 msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = MSG_TYPE_SENSOR_DATA;
+    msg.client_id = client_id;
+    msg.timestamp = node.clock_ms;
+    struct Reading reading = sample();
+    msg.temperature = reading.temperature;
+    msg.humidity = reading.humidity;
+    msg.distance_cm = reading.distance_cm;
+    msg.luminosity_lux = reading.luminosity_lux;
+    msg.battery = static_cast<uint8_t>(uniform(40.0f, 100.0f));
+    memcpy(frame.data, &msg, sizeof(msg));
+    frame.length = sizeof(msg);
+}
+
+static void encode_sensor_batch(uint8_t client_id, NodeSim& node, BenchFrame& frame) {
+    uint8_t count = static_cast<uint8_t>(1 + pick(SENSOR_BATCH_MAX_READINGS));
+    SensorBatchHeader header;
+    memset(&header, 0, sizeof(header));
+    header.msg_type = MSG_TYPE_SENSOR_BATCH;
+    header.client_id = client_id;
+    header.timestamp = node.clock_ms;
+    header.sequence = node.sequence;
+    header.flags = next_flags(node);
+    header.count = count;
+    header.interval_s = 60;
+    struct Reading reading = sample();
+    header.temperature = reading.temperature;
+    header.humidity = reading.humidity;
+    header.distance_cm = reading.distance_cm;
+    header.luminosity_lux = reading.luminosity_lux;
+    header.battery = static_cast<uint8_t>(uniform(40.0f, 100.0f));
+    header.awake_ms = static_cast<uint16_t>(uniform(80.0f, 400.0f));
+    node.sequence += count;
+
+    size_t offset = 0;
+    memcpy(frame.data, &header, sizeof(header));
+    offset += sizeof(header);
+    for (uint8_t i = 1; i < count; i++) {
+        SensorBatchRecord record;
+        record.temperature_delta = static_cast<int8_t>(uniform(-20.0f, 20.0f));
+        record.humidity_delta = static_cast<int8_t>(uniform(-20.0f, 20.0f));
+        record.distance_delta = static_cast<int16_t>(uniform(-50.0f, 50.0f));
+        record.luminosity_delta = static_cast<int16_t>(uniform(-200.0f, 200.0f));
+        memcpy(frame.data + offset, &record, sizeof(record));
+        offset += sizeof(record);
+    }
+    frame.length = SENSOR_BATCH_FRAME_SIZE(count);
+}
+
+static void encode_sensor_aggregate(uint8_t client_id, NodeSim& node, BenchFrame& frame) {
+    SensorAggregateMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = MSG_TYPE_SENSOR_AGGREGATE;
+    msg.client_id = client_id;
+    msg.timestamp = node.clock_ms;
+    msg.sequence = node.sequence++;
+    msg.flags = next_flags(node);
+    msg.count = static_cast<uint8_t>(2 + pick(30));
+    msg.interval_s = 10;
+    struct Reading reading = sample();
+    msg.temperature_mean = reading.temperature;
+    msg.humidity_mean = reading.humidity;
+    msg.distance_mean = reading.distance_cm;
+    msg.luminosity_mean = reading.luminosity_lux;
+    msg.temperature_min = msg.temperature_mean - 150;
+    msg.temperature_max = msg.temperature_mean + 150;
+    msg.humidity_min = msg.humidity_mean > 300 ? msg.humidity_mean - 300 : 0;
+    msg.humidity_max = msg.humidity_mean + 300;
+    msg.distance_min = msg.distance_mean / 2;
+    msg.distance_max = msg.distance_mean * 2;
+    msg.luminosity_min = msg.luminosity_mean / 2;
+    msg.luminosity_max = msg.luminosity_mean + 100;
+    msg.battery = static_cast<uint8_t>(uniform(40.0f, 100.0f));
+    msg.awake_ms = static_cast<uint16_t>(uniform(80.0f, 400.0f));
+    memcpy(frame.data, &msg, sizeof(msg));
+    frame.length = sizeof(msg);
+}
+
+static void encode_heartbeat(uint8_t client_id, NodeSim& node, BenchFrame& frame) {
+    HeartbeatMessage msg;
+    msg.msg_type = MSG_TYPE_HEARTBEAT;
+    msg.client_id = client_id;
+    msg.timestamp = node.clock_ms;
+    msg.status = chance(0.05f) ? STATUS_LOW_BATTERY : STATUS_OK;
+    memcpy(frame.data, &msg, sizeof(msg));
+    frame.length = sizeof(msg);
+}
+
+static void encode_alert(uint8_t client_id, NodeSim& node, BenchFrame& frame) {
+    static const uint8_t codes[] = {
+        ALERT_TEMPERATURE_HIGH, ALERT_HUMIDITY_LOW, ALERT_DISTANCE_LOW, ALERT_BATTERY_LOW
+    };
+    AlertMessage msg;
+    msg.msg_type = MSG_TYPE_ALERT;
+    msg.client_id = client_id;
+    msg.timestamp = node.clock_ms;
+    msg.alert_code = codes[pick(sizeof(codes))];
+    msg.alert_value = static_cast<int16_t>(uniform(0.0f, 5000.0f));
+    msg.severity = static_cast<uint8_t>(1 + pick(3));
+    msg.reserved = 0;
+    memcpy(frame.data, &msg, sizeof(msg));
+    frame.length = sizeof(msg);
+}
+
+// Flips one byte past msg_type (checksum error) or drops the tail (length mismatch)
+static void corrupt(BenchFrame& frame) {
+    if (chance(0.75f)) {
+        size_t index = 1 + pick(static_cast<uint32_t>(frame.length - 1));
+        frame.data[index] ^= static_cast<uint8_t>(1 + pick(255));
+    } else {
+        frame.length -= 1 + pick(3);
+    }
+}
+
+void generate_frames(const struct bench_mix_t& mix, size_t count, uint32_t seed, std::vector<BenchFrame>& out) {
+    rng.seed(seed);
+    std::vector<NodeSim> nodes(mix.nodes);
+    for (NodeSim& node : nodes) {
+        node.sequence = static_cast<uint16_t>(rng());
+        node.clock_ms = pick(60000);
+        node.started = false;
+        node.legacy = chance(mix.legacy_rate);
+        node.has_last = false;
+    }
+
+    out.reserve(out.size() + count);
+    for (size_t i = 0; i < count; i++) {
+        uint16_t index = static_cast<uint16_t>(pick(mix.nodes));
+        uint8_t client_id = static_cast<uint8_t>(index + 1);
+        NodeSim& node = nodes[index];
+        BenchFrame frame;
+
+        if (node.has_last && chance(mix.duplicate_rate)) {
+            out.push_back(node.last);
+            continue;
+        }
+
+        if (!node.legacy && chance(mix.reboot_rate)) {
+            // Power cycle: millis() and the sequence start over, and the restart frame is lost
+            node.sequence = 0;
+            node.clock_ms = pick(5000);
+            node.started = false;
+            node.has_last = false;
+            encode_sensor_data(client_id, node, frame);
+        }
+
+        node.clock_ms += 60000;
+        uint32_t roll = mix.all_types ? pick(100) : 0;
+        if (node.legacy && roll < 85) {
+            encode_sensor_data_v1(client_id, node, frame);     // Old firmware sends no batches or aggregates
+        } else if (roll < 60) {
+            encode_sensor_data(client_id, node, frame);
+        } else if (roll < 70) {
+            encode_sensor_batch(client_id, node, frame);
+        } else if (roll < 85) {
+            encode_sensor_aggregate(client_id, node, frame);
+        } else if (roll < 95) {
+            encode_heartbeat(client_id, node, frame);
+        } else {
+            encode_alert(client_id, node, frame);
+        }
+        // Encoders lay the frame out as its struct; the trailer goes on last
+        frame.length = protocol_seal(frame.data, frame.length, node.legacy ? FRAME_TRAILER_XOR : FRAME_TRAILER_CRC16);
+        frame.rssi = uniform(-120.0f, -40.0f);
+        frame.snr = uniform(-15.0f, 10.0f);
+        node.last = frame;
+        node.has_last = true;
+
+        if (chance(mix.corrupt_rate)) {
+            corrupt(frame);
+        }
+        out.push_back(frame);
+    }
+}
+
+// One frame per line: hex payload, then optional RSSI and SNR; '#' starts a comment
+bool load_capture(const char* path, std::vector<BenchFrame>& out) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[2 * LORA_MAX_PACKET_SIZE + 64];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char hex[2 * LORA_MAX_PACKET_SIZE + 1];
+        BenchFrame frame;
+        frame.rssi = -80.0f;
+        frame.snr = 5.0f;
+        if (line[0] == '#' || sscanf(line, "%512s %f %f", hex, &frame.rssi, &frame.snr) < 1) {
+            continue;
+        }
+        size_t digits = strlen(hex);
+        frame.length = digits / 2;
+        if (digits % 2 != 0 || frame.length == 0 || frame.length > LORA_MAX_PACKET_SIZE) {
+            continue;
+        }
+        bool valid = true;
+        for (size_t i = 0; i < frame.length && valid; i++) {
+            unsigned int byte_value;
+            valid = sscanf(hex + 2 * i, "%2x", &byte_value) == 1;
+            frame.data[i] = static_cast<uint8_t>(byte_value);
+        }
+        if (valid) {
+            out.push_back(frame);
+        }
+    }
+    fclose(file);
+    return true;
+}
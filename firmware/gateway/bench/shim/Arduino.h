@@ -0,0 +1,76 @@
+#ifndef SHIM_ARDUINO_H
+#define SHIM_ARDUINO_H
+
+// Host (env:native) stand-in for the parts of the Arduino-ESP32 core the gateway uses
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <time.h>
+#include <string>
+#include "freertos/FreeRTOS.h"
+
+#define IRAM_ATTR
+
+#define LOW     0
+#define HIGH    1
+#define INPUT   0
+#define OUTPUT  1
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+uint32_t getCpuFrequencyMhz();
+void configTime(long gmt_offset_sec, int daylight_offset_sec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+// Heap-backed like the Arduino class; ArduinoJson writes into it through concat()/write()
+class String {
+  public:
+    String() {}
+    String(const char* text) : value(text != nullptr ? text : "") {}
+    String(const std::string& text) : value(text) {}
+
+    const char* c_str() const { return value.c_str(); }
+    size_t length() const { return value.size(); }
+    bool reserve(size_t size) { value.reserve(size); return true; }
+
+    bool concat(const char* text) { value.append(text); return true; }
+    size_t write(uint8_t c) { value.push_back(static_cast<char>(c)); return 1; }
+    size_t write(const uint8_t* data, size_t size) {
+        value.append(reinterpret_cast<const char*>(data), size);
+        return size;
+    }
+
+  private:
+    std::string value;
+};
+
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud) {}
+    size_t print(const char* text) { return fputs(text, stdout) >= 0 ? strlen(text) : 0; }
+    size_t println(const char* text = "") { return print(text) + print("\n"); }
+    void flush() { fflush(stdout); }
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // SHIM_ARDUINO_H
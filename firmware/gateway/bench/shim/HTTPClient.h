@@ -0,0 +1,32 @@
+#ifndef SHIM_HTTPCLIENT_H
+#define SHIM_HTTPCLIENT_H
+
+// Acknowledges every POST after native_http_latency_us; see native_shim.h (env:native)
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define HTTP_CODE_OK                200
+#define HTTP_CODE_CREATED           201
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+#define HTTPC_ERROR_NOT_CONNECTED       (-4)
+#define HTTPC_ERROR_READ_TIMEOUT        (-11)
+
+class HTTPClient {
+  public:
+    bool begin(WiFiClient& client, const char* host, uint16_t port, const char* uri);
+    void end() {}
+    void setReuse(bool reuse) {}
+    void setTimeout(uint16_t timeout) {}
+    void addHeader(const String& name, const String& value) {}
+    int POST(uint8_t* payload, size_t size);
+    int getSize() const { return 0; }
+    WiFiClient* getStreamPtr() { return client; }
+
+    static String errorToString(int error);
+
+  private:
+    WiFiClient* client = nullptr;
+};
+
+#endif // SHIM_HTTPCLIENT_H
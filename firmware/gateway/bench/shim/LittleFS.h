@@ -0,0 +1,64 @@
+#ifndef SHIM_LITTLEFS_H
+#define SHIM_LITTLEFS_H
+
+// RAM-backed LittleFS for glibc hosts; contents last for the life of the process (env:native)
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void  __libc_free(void* ptr);
+}
+
+// File contents sit in flash on the device, so they bypass the bench heap counters
+template <typename T>
+struct FlashAllocator {
+    typedef T value_type;
+    FlashAllocator() {}
+    template <typename U> FlashAllocator(const FlashAllocator<U>&) {}
+    T* allocate(size_t count) { return static_cast<T*>(__libc_malloc(count * sizeof(T))); }
+    void deallocate(T* ptr, size_t count) { __libc_free(ptr); }
+    template <typename U> bool operator==(const FlashAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const FlashAllocator<U>&) const { return false; }
+};
+
+typedef std::vector<uint8_t, FlashAllocator<uint8_t>> FlashBytes;
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+class File {
+  public:
+    File() {}
+    File(std::shared_ptr<FlashBytes> data, bool writable, size_t position)
+        : data(data), writable(writable), position(position) {}
+
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t read(uint8_t* buffer, size_t size);
+    bool seek(uint32_t offset);
+    size_t size() const { return data ? data->size() : 0; }
+    void flush() {}
+    void close() { data.reset(); }
+    operator bool() const { return data != nullptr; }
+
+  private:
+    std::shared_ptr<FlashBytes> data;
+    bool writable = false;
+    size_t position = 0;
+};
+
+class LittleFSFS {
+  public:
+    bool begin(bool format_on_fail = false) { return true; }
+    File open(const char* path, const char* mode);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool mkdir(const char* path);
+};
+
+extern LittleFSFS LittleFS;
+
+#endif // SHIM_LITTLEFS_H
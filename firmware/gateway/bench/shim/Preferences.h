@@ -0,0 +1,34 @@
+#ifndef SHIM_PREFERENCES_H
+#define SHIM_PREFERENCES_H
+
+// RAM-backed NVS; a namespace exists once it has been opened read-write (env:native)
+
+#include <Arduino.h>
+
+class Preferences {
+  public:
+    bool begin(const char* name, bool read_only = false);
+    void end();
+    bool isKey(const char* key);
+
+    uint32_t getUInt(const char* key, uint32_t default_value = 0);
+    uint16_t getUShort(const char* key, uint16_t default_value = 0);
+    float getFloat(const char* key, float default_value = 0.0f);
+    size_t getString(const char* key, char* value, size_t max_length);
+    size_t getBytes(const char* key, void* buffer, size_t length);
+
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putUShort(const char* key, uint16_t value);
+    size_t putFloat(const char* key, float value);
+    size_t putString(const char* key, const char* value);
+    size_t putBytes(const char* key, const void* value, size_t length);
+
+  private:
+    size_t get_raw(const char* key, void* buffer, size_t length);
+    size_t put_raw(const char* key, const void* value, size_t length);
+
+    const char* name = nullptr;
+    bool read_only = true;
+};
+
+#endif // SHIM_PREFERENCES_H
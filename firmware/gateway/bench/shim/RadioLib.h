@@ -0,0 +1,40 @@
+#ifndef SHIM_RADIOLIB_H
+#define SHIM_RADIOLIB_H
+
+// SX1262 that initializes, never receives and transmits instantly (env:native).
+// The bench feeds frames through LoRaRadio::push_frame(), like the RX task does.
+
+#include <Arduino.h>
+
+#define RADIOLIB_ERR_NONE               0
+#define RADIOLIB_ERR_CRC_MISMATCH       (-7)
+#define RADIOLIB_SX126X_IRQ_RX_DONE     0x0002
+
+class Module {
+  public:
+    Module(int cs, int irq, int rst, int gpio) {}
+};
+
+class SX1262 {
+  public:
+    explicit SX1262(Module* module) : module(module) {}
+
+    int16_t begin(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t sync_word, int8_t power, uint16_t preamble) {
+        return RADIOLIB_ERR_NONE;
+    }
+    int16_t setCurrentLimit(float limit) { return RADIOLIB_ERR_NONE; }
+    int16_t setCRC(bool enable) { return RADIOLIB_ERR_NONE; }
+    void setDio1Action(void (*action)(void)) {}
+    int16_t startReceive() { return RADIOLIB_ERR_NONE; }
+    uint16_t getIrqStatus() { return 0; }
+    size_t getPacketLength() { return 0; }
+    int16_t readData(uint8_t* data, size_t length) { return RADIOLIB_ERR_NONE; }
+    float getRSSI() { return 0.0f; }
+    float getSNR() { return 0.0f; }
+    int16_t transmit(uint8_t* data, size_t length) { return RADIOLIB_ERR_NONE; }
+
+  private:
+    Module* module;
+};
+
+#endif // SHIM_RADIOLIB_H
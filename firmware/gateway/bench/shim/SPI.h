@@ -0,0 +1,14 @@
+#ifndef SHIM_SPI_H
+#define SHIM_SPI_H
+
+#include <Arduino.h>
+
+class SPIClass {
+  public:
+    void begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss) {}
+    void setFrequency(uint32_t frequency) {}
+};
+
+extern SPIClass SPI;
+
+#endif // SHIM_SPI_H
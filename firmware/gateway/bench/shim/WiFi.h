@@ -0,0 +1,67 @@
+#ifndef SHIM_WIFI_H
+#define SHIM_WIFI_H
+
+// Station that is always associated once begin() is called (env:native)
+
+#include <Arduino.h>
+#include <functional>
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1
+} wifi_mode_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP = 8
+} WiFiEvent_t;
+
+typedef struct {
+    uint32_t reason;
+} WiFiEventInfo_t;
+
+typedef void (*WiFiEventFuncCb)(WiFiEvent_t event, WiFiEventInfo_t info);
+
+class IPAddress {
+  public:
+    String toString() const { return String("127.0.0.1"); }
+};
+
+class WiFiClient {
+  public:
+    bool connected() const { return open; }
+    void stop() { open = false; }
+    int readBytes(char* buffer, size_t length) {
+        memset(buffer, 0, length);
+        return static_cast<int>(length);
+    }
+
+    bool open = false;
+};
+
+class WiFiClass {
+  public:
+    bool mode(wifi_mode_t mode) { return true; }
+    bool setAutoReconnect(bool enable) { return true; }
+    void onEvent(WiFiEventFuncCb callback) { event_callback = callback; }
+    wl_status_t begin(const char* ssid, const char* password);
+    bool disconnect();
+    wl_status_t status() const { return state; }
+    IPAddress localIP() const { return IPAddress(); }
+    int8_t RSSI() const { return -55; }
+
+  private:
+    WiFiEventFuncCb event_callback = nullptr;
+    wl_status_t state = WL_DISCONNECTED;
+};
+
+extern WiFiClass WiFi;
+
+#endif // SHIM_WIFI_H
@@ -0,0 +1,9 @@
+#ifndef SHIM_ESP_CPU_H
+#define SHIM_ESP_CPU_H
+
+#include <stdint.h>
+
+// Host clock scaled to the 240 MHz the gateway runs at, so trace.cpp conversions hold
+uint32_t esp_cpu_get_cycle_count();
+
+#endif // SHIM_ESP_CPU_H
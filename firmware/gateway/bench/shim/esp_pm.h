@@ -0,0 +1,15 @@
+#ifndef SHIM_ESP_PM_H
+#define SHIM_ESP_PM_H
+
+#include "esp_wifi.h"
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_esp32s3_t;
+
+// The host has no frequency scaling; power.cpp logs that and keeps running
+esp_err_t esp_pm_configure(const void* config);
+
+#endif // SHIM_ESP_PM_H
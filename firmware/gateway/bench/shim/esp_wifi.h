@@ -0,0 +1,20 @@
+#ifndef SHIM_ESP_WIFI_H
+#define SHIM_ESP_WIFI_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_ERR_NOT_SUPPORTED   0x106
+
+typedef enum {
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+const char* esp_err_to_name(esp_err_t code);
+
+#endif // SHIM_ESP_WIFI_H
@@ -0,0 +1,40 @@
+#ifndef SHIM_FREERTOS_H
+#define SHIM_FREERTOS_H
+
+// FreeRTOS primitives the gateway uses, on top of std::thread (env:native)
+
+#include <stdint.h>
+#include <mutex>
+
+typedef int         BaseType_t;
+typedef unsigned    UBaseType_t;
+typedef uint32_t    TickType_t;
+
+struct NativeTask;
+struct NativeQueue;
+typedef NativeTask*  TaskHandle_t;
+typedef NativeQueue* QueueHandle_t;
+
+// Critical sections become a mutex; copying yields a fresh unlocked one, so members can
+// still be initialized with portMUX_INITIALIZER_UNLOCKED
+struct portMUX_TYPE {
+    std::mutex lock;
+    portMUX_TYPE() {}
+    portMUX_TYPE(const portMUX_TYPE&) {}
+};
+
+#define portMUX_INITIALIZER_UNLOCKED    {}
+#define portENTER_CRITICAL(mux)         (mux)->lock.lock()
+#define portEXIT_CRITICAL(mux)          (mux)->lock.unlock()
+#define portYIELD_FROM_ISR(woken)       (void)(woken)
+
+// Tasks are not pinned on the host; everything reports core 0
+inline BaseType_t xPortGetCoreID() { return 0; }
+
+#define portMAX_DELAY       0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms)   (static_cast<TickType_t>(ms))
+#define pdFALSE             0
+#define pdTRUE              1
+#define pdPASS              pdTRUE
+
+#endif // SHIM_FREERTOS_H
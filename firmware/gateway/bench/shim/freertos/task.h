@@ -0,0 +1,24 @@
+#ifndef SHIM_FREERTOS_TASK_H
+#define SHIM_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+
+// Core and priority are ignored: every task is a detached host thread
+BaseType_t xTaskCreatePinnedToCore(
+    TaskFunction_t function,
+    const char* name,
+    uint32_t stack_size,
+    void* arg,
+    UBaseType_t priority,
+    TaskHandle_t* handle,
+    BaseType_t core
+);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_woken);
+void vTaskDelay(TickType_t ticks);
+
+#endif // SHIM_FREERTOS_TASK_H
@@ -0,0 +1,23 @@
+#ifndef SHIM_NATIVE_SHIM_H
+#define SHIM_NATIVE_SHIM_H
+
+// Knobs and counters the host shims expose to the bench (env:native only)
+
+#include <stdint.h>
+
+struct native_http_stats_t {
+    uint32_t requests;
+    uint64_t bytes;
+    uint32_t failed;            // Answered with HTTP 500 (see native_http_fail_percent)
+    uint32_t malformed;         // JSON bodies that do not start with exactly one '[' or '{'
+};
+
+// Simulated server round trip applied inside every HTTPClient::POST()
+extern volatile uint32_t native_http_latency_us;
+// Share of POSTs answered with HTTP 500, spread evenly over the requests
+extern volatile uint32_t native_http_fail_percent;
+
+struct native_http_stats_t native_http_snapshot();
+
+
+#endif // SHIM_NATIVE_SHIM_H
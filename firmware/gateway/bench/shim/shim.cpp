@@ -0,0 +1,471 @@
+// Host implementations behind the env:native shim headers
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <SPI.h>
+#include <WiFi.h>
+#include <esp_cpu.h>
+#include <esp_pm.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "native_shim.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+SPIClass SPI;
+WiFiClass WiFi;
+LittleFSFS LittleFS;
+
+// ============================================================================
+// TIME AND MISC
+// ============================================================================
+
+static const std::chrono::steady_clock::time_point boot_time = std::chrono::steady_clock::now();
+static std::mt19937 rng(0x10A5u);
+static std::mutex rng_mutex;
+
+unsigned long millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - boot_time).count();
+}
+
+unsigned long micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot_time).count();
+}
+
+int64_t esp_timer_get_time() {
+    return micros();
+}
+
+uint32_t esp_cpu_get_cycle_count() {
+    auto elapsed = std::chrono::steady_clock::now() - boot_time;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() * 240 / 1000);
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+long random(long max) {
+    return max > 0 ? random(0, max) : 0;
+}
+
+long random(long min, long max) {
+    if (max <= min) {
+        return min;
+    }
+    std::lock_guard<std::mutex> guard(rng_mutex);
+    return min + static_cast<long>(rng() % static_cast<uint32_t>(max - min));
+}
+
+void randomSeed(unsigned long seed) {
+    std::lock_guard<std::mutex> guard(rng_mutex);
+    rng.seed(static_cast<uint32_t>(seed));
+}
+
+uint32_t esp_random() {
+    std::lock_guard<std::mutex> guard(rng_mutex);
+    return rng();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+
+uint32_t getCpuFrequencyMhz() {
+    return 240;
+}
+
+void configTime(long gmt_offset_sec, int daylight_offset_sec, const char* server1,
+                const char* server2, const char* server3) {}
+
+esp_err_t esp_pm_configure(const void* config) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+    return ESP_OK;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    return code == ESP_OK ? "ESP_OK" : code == ESP_ERR_NOT_SUPPORTED ? "ESP_ERR_NOT_SUPPORTED" : "ESP_FAIL";
+}
+
+// ============================================================================
+// FREERTOS
+// ============================================================================
+
+struct NativeTask {
+    std::mutex lock;
+    std::condition_variable signal;
+    uint32_t notifications = 0;
+};
+
+// Fixed storage like a FreeRTOS queue, so sends and receives do not allocate
+struct NativeQueue {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<uint8_t> storage;
+    size_t length;
+    size_t item_size;
+    size_t head;
+    size_t count;
+};
+
+struct NativeTaskStart {
+    TaskFunction_t function;
+    void* arg;
+    NativeTask* task;
+};
+
+static thread_local NativeTask* current_task = nullptr;
+
+// The main thread gets a handle the first time it asks for one, like the Arduino loop task
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (current_task == nullptr) {
+        current_task = new NativeTask();
+    }
+    return current_task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_size,
+                                   void* arg, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    NativeTask* task = new NativeTask();
+    NativeTaskStart start = {function, arg, task};
+    std::thread([start]() {
+        current_task = start.task;
+        start.function(start.arg);
+    }).detach();
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+// Waits past the deadline return 0, like a timed-out ulTaskNotifyTake()
+template <typename Predicate>
+static bool wait_for(std::condition_variable& cv, std::unique_lock<std::mutex>& guard, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(guard, ready);
+        return true;
+    }
+    return cv.wait_for(guard, std::chrono::milliseconds(ticks), ready);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    NativeTask* task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> guard(task->lock);
+    if (!wait_for(task->signal, guard, ticks_to_wait, [task]() { return task->notifications > 0; })) {
+        return 0;
+    }
+    uint32_t value = task->notifications;
+    task->notifications = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (task == nullptr) {
+        return pdFALSE;
+    }
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifications++;
+    }
+    task->signal.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_woken) {
+    xTaskNotifyGive(task);
+    if (higher_priority_woken != nullptr) {
+        *higher_priority_woken = pdFALSE;
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    NativeQueue* queue = new NativeQueue();
+    queue->storage.resize(static_cast<size_t>(length) * item_size);
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait, bool to_front) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!wait_for(queue->changed, guard, ticks_to_wait, [queue]() { return queue->count < queue->length; })) {
+        return pdFALSE;
+    }
+    size_t slot;
+    if (to_front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    memcpy(queue->storage.data() + slot * queue->item_size, item, queue->item_size);
+    queue->count++;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    return queue_send(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!wait_for(queue->changed, guard, ticks_to_wait, [queue]() { return queue->count > 0; })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->storage.data() + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return static_cast<UBaseType_t>(queue->count);
+}
+
+// ============================================================================
+// WIFI AND HTTP
+// ============================================================================
+
+volatile uint32_t native_http_latency_us = 0;
+static std::atomic<uint32_t> http_requests(0);
+static std::atomic<uint64_t> http_bytes(0);
+volatile uint32_t native_http_fail_percent = 0;
+static std::atomic<uint32_t> http_failed(0);
+static std::atomic<uint32_t> http_malformed(0);
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* password) {
+    state = WL_CONNECTED;
+    if (event_callback != nullptr) {
+        event_callback(ARDUINO_EVENT_WIFI_STA_GOT_IP, WiFiEventInfo_t{0});
+    }
+    return state;
+}
+
+bool WiFiClass::disconnect() {
+    state = WL_DISCONNECTED;
+    return true;
+}
+
+bool HTTPClient::begin(WiFiClient& client, const char* host, uint16_t port, const char* uri) {
+    this->client = &client;
+    client.open = true;
+    return true;
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+    if (native_http_latency_us > 0) {
+        delayMicroseconds(native_http_latency_us);
+    }
+    uint32_t request = http_requests++;
+    http_bytes += size;
+    if (size > 0 && (payload[0] == '[' || payload[0] == '{') && (size < 2 || payload[1] == '[')) {
+        http_malformed++;
+    }
+    // Request n fails when the running failure quota crosses an integer at n
+    if ((request + 1) * native_http_fail_percent / 100 != request * native_http_fail_percent / 100) {
+        http_failed++;
+        return 500;
+    }
+    return HTTP_CODE_OK;
+}
+
+String HTTPClient::errorToString(int error) {
+    return String(error == HTTPC_ERROR_NOT_CONNECTED ? "not connected" : "error");
+}
+
+struct native_http_stats_t native_http_snapshot() {
+    struct native_http_stats_t snapshot = {
+        http_requests.load(), http_bytes.load(), http_failed.load(), http_malformed.load()
+    };
+    return snapshot;
+}
+
+// ============================================================================
+// LITTLEFS
+// ============================================================================
+
+static std::mutex fs_mutex;
+static std::map<std::string, std::shared_ptr<FlashBytes>> fs_files;
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!data || !writable) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> guard(fs_mutex);
+    if (data->size() < position + size) {
+        data->resize(position + size);
+    }
+    memcpy(data->data() + position, buffer, size);
+    position += size;
+    return size;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!data) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> guard(fs_mutex);
+    size_t available = position < data->size() ? data->size() - position : 0;
+    size_t count = size < available ? size : available;
+    memcpy(buffer, data->data() + position, count);
+    position += count;
+    return count;
+}
+
+bool File::seek(uint32_t offset) {
+    if (!data || offset > data->size()) {
+        return false;
+    }
+    position = offset;
+    return true;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    std::lock_guard<std::mutex> guard(fs_mutex);
+    auto it = fs_files.find(path);
+    if (mode[0] == 'r') {
+        return it != fs_files.end() ? File(it->second, false, 0) : File();
+    }
+    if (it == fs_files.end() || mode[0] == 'w') {
+        fs_files[path] = std::allocate_shared<FlashBytes>(FlashAllocator<FlashBytes>());
+        it = fs_files.find(path);
+    }
+    return File(it->second, true, mode[0] == 'a' ? it->second->size() : 0);
+}
+
+bool LittleFSFS::exists(const char* path) {
+    std::lock_guard<std::mutex> guard(fs_mutex);
+    std::string prefix = std::string(path) + "/";
+    for (const auto& entry : fs_files) {
+        if (entry.first == path || entry.first.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LittleFSFS::remove(const char* path) {
+    std::lock_guard<std::mutex> guard(fs_mutex);
+    return fs_files.erase(path) > 0;
+}
+
+// Directories are implied by the paths under them
+bool LittleFSFS::mkdir(const char* path) {
+    return true;
+}
+
+// ============================================================================
+// PREFERENCES
+// ============================================================================
+
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+
+bool Preferences::begin(const char* name, bool read_only) {
+    if (read_only && nvs.find(name) == nvs.end()) {
+        return false;
+    }
+    nvs[name];
+    this->name = name;
+    this->read_only = read_only;
+    return true;
+}
+
+void Preferences::end() {
+    name = nullptr;
+}
+
+bool Preferences::isKey(const char* key) {
+    return name != nullptr && nvs[name].count(key) > 0;
+}
+
+size_t Preferences::get_raw(const char* key, void* buffer, size_t length) {
+    if (!isKey(key) || nvs[name][key].size() > length) {
+        return 0;
+    }
+    const std::vector<uint8_t>& value = nvs[name][key];
+    memcpy(buffer, value.data(), value.size());
+    return value.size();
+}
+
+size_t Preferences::put_raw(const char* key, const void* value, size_t length) {
+    if (name == nullptr || read_only) {
+        return 0;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    nvs[name][key].assign(bytes, bytes + length);
+    return length;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t default_value) {
+    uint32_t value = default_value;
+    return get_raw(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t default_value) {
+    uint16_t value = default_value;
+    return get_raw(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+float Preferences::getFloat(const char* key, float default_value) {
+    float value = default_value;
+    return get_raw(key, &value, sizeof(value)) == sizeof(value) ? value : default_value;
+}
+
+size_t Preferences::getString(const char* key, char* value, size_t max_length) {
+    return get_raw(key, value, max_length);
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t length) {
+    return get_raw(key, buffer, length);
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    return put_raw(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char* key, uint16_t value) {
+    return put_raw(key, &value, sizeof(value));
+}
+
+size_t Preferences::putFloat(const char* key, float value) {
+    return put_raw(key, &value, sizeof(value));
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+    return put_raw(key, value, strlen(value) + 1);
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    return put_raw(key, value, length);
+}
@@ -0,0 +1,24 @@
+#ifndef ADR_H
+#define ADR_H
+
+#include <Arduino.h>
+#include "constants.h"
+#include "node_table.h"
+#include "message_struct.h"
+
+#ifdef ADR_ON
+struct adr_stats_t {
+    uint32_t commands;          // New TX power targets
+    uint32_t power_down;        // Commands lowering TX power
+    uint32_t power_up;          // Commands raising TX power
+    uint32_t resends;           // Settings sent again because the node did not report them yet
+};
+
+extern struct adr_stats_t adr_stats;
+
+void adr_record_frame(NodeState* node, uint8_t flags, float snr);
+bool adr_fill_settings(NodeState* node, struct AckMessage& ack);
+float adr_margin_db(const NodeState* node);
+#endif
+
+#endif // ADR_H
@@ -0,0 +1,30 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+#include <Arduino.h>
+#include "constants.h"
+
+#ifdef ALERTS_ON
+typedef enum {
+    ALERT_SOURCE_NODE,          // MSG_TYPE_ALERT frame from the node
+    ALERT_SOURCE_GATEWAY,       // Raised by the gateway rule engine
+} AlertSource;
+
+struct alert_stats_t {
+    uint32_t raised;            // Alerts queued, both sources
+    uint32_t from_nodes;        // Of those, sent by nodes
+    uint32_t delivered;         // Confirmed by the server
+    uint32_t retries;           // Sends that failed and were repeated
+    uint32_t dropped;           // Oldest queued alerts discarded to fit a new one
+    uint32_t last_latency_ms;   // Raise to server confirmation, last alert
+    uint32_t max_latency_ms;
+};
+
+extern struct alert_stats_t alert_stats;
+
+bool alert_raise(uint8_t client_id, uint8_t code, int16_t value, uint8_t severity, AlertSource source);
+void alert_service();
+uint16_t alert_pending();
+#endif
+
+#endif // ALERTS_H
@@ -3,13 +3,54 @@
 
 #include <Arduino.h>
 #include "constants.h"
+#include "message_struct.h"
+#include "processing.h"
 
 #ifdef BATCH_ON
-extern String batch_buffer[BATCH_SIZE];
-extern uint8_t batch_count;
+#define BINARY_BATCH_VERSION    3
+
+// Binary batch upload (POST SERVER_ENDPOINT_DATA_BIN), little-endian:
+// one header followed by `count` fixed-width records
+struct __attribute__((packed)) BinaryBatchHeader {
+    uint8_t     version;        // BINARY_BATCH_VERSION
+    uint8_t     gateway_id;     // Gateway NODE_ID
+    uint16_t    count;          // Number of records that follow
+    uint64_t    base_epoch_ms;  // Epoch (ms) the record offsets count from, 0 if time not synced
+};
+
+struct __attribute__((packed)) BinaryBatchRecord {
+    uint8_t     client_id;      // Node identifier
+    uint16_t    sequence;       // Node frame counter (added in version 2)
+    int32_t     offset_ms;      // Sample time minus base_epoch_ms; signed, as readings backdated
+                                // from a multi-reading frame can be older than earlier records
+                                // (version 3; versions 1-2 had a uint16 delta from the previous one)
+    int16_t     temperature;    // Temperature * 100 (°C), as sent by the node
+    uint16_t    humidity;       // Humidity * 100 (%)
+    uint16_t    distance_cm;    // Distance in centimeters
+    uint16_t    luminosity_lux; // Luminosity in lux
+    uint8_t     battery;        // Battery level (0-100%)
+    int8_t      rssi_dbm;       // RSSI, clamped to int8
+    int8_t      snr_qdb;        // SNR in quarter dB
+};
+
+// Flush thresholds, recomputed at runtime from uplink RTT and queue depth
+struct batch_policy_t {
+    uint16_t target_size;       // Readings per batch
+    uint32_t timeout_ms;        // Max wait of the oldest reading in the batch
+};
+
+extern uint16_t batch_count;
 extern uint32_t batch_start_time;
+extern struct batch_policy_t batch_policy;
 
-void add_to_batch(const String& json);
+bool add_to_batch(
+  const SensorDataMessage* msg,
+  float rssi,
+  float snr,
+  const struct sample_time_t& sampled,
+  bool sequenced = true
+);
+bool batch_due();
 void flush_batch();
 #endif
 
@@ -0,0 +1,34 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include "constants.h"
+
+// Runtime settings, loaded from NVS once at boot; defaults come from constants.h.
+// Hot paths read this struct, never NVS.
+struct gateway_config_t {
+    uint32_t stats_period_ms;
+    uint32_t batch_latency_budget_ms;
+    uint16_t batch_max_size;            // Capped at BATCH_MAX_SIZE (buffer capacity)
+    float    adr_margin_db;
+    // Network settings: stored on update, used from the next boot
+    char     wifi_ssid[33];
+    char     wifi_password[65];
+    char     server_host[64];
+    uint16_t server_port;
+};
+
+struct config_stats_t {
+    uint32_t updates;           // Remote updates applied
+    uint32_t rejected;          // Remote updates that did not parse or were out of range
+    uint32_t node_updates;      // Node settings queued for a downlink
+};
+
+extern struct gateway_config_t gateway_config;
+extern struct config_stats_t config_stats;
+
+void config_load();
+void config_queue_update(const char* body, size_t length);
+void config_service();
+
+#endif // CONFIG_STORE_H
@@ -3,9 +3,28 @@
 
 #define NODE_ID              23           // Max 255
 
-#define DEBUG
-// #define SIMUL_DATA
-#define SIMUL_PERIOD_MS         15000
+// Serial log (logger.h): LOG_LEVEL_NONE/ERROR/WARN/INFO/DEBUG; calls above the level compile out.
+// Deferred: callers only queue the format and arguments, a low-priority task does the UART output.
+#define LOG_LEVEL               LOG_LEVEL_INFO
+#define LOG_DEFERRED_ON
+#define LOG_RING_SIZE           32          // Messages waiting for the log task (newest dropped when full)
+#define LOG_MAX_ARGS            10          // Arguments per message
+#define LOG_TEXT_SIZE           64          // String argument bytes copied per message
+#define LOG_LINE_MAX_SIZE       256         // Formatted line
+#define LOG_TASK_CORE           0           // Away from loop() on core 1
+#define LOG_TASK_PRIORITY       1           // Below the RX and uplink tasks
+#define LOG_TASK_STACK_SIZE     3072
+
+// #define SIMUL_DATA                       // Virtual nodes feed the RX ring (loadgen.cpp)
+#define SIMUL_NODES             16          // Virtual nodes, client_id 1..SIMUL_NODES (max 255)
+#define SIMUL_RATE_FPS          2.0f        // Aggregate frames per second offered by all of them
+#define SIMUL_JITTER_PERCENT    20          // Per-node TX period jitter (+/-)
+#define SIMUL_DUPLICATE_PERCENT 5           // Frames sent twice, as after a lost ACK
+#define SIMUL_CORRUPT_PERCENT   2           // Frames with a flipped byte (checksum error)
+#define SIMUL_REBOOT_PERCENT    1           // Power cycles whose restart (sequence 0) frame is lost
+#define SIMUL_LEGACY_PERCENT    10          // Nodes on the original firmware (V1 readings, XOR trailer)
+#define SIMUL_TASK_PRIORITY     2           // Below the RX task, above loop()
+#define SIMUL_TASK_STACK_SIZE   3072
 #define STATS_PERIOD_MS         60000
 
 #define SERIAL_BAUD_RATE        115200      // Serial port baud rate
@@ -13,11 +32,25 @@
 #define WIFI_ON
 #define WIFI_SSID               "AndroidAP7827"
 #define WIFI_PASSWORD           "senhai123"
-#define WIFI_TIMEOUT_MS         10000
+#define WIFI_TIMEOUT_MS         10000       // Per-attempt connection timeout
+#define WIFI_BACKOFF_MIN_MS     1000        // First retry delay after a failure
+#define WIFI_BACKOFF_MAX_MS     60000       // Backoff cap
 #define SERVER_HOST             "10.41.90.35"
 #define SERVER_PORT             8080
 #define SERVER_ENDPOINT_DATA    "/api/sensor-data"
 #define SERVER_ENDPOINT_STATS   "/api/gateway-stats"
+#define SERVER_ENDPOINT_DATA_BIN "/api/sensor-data/bin"
+#define SERVER_ENDPOINT_ALERTS  "/api/alerts"
+
+// Asynchronous uplink: bounded queue drained by a sender task over a keep-alive connection
+#define UPLINK_QUEUE_DEPTH      4           // Outbound requests buffered for the sender task
+#define UPLINK_MAX_BODY_SIZE    8192        // Largest request body (bytes)
+#define UPLINK_RESPONSE_MAX_SIZE 1024       // Largest stats response read back (remote settings)
+#define UPLINK_HTTP_TIMEOUT_MS  5000        // Per-request HTTP timeout
+#define UPLINK_TASK_CORE        0           // Same core as the WiFi stack
+#define UPLINK_TASK_PRIORITY    2           // Below the LoRa RX task
+#define UPLINK_TASK_STACK_SIZE  8192        // Sender task stack (bytes)
+#define UPLINK_ALERT_RESERVED_SLOTS 1       // Queue slots only alerts may take
 
 #define LORA_PIN_CS             41          // SPI Chip Select (CS)
 #define LORA_PIN_RST            42          // LoRa module reset
@@ -38,14 +71,87 @@
 #define LORA_PREAMBLE_LENGTH    8           // Preamble symbols
 #define LORA_MAX_PACKET_SIZE    256         // Maximum LoRa packet size
 
+// Interrupt-driven RX: DIO1 wakes a dedicated task that drains the radio into a ring
+#define LORA_RX_RING_SIZE       16          // Raw frames buffered between RX task and processing
+#define LORA_RX_TASK_CORE       0           // Core for the RX task (loop() runs on core 1)
+#define LORA_RX_TASK_PRIORITY   5           // Above loop() so the radio is always serviced first
+#define LORA_RX_TASK_STACK_SIZE 4096        // RX task stack (bytes)
+#define LORA_RX_POLL_TIMEOUT_MS 1000        // Re-check IRQ status in case a DIO1 edge is missed
+#define LORA_DOWNLINK_QUEUE_DEPTH 4         // Downlinks waiting for the RX task to transmit
+#define LORA_DOWNLINK_MAX_SIZE  16          // Largest downlink frame (bytes)
+
+// Adaptive data rate: settings sent in the node's RX window when its link margin drifts.
+// This gateway demodulates a single SF, so nodes are kept on LORA_SPREADING_FACTOR and ADR
+// acts on TX power; the SF field lets a multi-SF gateway use the same downlink.
+#define ADR_ON
+#define ADR_SNR_HISTORY         8           // Uplinks whose best SNR defines the link margin
+#define ADR_MARGIN_DB           10.0        // Margin kept above the demodulation floor
+#define ADR_STEP_DB             3           // TX power step (dB) per step of excess margin
+#define ADR_TX_POWER_MIN_DBM    2           // Lowest power a node is told to use
+#define ADR_TX_POWER_MAX_DBM    20          // Highest power a node is told to use
+
 // #define BATCH_ON
-#define BATCH_SIZE              5
-#define BATCH_TIMEOUT_MS        30000
+// #define BATCH_BINARY                     // Upload batches as packed records instead of JSON
+#define BATCH_MIN_SIZE          2           // Batch size on an idle, fast uplink
+#define BATCH_MAX_SIZE          128         // Batch size under high RTT or backlog (buffer permitting)
+#define BATCH_LATENCY_BUDGET_MS 30000       // Max delay per reading: batch wait + queue wait + RTT
+#define BATCH_MIN_TIMEOUT_MS    1000        // Shortest batch wait, however slow the uplink
+#define BATCH_RTT_REFERENCE_MS  200         // Each multiple of this RTT adds BATCH_MIN_SIZE readings
+#define BATCH_BUFFER_SIZE       UPLINK_MAX_BODY_SIZE    // Serialized batch must fit one uplink request
+#define SENSOR_JSON_MAX_SIZE    384         // Largest serialized single reading (bytes)
+
+// Store-and-forward spool on LittleFS while the uplink is down
+#define SPOOL_ON
+#define SPOOL_SEGMENT_COUNT     8           // Log files rotated as a ring (spreads flash wear)
+#define SPOOL_SEGMENT_SIZE      32768       // Max bytes per segment file
+#define SPOOL_REPLAY_BATCH      12          // Frames per replay upload (bounded by UPLINK_MAX_BODY_SIZE)
+#define SPOOL_DRAIN_INTERVAL_MS 2000        // Minimum time between replay uploads
 
 #define MAX_DISTANCE_TO_BE_PRESENCE_CM 100         // Distance threshold for presence detection
 
-// Duplicate detection
-#define MAX_CLIENTS             8           // Maximum number of clients to track for duplicate detection
-#define DUPLICATE_WINDOW_MS     5000        // Time window to consider a packet as duplicate (ms)
+// Alert lane: threshold rules evaluated per reading at the gateway; alerts skip the batch
+// and go to the head of the uplink queue. Heartbeats are reported with the node stats.
+#define ALERTS_ON
+#define ALERT_TEMPERATURE_HIGH_C    40.0
+#define ALERT_TEMPERATURE_LOW_C     0.0
+#define ALERT_HUMIDITY_HIGH_PERCENT 80.0
+#define ALERT_HUMIDITY_LOW_PERCENT  20.0
+#define ALERT_DISTANCE_LOW_CM       MAX_DISTANCE_TO_BE_PRESENCE_CM
+#define ALERT_BATTERY_LOW_PERCENT   20
+#define ALERT_QUEUE_DEPTH           8       // Alerts waiting for the uplink (oldest not in flight dropped when full)
+#define ALERT_RETRY_MS              2000    // Wait before resending an alert that was not delivered
+
+// Energy model: current per power state, overridable from the server ("energy_current_ma" in config)
+#define CURRENT_CPU_ACTIVE_MA   40.0        // CPU running at 240 MHz (scaled with the frequency)
+#define CURRENT_CPU_IDLE_MA     20.0        // CPU waiting in the idle task at 240 MHz
+#define CURRENT_LORA_STANDBY_MA 0.6         // SX1262 standby
+#define CURRENT_LORA_RX_MA      5.3         // SX1262 continuous receive
+#define CURRENT_LORA_TX_MA      45.0        // SX1262 transmitting at LORA_TX_POWER
+#define CURRENT_WIFI_OFF_MA     0.0
+#define CURRENT_WIFI_CONNECT_MA 110.0       // Scan and association
+#define CURRENT_WIFI_IDLE_MA    100.0       // Associated, receiver listening
+#define CURRENT_WIFI_SLEEP_MA   25.0        // Associated, modem sleep (receiver on for beacons only)
+#define CURRENT_WIFI_TX_MA      200.0       // Average over an HTTP request
+#define ENERGY_UPDATE_INTERVAL_MS 1000      // Open intervals are closed at least this often
+
+// Power save: loop() sleeps until a LoRa frame, a WiFi event or the next deadline;
+// WiFi modem sleep between uplinks and CPU frequency scaling while idle
+// #define POWER_SAVE_ON
+#define POWER_IDLE_MAX_MS       1000        // Longest loop() sleep (bounds WiFi timeout/backoff checks)
+#define POWER_CPU_MAX_MHZ       240         // Clock while busy
+#define POWER_CPU_MIN_MHZ       80          // Clock while idle (lowest that keeps WiFi and an 80 MHz APB)
+
+// Hot-path tracing (trace.h): per-stage cycle histograms and a ring of recent events,
+// exported in the stats upload; compiled out when not defined
+// #define TRACE_ON
+#define TRACE_RING_SIZE         64          // Recent stage events kept
+#define TRACE_EXPORT_EVENTS     16          // Newest events included in the stats upload
+
+// Per-node state table (duplicate detection, loss accounting, per-node stats)
+#define NODE_TABLE_CAPACITY     128         // Nodes tracked per gateway (power of two)
+#define NODE_TABLE_MAX_PROBE    8           // Linear probe window; LRU eviction within it
+#define NODE_SEQUENCE_MAX_GAP   1024        // Larger forward jumps are treated as a node restart
+#define DUPLICATE_WINDOW_MS     5000        // Legacy (V1) frames: a repeated timestamp within this window is a duplicate
+#define NODE_STATS_REPORT_MAX   32          // Nodes per stats upload (rotates through the table, bounded by UPLINK_MAX_BODY_SIZE)
 
 #endif // CONSTANTS_H
@@ -3,17 +3,39 @@
 
 #include <Arduino.h>
 
+// Power states, grouped in domains (CPU, LoRa radio, WiFi). Each domain is in exactly one
+// state at a time; the gateway draws the sum of the three states' currents.
+typedef enum {
+    ENERGY_STATE_CPU_ACTIVE,
+    ENERGY_STATE_CPU_IDLE,          // loop() blocked waiting for work
+    ENERGY_STATE_LORA_STANDBY,
+    ENERGY_STATE_LORA_RX,           // Continuous receive, the radio's resting state
+    ENERGY_STATE_LORA_TX,           // Downlink transmission
+    ENERGY_STATE_WIFI_OFF,          // Disconnected, waiting out the backoff
+    ENERGY_STATE_WIFI_CONNECT,      // Scanning and associating
+    ENERGY_STATE_WIFI_IDLE,         // Associated, no request in flight
+    ENERGY_STATE_WIFI_SLEEP,        // Associated, modem sleep between uplinks
+    ENERGY_STATE_WIFI_TX,           // HTTP POST in flight
+    ENERGY_STATE_COUNT
+} EnergyState;
+
 struct energy_t {
     uint32_t start_time;
     float total_mah;
-    uint32_t last_calc_time;
+    uint64_t residency_ms[ENERGY_STATE_COUNT];  // Time spent in each state
+    float state_mah[ENERGY_STATE_COUNT];        // Charge drawn in each state
+    float current_ma[ENERGY_STATE_COUNT];       // Current table; CPU entries are at 240 MHz
 };
 extern struct energy_t energy;
 
-static const float CURRENT_ACTIVE_MA = 120.0f;
-static const float CURRENT_WIFI_TX_MA = 220.0f;
-static const float CURRENT_IDLE_MA = 20.0f;
-
+void energy_init();
+EnergyState energy_enter(EnergyState state);
+void energy_leave(EnergyState state, EnergyState next);
 void update_energy_consumption();
+void energy_snapshot(struct energy_t& out);
+bool energy_set_current(EnergyState state, float current_ma);
+void energy_set_idle_mhz(uint32_t mhz);
+const char* energy_state_name(EnergyState state);
+float energy_average_current_ma();
 
 #endif // ENERGY_MANAGER_H
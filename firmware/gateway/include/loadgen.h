@@ -0,0 +1,26 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <Arduino.h>
+#include "constants.h"
+
+#ifdef SIMUL_DATA
+// Synthetic nodes: one generator task per core pushes encoded frames into the RX ring,
+// so everything after the radio read runs exactly as for real traffic
+
+#define SIMUL_TASKS     2           // One generator per core
+
+struct loadgen_stats_t {
+    uint32_t generated;         // Frames offered to the RX ring, duplicates included
+    uint32_t duplicates;        // Frames sent twice, as after a lost ACK
+    uint32_t corrupted;         // Frames sent with a flipped byte
+    uint32_t reboots;           // Power cycles whose restart frame was lost
+    uint32_t ring_full;         // Frames the RX ring refused: the gateway is saturated
+};
+
+void init_loadgen();
+struct loadgen_stats_t loadgen_totals();
+float loadgen_offered_fps();
+#endif
+
+#endif // LOADGEN_H
@@ -0,0 +1,123 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <type_traits>
+#include "constants.h"
+
+#define LOG_LEVEL_NONE          0
+#define LOG_LEVEL_ERROR         1
+#define LOG_LEVEL_WARN          2
+#define LOG_LEVEL_INFO          3
+#define LOG_LEVEL_DEBUG         4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_NONE
+#endif
+
+// Levels above LOG_LEVEL expand to nothing: the arguments are not evaluated
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+struct log_stats_t {
+    uint32_t queued;            // Messages handed to the log task
+    uint32_t dropped;           // Lost because the ring was full
+};
+
+extern struct log_stats_t log_stats;
+
+// Starts the log task; messages written before this are printed synchronously
+void init_logger();
+
+#ifdef LOG_DEFERRED_ON
+// A message as captured by the caller: the format is kept by pointer (it must be a literal),
+// the arguments as raw values. Strings are copied since they may not outlive the call.
+union log_arg_t {
+    int64_t integer;            // Integers, and the offset into text for strings
+    double real;
+    const void* pointer;
+};
+
+struct log_entry_t {
+    const char* format;
+    uint8_t level;
+    uint8_t argc;
+    uint8_t text_length;
+    union log_arg_t args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+};
+
+void log_pack_string(struct log_entry_t& entry, const char* value);
+void log_submit(struct log_entry_t& entry);
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+log_pack_arg(struct log_entry_t& entry, T value) {
+    entry.args[entry.argc++].integer = static_cast<int64_t>(value);
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+log_pack_arg(struct log_entry_t& entry, T value) {
+    entry.args[entry.argc++].real = value;
+}
+
+template <typename T>
+inline void log_pack_arg(struct log_entry_t& entry, T* value) {
+    entry.args[entry.argc++].pointer = value;
+}
+
+inline void log_pack_arg(struct log_entry_t& entry, const char* value) {
+    log_pack_string(entry, value);
+}
+
+inline void log_pack_arg(struct log_entry_t& entry, char* value) {
+    log_pack_string(entry, value);
+}
+
+inline void log_pack(struct log_entry_t& entry) {}
+
+template <typename T, typename... Rest>
+inline void log_pack(struct log_entry_t& entry, T value, Rest... rest) {
+    log_pack_arg(entry, value);
+    log_pack(entry, rest...);
+}
+
+// Captures the call in a few stores; formatting and the UART wait happen in the log task
+template <typename... Args>
+inline void log_write(uint8_t level, const char* format, Args... args) {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments, raise LOG_MAX_ARGS");
+    struct log_entry_t entry;
+    entry.format = format;
+    entry.level = level;
+    entry.argc = 0;
+    entry.text_length = 0;
+    log_pack(entry, args...);
+    log_submit(entry);
+}
+#else
+void log_write(uint8_t level, const char* format, ...);
+#endif
+
+#endif // LOGGER_H
@@ -2,8 +2,12 @@
 #define LORA_H
 
 #include <RadioLib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
 #include "constants.h"
 #include "message_struct.h"
+#include "processing.h"
 
 class LoRaRadio {
   public:
@@ -13,17 +17,46 @@ class LoRaRadio {
           total_rx_packets(0),
           total_rx_valids(0),
           total_rx_invalids(0),
-          total_checksum_errors(0) {}
+          total_checksum_errors(0),
+          total_rx_legacy(0),
+          total_rx_dropped(0),
+          total_rx_crc_errors(0),
+          total_tx_downlinks(0),
+          total_tx_downlink_errors(0) {}
 
-        uint32_t total_rx_packets;
-        uint32_t total_rx_valids;
-        uint32_t total_rx_invalids;
-        uint32_t total_checksum_errors;
+        // Each counter has one writer: the RX task (under rx_ring_mux, push_frame also runs
+        // from the SIMUL_DATA generators) or the loop() core that processes the ring
+        uint32_t total_rx_packets;      // RX task
+        uint32_t total_rx_valids;       // loop()
+        uint32_t total_rx_invalids;     // loop(), including the radio CRC errors it picks up
+        uint32_t total_checksum_errors; // loop()
+        uint32_t total_rx_legacy;       // loop(): valid frames with the legacy XOR trailer (nodes to update)
+        uint32_t total_rx_dropped;      // RX task: frames lost because the RX ring was full
+        uint32_t total_rx_crc_errors;   // RX task: radio CRC mismatches, never queued
+        uint32_t total_tx_downlinks;    // RX task: downlinks (ACK/ADR) transmitted
+        uint32_t total_tx_downlink_errors;  // Both, under rx_ring_mux: queue full or TX failure
+    };
+
+    // Raw frame as read from the radio, queued for processing
+    struct RxFrame {
+        uint8_t data[LORA_MAX_PACKET_SIZE];
+        size_t length;
+        float rssi;
+        float snr;
+        struct sample_time_t received;  // Taken at RX-done, not when the loop gets to the frame
+    };
+
+    struct Downlink {
+        uint8_t data[LORA_DOWNLINK_MAX_SIZE];
+        size_t length;
     };
 
     static LoRaRadio& get_instance();
     void setup();
     void check_packets();
+    bool push_frame(const uint8_t* data, size_t length, float rssi, float snr);
+    bool queue_downlink(const uint8_t* data, size_t length);
+    uint16_t get_pending_frames() const;
     Stats& get_stats() {
         return stats;
     }
@@ -37,13 +70,29 @@ class LoRaRadio {
   private:
     LoRaRadio();
     static LoRaRadio* loRaRadio;
-    
+    static TaskHandle_t rx_task_handle;
+
+    static void IRAM_ATTR on_dio1();
+    static void rx_task(void* arg);
+    void service_radio();
+    void send_downlinks();
+
     SX1262 lora_handler;
-    
+
     Stats stats;
     uint32_t last_rx_time_ms;
-    
+    uint32_t reported_crc_errors;       // loop(): CRC errors already logged and counted as invalid
+
     uint8_t packet_rx_buffer[LORA_MAX_PACKET_SIZE];
+
+    // Ring filled by the RX task (core LORA_RX_TASK_CORE), drained by check_packets()
+    RxFrame rx_ring[LORA_RX_RING_SIZE];
+    volatile uint16_t rx_ring_head;
+    volatile uint16_t rx_ring_tail;
+    portMUX_TYPE rx_ring_mux;
+
+    // Downlinks queued from processing, transmitted by the RX task between receptions
+    QueueHandle_t downlink_queue;
 };
 
 #endif // LORA_H
@@ -0,0 +1,63 @@
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <Arduino.h>
+#include "constants.h"
+#include "message_struct.h"
+
+// Per-node state, one slot per client_id, shared by dedup, per-node stats and loss accounting
+struct NodeState {
+    uint8_t     client_id;                      // 0 = free slot
+    uint32_t    first_seen_ms;                  // millis() when the node was (re)inserted
+    uint32_t    last_seen_ms;                   // millis() of the last frame, drives LRU eviction
+    uint32_t    last_timestamp;                 // Node timestamp of the last accepted reading
+    uint32_t    last_accepted_ms;               // millis() when that reading was accepted
+    bool        sequence_valid;                 // highest_sequence has been seeded
+    uint16_t    highest_sequence;               // Newest sequence number accepted
+    uint32_t    sequence_window;                // Bit i set: highest_sequence - i was received
+    uint16_t    window_timestamps[32];          // Low 16 bits of the node timestamp of sequence s, at s % 32
+    float       last_rssi;
+    float       last_snr;
+    uint32_t    rx_frames;                      // All valid frames, duplicates included
+    uint32_t    accepted;                       // Distinct readings passed on for processing
+    uint32_t    duplicates;                     // Readings dropped as duplicates
+    uint32_t    lost;                           // Sequence gaps not (yet) filled in
+    uint32_t    reordered;                      // Readings that arrived after a newer one
+    uint32_t    resets;                         // Sequence restarts (node lost its RTC memory)
+    float       snr_history[ADR_SNR_HISTORY];   // Recent uplink SNRs, for the ADR margin
+    uint8_t     snr_next;
+    uint8_t     snr_count;
+    int8_t      tx_power_dbm;                   // Power the node last reported (the default until it does)
+    bool        tx_power_reported;              // Frames carry the node's TX power (see encode_tx_power)
+    int8_t      adr_target_dbm;                 // Power ADR asked for; != tx_power_dbm while unconfirmed
+    uint32_t    downlinks;                      // Downlinks queued for this node
+    uint16_t    awake_ms;                       // Node's last reported wake-to-sleep time
+    uint8_t     config_pending;                 // Bit k set: config_values[k] awaits a downlink
+    uint32_t    config_values[CONFIG_KEY_COUNT];    // Indexed by ConfigKey
+    uint8_t     alerts_active;                  // Bit i set: gateway rule i is raised
+    uint8_t     heartbeat_status;               // NodeStatus flags of the last heartbeat
+    uint32_t    heartbeats;
+    uint32_t    last_heartbeat_ms;
+};
+
+struct node_table_stats_t {
+    uint16_t tracked;           // Occupied slots
+    uint32_t inserts;           // New nodes added
+    uint32_t evictions;         // Nodes replaced because their probe window was full
+    uint32_t accepted;          // Sums over all nodes, kept across evictions
+    uint32_t lost;
+    uint32_t reordered;
+};
+
+extern struct node_table_stats_t node_table_stats;
+
+NodeState* node_table_find(uint8_t client_id);
+NodeState* node_table_touch(uint8_t client_id, float rssi, float snr);
+bool node_table_accept(NodeState* node, uint16_t sequence, bool restarted, uint32_t timestamp);
+bool node_table_accept_legacy(NodeState* node, uint32_t timestamp);
+const NodeState* node_table_slot(uint16_t index);
+float node_loss_percent(uint32_t accepted, uint32_t lost);
+void node_table_queue_config(NodeState* node, ConfigKey key, uint32_t value);
+bool node_table_next_config(NodeState* node, ConfigKey& key, uint32_t& value);
+
+#endif // NODE_TABLE_H
@@ -0,0 +1,22 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+#include "constants.h"
+
+struct power_stats_t {
+    uint32_t sleeps;            // loop() waits that actually blocked
+    uint32_t early_wakes;       // Waits cut short by a frame, WiFi event or finished uplink
+    uint32_t slept_ms;          // Total time loop() spent blocked
+    bool     dfs_enabled;       // ESP-IDF power management accepted the frequency range
+};
+
+extern struct power_stats_t power_stats;
+
+// Without POWER_SAVE_ON these are no-ops, so callers need no #ifdef
+void init_power();
+void power_idle(uint32_t max_wait_ms);
+void power_wake();
+void power_modem_sleep(bool enable);
+
+#endif // POWER_H
@@ -4,13 +4,37 @@
 #include <Arduino.h>
 #include "message_struct.h"
 
+// When a reading was taken, on both clocks: uptime orders readings within a batch and
+// recovers pre-sync spool records, epoch is what goes upstream (0 if time was not synced)
+struct sample_time_t {
+    uint32_t uptime_ms;
+    uint64_t epoch_ms;
+};
+
 void process_rx_lora_message(
   uint8_t* data,
   size_t length,
   float rssi,
-  float snr
+  float snr,
+  const struct sample_time_t& received
+);
+// sequenced is false for readings from nodes whose frames carry no sequence (SensorDataMessageV1)
+void handle_sensor_data(
+  const SensorDataMessage* msg,
+  float rssi,
+  float snr,
+  const struct sample_time_t& sampled,
+  bool sequenced = true
+);
+size_t write_sensor_json(
+  char* out,
+  size_t capacity,
+  const SensorDataMessage* msg,
+  float rssi,
+  float snr,
+  uint64_t rx_epoch_ms = 0,
+  bool sequenced = true
 );
-void handle_sensor_data(SensorDataMessage* msg, float rssi, float snr);
 uint32_t get_duplicate_count();
 
 #endif // PROCESSING_H
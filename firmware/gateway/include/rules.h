@@ -0,0 +1,13 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <Arduino.h>
+#include "constants.h"
+#include "message_struct.h"
+#include "node_table.h"
+
+#ifdef ALERTS_ON
+void rules_evaluate(NodeState* node, const SensorDataMessage* msg);
+#endif
+
+#endif // RULES_H
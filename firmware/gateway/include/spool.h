@@ -0,0 +1,27 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <Arduino.h>
+#include "constants.h"
+#include "processing.h"
+#include "uplink.h"
+
+#ifdef SPOOL_ON
+struct spool_stats_t {
+    uint32_t stored;            // Records written to flash: frames, or request bodies not delivered
+    uint32_t replayed;          // Records confirmed delivered from flash
+    uint32_t overwritten;       // Oldest frames lost because the ring was full
+    uint32_t errors;            // Flash write/read failures and corrupt records
+};
+
+extern struct spool_stats_t spool_stats;
+
+void init_spool();
+bool spool_store(const uint8_t* frame, size_t length, float rssi, float snr, const struct sample_time_t& sampled);
+bool spool_store_body(UplinkKind kind, const char* body, size_t length);
+void spool_store_undelivered(UplinkKind kind, const char* body, size_t length);
+void spool_drain();
+bool spool_is_empty();
+#endif
+
+#endif // SPOOL_H
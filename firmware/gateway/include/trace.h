@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include "constants.h"
+
+// Hot-path stages, from the radio interrupt to the server answer
+typedef enum {
+    TRACE_RX_IRQ,           // DIO1 interrupt until the RX task services it
+    TRACE_READ_DATA,        // SX1262 readData()
+    TRACE_CHECKSUM,         // Frame checksum
+    TRACE_DEDUP,            // node_table_accept()
+    TRACE_JSON,             // write_sensor_json()
+    TRACE_ENQUEUE,          // uplink_enqueue()
+    TRACE_POST,             // HTTP POST and response, on the uplink task
+    TRACE_STAGE_COUNT,
+} TraceStage;
+
+#ifdef TRACE_ON
+// Stage durations are CPU cycles (esp_cpu_get_cycle_count()). Each stage runs in a task
+// pinned to one core, so start and end read the same counter; the IRQ stage crosses
+// cores and is taken with esp_timer instead. Each stage is recorded by a single task,
+// the event ring accepts writers from every task.
+
+struct trace_event_t {
+    uint8_t  stage;             // TraceStage
+    uint8_t  core;
+    uint32_t cycles;
+    uint32_t time_ms;           // millis() at the end of the stage
+};
+
+struct trace_summary_t {
+    uint32_t count;
+    float    p50_us;
+    float    p99_us;
+    float    max_us;
+};
+
+#define TRACE_BEGIN(var)        uint32_t var = trace_cycles()
+#define TRACE_END(stage, var)   trace_record(stage, var)
+#define TRACE_IRQ()             trace_irq()
+#define TRACE_IRQ_SERVICED()    trace_irq_serviced()
+
+uint32_t trace_cycles();
+void trace_record(TraceStage stage, uint32_t start_cycles);
+void IRAM_ATTR trace_irq();
+void trace_irq_serviced();
+
+const char* trace_stage_name(TraceStage stage);
+uint32_t trace_cpu_mhz();
+void trace_summary(TraceStage stage, struct trace_summary_t& out);
+uint16_t trace_recent(struct trace_event_t* out, uint16_t max_events);
+#else
+#define TRACE_BEGIN(var)        do {} while (0)
+#define TRACE_END(stage, var)   do {} while (0)
+#define TRACE_IRQ()             do {} while (0)
+#define TRACE_IRQ_SERVICED()    do {} while (0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,54 @@
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <Arduino.h>
+
+typedef enum {
+    UPLINK_SENSOR_DATA,
+    UPLINK_SENSOR_DATA_BIN,
+    UPLINK_GATEWAY_STATS,
+    UPLINK_ALERT,               // Sent ahead of queued requests
+} UplinkKind;
+
+struct uplink_result_t {
+    UplinkKind kind;
+    int http_code;
+    uint32_t latency_ms;
+    size_t length;
+    const char* response;       // Response body, read for UPLINK_GATEWAY_STATS only
+    size_t response_length;
+};
+
+// Called from the sender task once a request completes (or fails)
+typedef void (*uplink_callback_t)(const struct uplink_result_t& result);
+
+// Called from loop() with a body the server did not confirm (HTTP 200/201), see uplink_reclaim()
+typedef void (*uplink_reclaim_t)(UplinkKind kind, const char* body, size_t length);
+
+struct uplink_stats_t {
+    uint32_t enqueued;
+    uint32_t dropped;           // Rejected because the queue was full (or the body too large)
+    uint32_t oversized;         // Rejected because the body exceeds UPLINK_MAX_BODY_SIZE
+    uint32_t undelivered;       // Reclaimable bodies the server did not confirm
+    uint32_t connections;       // New TCP connections opened
+    uint32_t reused;            // Requests sent over an existing connection
+};
+
+// Written by loop() (enqueue) and the sender task (connections); read it through the snapshot
+extern struct uplink_stats_t uplink_stats;
+
+void init_uplink();
+void uplink_stats_snapshot(struct uplink_stats_t& out);
+// reclaim: an undelivered body is kept in its slot for uplink_reclaim() instead of discarded
+bool uplink_enqueue(
+  UplinkKind kind,
+  const char* body,
+  size_t length,
+  uplink_callback_t callback,
+  bool reclaim = false
+);
+uint16_t uplink_pending();
+bool uplink_has_room(UplinkKind kind);
+void uplink_reclaim(uplink_reclaim_t store);
+
+#endif // UPLINK_H
@@ -2,6 +2,7 @@
 #define WIFI_H
 
 #include <Arduino.h>
+#include "uplink.h"
 
 
 extern bool wifi_connected;
@@ -19,17 +20,35 @@ struct latency_t {
     uint32_t min_ms;
     uint32_t max_ms;
     uint32_t last_ms;
+    uint32_t ewma_ms;           // Smoothed RTT (alpha = 1/8), drives adaptive batching
 };
 
+struct wifi_stats_t {
+    uint32_t connect_attempts;  // WiFi.begin() calls, including the first
+    uint32_t reconnects;        // Successful connections after the first attempt
+    uint32_t disconnects;       // Connection losses
+    uint32_t downtime_ms;       // Time without connectivity, closed outages only
+};
+
+// Updated by the uplink task: read them through server_stats_snapshot(). latency.ewma_ms alone
+// is a single aligned word and may be read directly (adaptive batching reads it per reading).
 extern struct server_stats_t server_stats;
+extern struct wifi_stats_t wifi_stats;
 extern struct latency_t latency;
 
 void init_wifi();
 void check_wifi_connection();
+uint32_t get_wifi_downtime_ms();
 int get_current_wifi_rssi();
-void forward_to_server(const char* json_data);
+bool forward_to_server(const char* json_data, size_t length);
+bool forward_to_server(UplinkKind kind, const char* data, size_t length);
 void send_gateway_statistics();
+void server_stats_snapshot(struct server_stats_t& server, struct latency_t& rtt);
 String build_gateway_stats_json();
 String get_iso8601_timestamp();
+size_t format_iso8601_timestamp(char* out, size_t size);
+size_t format_epoch_timestamp(char* out, size_t size, uint64_t epoch_ms);
+uint64_t get_epoch_ms();
+uint64_t get_sample_epoch_ms(uint32_t age_ms);
 
 #endif
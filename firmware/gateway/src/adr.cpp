@@ -0,0 +1,105 @@
+#include "adr.h"
+#include "logger.h"
+#include "message_struct.h"
+#include "config_store.h"
+#include "protocol.h"
+#include <math.h>
+
+#ifdef ADR_ON
+struct adr_stats_t adr_stats = {0, 0, 0, 0};
+
+// Lowest SNR (dB) the SX1262 demodulates at each SF, from the datasheet
+static float required_snr_db(uint8_t spreading_factor) {
+    switch (spreading_factor) {
+    case 7:  return -7.5f;
+    case 8:  return -10.0f;
+    case 9:  return -12.5f;
+    case 10: return -15.0f;
+    case 11: return -17.5f;
+    default: return -20.0f;
+    }
+}
+
+// Best recent SNR above the floor, minus the safety margin; 0 until enough uplinks are seen
+float adr_margin_db(const NodeState* node) {
+    if (node->snr_count < ADR_SNR_HISTORY) {
+        return 0.0f;
+    }
+    float best_snr = node->snr_history[0];
+    for (uint8_t i = 1; i < ADR_SNR_HISTORY; i++) {
+        if (node->snr_history[i] > best_snr) {
+            best_snr = node->snr_history[i];
+        }
+    }
+    return best_snr - required_snr_db(LORA_SPREADING_FACTOR) - gateway_config.adr_margin_db;
+}
+
+static int8_t target_power_dbm(const NodeState* node) {
+    int steps = static_cast<int>(floorf(adr_margin_db(node) / ADR_STEP_DB));
+    int power = node->tx_power_dbm - steps * ADR_STEP_DB;
+    if (power < ADR_TX_POWER_MIN_DBM) power = ADR_TX_POWER_MIN_DBM;
+    if (power > ADR_TX_POWER_MAX_DBM) power = ADR_TX_POWER_MAX_DBM;
+    return power;
+}
+
+// The power a node reports is the only confirmation a settings downlink arrived: until
+// it changes, tx_power_dbm and the SNR history stay as they are.
+void adr_record_frame(NodeState* node, uint8_t flags, float snr) {
+    int8_t reported;
+    if (decode_tx_power(flags, reported)) {
+        node->tx_power_reported = true;
+        if (reported != node->tx_power_dbm) {
+            node->tx_power_dbm = reported;
+            node->adr_target_dbm = reported;    // Confirmed, or the node fell back (e.g. reset)
+            // Old samples were taken at the previous power
+            node->snr_count = 0;
+        }
+    }
+
+    node->snr_history[node->snr_next] = snr;
+    node->snr_next = (node->snr_next + 1) % ADR_SNR_HISTORY;
+    if (node->snr_count < ADR_SNR_HISTORY) {
+        node->snr_count++;
+    }
+}
+
+// Adds radio settings to a downlink when the node's margin drifted, or when the last
+// ones were not confirmed yet; false if none are due. Nodes that do not report their
+// power get no commands, since nothing would tell whether one was applied.
+bool adr_fill_settings(NodeState* node, AckMessage& ack) {
+    if (!node->tx_power_reported) {
+        return false;
+    }
+    if (node->adr_target_dbm != node->tx_power_dbm) {
+        adr_stats.resends++;
+        ack.flags |= ACK_FLAG_RADIO_SETTINGS;
+        ack.spreading_factor = LORA_SPREADING_FACTOR;
+        ack.tx_power_dbm = node->adr_target_dbm;
+        return true;
+    }
+    int8_t power = target_power_dbm(node);
+    if (power == node->tx_power_dbm) {
+        return false;
+    }
+
+    ack.flags |= ACK_FLAG_RADIO_SETTINGS;
+    ack.spreading_factor = LORA_SPREADING_FACTOR;
+    ack.tx_power_dbm = power;
+
+    LOG_DEBUG(
+      "ADR - Node %u: margin %.1f dB, TX power %d -> %d dBm\n",
+      node->client_id,
+      adr_margin_db(node),
+      node->tx_power_dbm,
+      power
+    );
+    if (power < node->tx_power_dbm) {
+        adr_stats.power_down++;
+    } else {
+        adr_stats.power_up++;
+    }
+    adr_stats.commands++;
+    node->adr_target_dbm = power;
+    return true;
+}
+#endif
@@ -0,0 +1,201 @@
+#include "alerts.h"
+#include "protocol.h"
+#include "logger.h"
+#include "wifi.h"
+#include "uplink.h"
+#include "message_struct.h"
+#include <HTTPClient.h>
+
+#ifdef ALERTS_ON
+struct PendingAlert {
+    uint8_t client_id;
+    uint8_t code;               // AlertCode
+    int16_t value;              // Encoded like the reading it comes from
+    uint8_t severity;
+    uint8_t source;             // AlertSource
+    uint32_t raised_ms;         // millis() when raised, for latency and the epoch timestamp
+};
+
+struct alert_stats_t alert_stats = {0, 0, 0, 0, 0, 0, 0};
+
+// FIFO of alerts not yet confirmed; the oldest one is the one in flight
+static_assert(ALERT_QUEUE_DEPTH >= 2, "a full queue must hold more than the alert in flight");
+static PendingAlert queue[ALERT_QUEUE_DEPTH];
+static uint8_t queue_head = 0;
+static uint8_t queue_count = 0;
+
+// Send in flight on the uplink task; the result is applied from alert_service()
+static volatile bool send_in_flight = false;
+static volatile int8_t send_result = 0;     // 0 = pending, 1 = delivered, -1 = failed
+static uint32_t retry_at = 0;
+
+static const char* alert_type_name(uint8_t code) {
+    switch (code) {
+    case ALERT_TEMPERATURE_HIGH:    return "high_temperature";
+    case ALERT_TEMPERATURE_LOW:     return "low_temperature";
+    case ALERT_HUMIDITY_HIGH:       return "high_humidity";
+    case ALERT_HUMIDITY_LOW:        return "low_humidity";
+    case ALERT_DISTANCE_LOW:        return "presence";
+    case ALERT_BATTERY_LOW:         return "low_battery";
+    default:                        return "unknown";
+    }
+}
+
+// Temperature and humidity travel as value * 100, like in SensorDataMessage
+static float alert_value(const PendingAlert& alert) {
+    switch (alert.code) {
+    case ALERT_TEMPERATURE_HIGH:
+    case ALERT_TEMPERATURE_LOW:
+        return decode_temperature(alert.value);
+    case ALERT_HUMIDITY_HIGH:
+    case ALERT_HUMIDITY_LOW:
+        return decode_humidity(static_cast<uint16_t>(alert.value));
+    default:
+        return alert.value;
+    }
+}
+
+// Drops the oldest alert that is not being sent; the one in flight stays until its result
+static void drop_oldest_alert() {
+    uint8_t victim = send_in_flight ? 1 : 0;
+    const PendingAlert& lost = queue[(queue_head + victim) % ALERT_QUEUE_DEPTH];
+    alert_stats.dropped++;
+    LOG_WARN("Alert queue full - oldest %s from node %u dropped\n", alert_type_name(lost.code), lost.client_id);
+
+    if (victim == 0) {
+        queue_head = (queue_head + 1) % ALERT_QUEUE_DEPTH;
+    } else {
+        for (uint8_t i = victim; i + 1 < queue_count; i++) {
+            queue[(queue_head + i) % ALERT_QUEUE_DEPTH] = queue[(queue_head + i + 1) % ALERT_QUEUE_DEPTH];
+        }
+    }
+    queue_count--;
+}
+
+// A full queue makes room by dropping its oldest alert: the newest state matters most
+bool alert_raise(uint8_t client_id, uint8_t code, int16_t value, uint8_t severity, AlertSource source) {
+    if (queue_count == ALERT_QUEUE_DEPTH) {
+        drop_oldest_alert();
+    }
+
+    PendingAlert& alert = queue[(queue_head + queue_count) % ALERT_QUEUE_DEPTH];
+    alert.client_id = client_id;
+    alert.code = code;
+    alert.value = value;
+    alert.severity = severity;
+    alert.source = source;
+    alert.raised_ms = millis();
+    queue_count++;
+
+    alert_stats.raised++;
+    if (source == ALERT_SOURCE_NODE) {
+        alert_stats.from_nodes++;
+    }
+    LOG_INFO(
+      "ALERT %s - node %u: %s = %.2f (severity %u)\n",
+      source == ALERT_SOURCE_NODE ? "from node" : "raised",
+      client_id,
+      alert_type_name(code),
+      alert_value(alert),
+      severity
+    );
+    return true;
+}
+
+static size_t write_alert_json(char* out, size_t capacity, const PendingAlert& alert) {
+    char timestamp[40];
+    format_iso8601_timestamp(timestamp, sizeof(timestamp));
+
+    uint32_t age_ms = millis() - alert.raised_ms;
+    char epoch_field[40] = "";
+    uint64_t raised_epoch_ms = get_sample_epoch_ms(age_ms);
+    if (raised_epoch_ms != 0) {
+        snprintf(epoch_field, sizeof(epoch_field), ",\"epoch_ms\":%llu", static_cast<unsigned long long>(raised_epoch_ms));
+    }
+
+    int written = snprintf(
+        out,
+        capacity,
+        "{\"node_id\":\"node-%u\",\"NODE_ID\":%d,\"timestamp\":\"%s\"%s,"
+        "\"alert_type\":\"%s\",\"code\":%u,\"value\":%.2f,\"severity\":%u,"
+        "\"source\":\"%s\",\"age_ms\":%lu}",
+        alert.client_id,
+        NODE_ID,
+        timestamp,
+        epoch_field,
+        alert_type_name(alert.code),
+        alert.code,
+        alert_value(alert),
+        alert.severity,
+        alert.source == ALERT_SOURCE_NODE ? "node" : "gateway",
+        static_cast<unsigned long>(age_ms)
+    );
+    if (written <= 0 || static_cast<size_t>(written) >= capacity) {
+        return 0;
+    }
+    return written;
+}
+
+// Runs on the uplink sender task
+static void on_alert_uplink_complete(const struct uplink_result_t& result) {
+    bool delivered = result.http_code == HTTP_CODE_OK || result.http_code == HTTP_CODE_CREATED;
+    send_result = delivered ? 1 : -1;
+}
+
+static void apply_send_result() {
+    if (send_result > 0) {
+        const PendingAlert& alert = queue[queue_head];
+        alert_stats.last_latency_ms = millis() - alert.raised_ms;
+        if (alert_stats.last_latency_ms > alert_stats.max_latency_ms) {
+            alert_stats.max_latency_ms = alert_stats.last_latency_ms;
+        }
+        alert_stats.delivered++;
+        LOG_INFO("Alert delivered in %u ms\n", alert_stats.last_latency_ms);
+
+        queue_head = (queue_head + 1) % ALERT_QUEUE_DEPTH;
+        queue_count--;
+    } else {
+        alert_stats.retries++;
+        retry_at = millis() + ALERT_RETRY_MS;
+    }
+    send_result = 0;
+    send_in_flight = false;
+}
+
+// Called from loop() right after the received frames are processed; one alert in flight
+// at a time, so they reach the server in order
+void alert_service() {
+    if (send_in_flight) {
+        if (send_result == 0) {
+            return;
+        }
+        apply_send_result();
+    }
+    if (queue_count == 0 || !wifi_connected) {
+        return;
+    }
+    if (static_cast<int32_t>(millis() - retry_at) < 0) {
+        return;
+    }
+
+    char json[SENSOR_JSON_MAX_SIZE];
+    size_t length = write_alert_json(json, sizeof(json), queue[queue_head]);
+    if (length == 0) {
+        // Cannot happen with the fixed format; drop rather than block the lane
+        queue_head = (queue_head + 1) % ALERT_QUEUE_DEPTH;
+        queue_count--;
+        return;
+    }
+
+    send_result = 0;
+    send_in_flight = true;
+    if (!uplink_enqueue(UPLINK_ALERT, json, length, on_alert_uplink_complete)) {
+        send_in_flight = false;
+        retry_at = millis() + ALERT_RETRY_MS;
+    }
+}
+
+uint16_t alert_pending() {
+    return queue_count;
+}
+#endif
@@ -1,48 +1,181 @@
 #include "batch.h"
-#include "utils.h"
+#include "logger.h"
 #include "message_struct.h"
+#include "processing.h"
 #include "wifi.h"
-#include <ArduinoJson.h>
+#include "uplink.h"
+#include "lora.h"
+#include "config_store.h"
+#include "spool.h"
+#include <math.h>
 
 
 
 #ifdef BATCH_ON
-String batch_buffer[BATCH_SIZE];
-uint8_t batch_count = 0;
+// Readings are serialized once, straight into the array framing: '[' obj ',' obj ... ']'
+static char batch_buffer[BATCH_BUFFER_SIZE];
+static size_t batch_length = 0;
+uint16_t batch_count = 0;
 uint32_t batch_start_time = 0;
 
-void add_to_batch(const String& json) {
+struct batch_policy_t batch_policy = {BATCH_MIN_SIZE, BATCH_LATENCY_BUDGET_MS};
+
+// Re-derives the flush thresholds from the smoothed uplink RTT and the backlog.
+// A slow or busy uplink gets fewer, larger requests; an idle one gets small, prompt ones.
+// The timeout keeps the oldest reading within the configured latency budget end-to-end:
+// its wait in the batch, then one RTT per queued request ahead of it, then its own.
+static void update_batch_policy() {
+    uint32_t rtt_ms = latency.ewma_ms;
+    uint32_t budget_ms = gateway_config.batch_latency_budget_ms;
+    uint16_t max_size = gateway_config.batch_max_size;
+    uint32_t queued = uplink_pending();
+    uint32_t backlog = queued + LoRaRadio::get_instance().get_pending_frames();
+
+    uint32_t size = BATCH_MIN_SIZE * (1 + rtt_ms / BATCH_RTT_REFERENCE_MS + backlog);
+    batch_policy.target_size = size > max_size ? max_size : size;
+
+    uint32_t delivery_ms = rtt_ms * (queued + 1);
+    batch_policy.timeout_ms = delivery_ms + BATCH_MIN_TIMEOUT_MS >= budget_ms
+        ? BATCH_MIN_TIMEOUT_MS : budget_ms - delivery_ms;
+}
+
+#ifdef BATCH_BINARY
+static uint32_t batch_base_uptime_ms = 0;    // Uptime the first record was sampled at
+static uint64_t batch_base_epoch_ms = 0;
+
+static int8_t clamp_int8(float value) {
+    if (value > 127.0f) return 127;
+    if (value < -128.0f) return -128;
+    return static_cast<int8_t>(lroundf(value));
+}
+
+// Records always carry a sequence: handle_sensor_data() sends readings without one as JSON
+static bool append_to_batch(const SensorDataMessage* msg, float rssi, float snr, const struct sample_time_t& sampled, bool) {
+    if (batch_length == 0) {
+        batch_length = sizeof(BinaryBatchHeader);  // Header is filled in on flush
+    }
+    if (batch_length + sizeof(BinaryBatchRecord) > BATCH_BUFFER_SIZE) {
+        return false;
+    }
+
     if (batch_count == 0) {
-        batch_start_time = millis();
+        batch_base_uptime_ms = sampled.uptime_ms;
+        batch_base_epoch_ms = sampled.epoch_ms;
+    }
+    // Any order fits: a batch spans its timeout plus the age of backdated readings, far
+    // from the +/-24 days of an int32
+    int32_t offset_ms = static_cast<int32_t>(sampled.uptime_ms - batch_base_uptime_ms);
+
+    BinaryBatchRecord record;
+    record.client_id = msg->client_id;
+    record.sequence = msg->sequence;
+    record.offset_ms = offset_ms;
+    record.temperature = msg->temperature;
+    record.humidity = msg->humidity;
+    record.distance_cm = msg->distance_cm;
+    record.luminosity_lux = msg->luminosity_lux;
+    record.battery = msg->battery;
+    record.rssi_dbm = clamp_int8(rssi);
+    record.snr_qdb = clamp_int8(snr * 4.0f);
+
+    memcpy(batch_buffer + batch_length, &record, sizeof(record));
+    batch_length += sizeof(record);
+    return true;
+}
+#else
+static bool append_to_batch(const SensorDataMessage* msg, float rssi, float snr, const struct sample_time_t& sampled, bool sequenced) {
+    // Reserve room for the separator before the object and the closing ']' + NUL
+    const size_t reserved = 1 + 2;
+    if (batch_length + reserved >= BATCH_BUFFER_SIZE) {
+        return false;
+    }
+
+    size_t written = write_sensor_json(
+        batch_buffer + batch_length + 1,
+        BATCH_BUFFER_SIZE - batch_length - reserved,
+        msg,
+        rssi,
+        snr,
+        sampled.epoch_ms,
+        sequenced
+    );
+    if (written == 0) {
+        return false;
     }
 
-    batch_buffer[batch_count++] = json;
-    print_log("Adding messages to batch: %d/%d\n", batch_count, BATCH_SIZE);
+    batch_buffer[batch_length] = (batch_count == 0) ? '[' : ',';
+    batch_length += 1 + written;
+    return true;
+}
+#endif
 
-    if (batch_count >= BATCH_SIZE) {
+bool add_to_batch(const SensorDataMessage* msg, float rssi, float snr, const struct sample_time_t& sampled, bool sequenced) {
+    if (!append_to_batch(msg, rssi, snr, sampled, sequenced)) {
+        // Buffer full: ship what we have and start a new batch with this reading
         flush_batch();
+        if (!append_to_batch(msg, rssi, snr, sampled, sequenced)) {
+            LOG_WARN("Reading does not fit in an empty batch buffer, dropped\n");
+            return false;
+        }
     }
+
+    if (batch_count == 0) {
+        batch_start_time = millis();
+    }
+    batch_count++;
+    update_batch_policy();
+    LOG_DEBUG("Adding messages to batch: %d/%d (%u bytes)\n", batch_count, batch_policy.target_size, batch_length);
+
+    if (batch_count >= batch_policy.target_size) {
+        flush_batch();
+    }
+    return true;
+}
+
+bool batch_due() {
+    if (batch_count == 0) {
+        return false;
+    }
+    update_batch_policy();
+    return millis() - batch_start_time >= batch_policy.timeout_ms;
+}
+
+// A batch the uplink queue refused is spooled whole, like one the server did not confirm
+static void forward_batch(UplinkKind kind, const char* body, size_t length) {
+    if (forward_to_server(kind, body, length)) {
+        return;
+    }
+#ifdef SPOOL_ON
+    if (spool_store_body(kind, body, length)) {
+        LOG_WARN("Batch not queued - %u readings spooled to flash\n", batch_count);
+        return;
+    }
+#endif
+    LOG_ERROR("Batch not queued - %u readings dropped\n", batch_count);
 }
 
 void flush_batch() {
     if (batch_count == 0) return;
 
-    print_log("Flushing batch: %d\n", batch_count);
-
-    StaticJsonDocument<2048> doc;
-    JsonArray arr = doc.to<JsonArray>();
+    LOG_DEBUG("Flushing batch: %d (%u bytes)\n", batch_count, batch_length);
 
-    for (uint8_t i = 0; i < batch_count; i++) {
-        StaticJsonDocument<384> item;
-        deserializeJson(item, batch_buffer[i]);
-        arr.add(item);
-    }
+#ifdef BATCH_BINARY
+    BinaryBatchHeader header;
+    header.version = BINARY_BATCH_VERSION;
+    header.gateway_id = NODE_ID;
+    header.count = batch_count;
+    header.base_epoch_ms = batch_base_epoch_ms;
+    memcpy(batch_buffer, &header, sizeof(header));
 
-    String batch_json;
-    serializeJson(doc, batch_json);
+    forward_batch(UPLINK_SENSOR_DATA_BIN, batch_buffer, batch_length);
+#else
+    batch_buffer[batch_length++] = ']';
+    batch_buffer[batch_length] = '\0';
 
-    forward_to_server(batch_json.c_str());
+    forward_batch(UPLINK_SENSOR_DATA, batch_buffer, batch_length);
+#endif
 
+    batch_length = 0;
     batch_count = 0;
     batch_start_time = 0;
 }
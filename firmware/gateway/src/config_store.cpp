@@ -0,0 +1,225 @@
+#include "config_store.h"
+#include "logger.h"
+#include "node_table.h"
+#include "message_struct.h"
+#include "energy_manager.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+
+#define CONFIG_NAMESPACE        "gateway"
+
+struct gateway_config_t gateway_config = {
+    STATS_PERIOD_MS,
+    BATCH_LATENCY_BUDGET_MS,
+    BATCH_MAX_SIZE,
+    ADR_MARGIN_DB,
+    WIFI_SSID,
+    WIFI_PASSWORD,
+    SERVER_HOST,
+    SERVER_PORT
+};
+
+struct config_stats_t config_stats = {0, 0, 0};
+
+// Update received by the uplink task, applied by config_service() on the loop core
+static char pending_update[UPLINK_RESPONSE_MAX_SIZE];
+static size_t pending_length = 0;
+static portMUX_TYPE pending_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static Preferences preferences;
+
+void config_load() {
+    if (!preferences.begin(CONFIG_NAMESPACE, true)) {
+        LOG_INFO("Config: no stored settings, using defaults\n");
+        return;
+    }
+    gateway_config.stats_period_ms = preferences.getUInt("stats_ms", gateway_config.stats_period_ms);
+    gateway_config.batch_latency_budget_ms = preferences.getUInt("batch_ms", gateway_config.batch_latency_budget_ms);
+    gateway_config.batch_max_size = preferences.getUShort("batch_max", gateway_config.batch_max_size);
+    gateway_config.adr_margin_db = preferences.getFloat("adr_margin", gateway_config.adr_margin_db);
+    if (preferences.isKey("wifi_ssid")) {
+        preferences.getString("wifi_ssid", gateway_config.wifi_ssid, sizeof(gateway_config.wifi_ssid));
+        preferences.getString("wifi_pass", gateway_config.wifi_password, sizeof(gateway_config.wifi_password));
+    }
+    if (preferences.isKey("host")) {
+        preferences.getString("host", gateway_config.server_host, sizeof(gateway_config.server_host));
+    }
+    gateway_config.server_port = preferences.getUShort("port", gateway_config.server_port);
+    float currents[ENERGY_STATE_COUNT];
+    if (preferences.getBytes("currents", currents, sizeof(currents)) == sizeof(currents)) {
+        for (uint8_t s = 0; s < ENERGY_STATE_COUNT; s++) {
+            energy_set_current(static_cast<EnergyState>(s), currents[s]);
+        }
+    }
+    preferences.end();
+
+    LOG_INFO(
+      "Config: stats %u ms | batch budget %u ms, max %u | ADR margin %.1f dB | server %s:%u\n",
+      gateway_config.stats_period_ms,
+      gateway_config.batch_latency_budget_ms,
+      gateway_config.batch_max_size,
+      gateway_config.adr_margin_db,
+      gateway_config.server_host,
+      gateway_config.server_port
+    );
+}
+
+// Called from the uplink task with the stats endpoint response; only copies it
+void config_queue_update(const char* body, size_t length) {
+    if (length == 0 || length >= sizeof(pending_update)) {
+        return;
+    }
+    portENTER_CRITICAL(&pending_mux);
+    memcpy(pending_update, body, length);
+    pending_length = length;
+    portEXIT_CRITICAL(&pending_mux);
+}
+
+static bool copy_string(JsonObject config, const char* key, char* out, size_t capacity) {
+    const char* value = config[key] | static_cast<const char*>(nullptr);
+    if (value == nullptr || strlen(value) >= capacity) {
+        return false;
+    }
+    strcpy(out, value);
+    return true;
+}
+
+// Tuning values take effect at once; network settings are only stored
+static bool apply_gateway_settings(JsonObject config) {
+    struct gateway_config_t updated = gateway_config;
+    updated.stats_period_ms = config["stats_period_ms"] | updated.stats_period_ms;
+    updated.batch_latency_budget_ms = config["batch_latency_budget_ms"] | updated.batch_latency_budget_ms;
+    updated.batch_max_size = config["batch_max_size"] | updated.batch_max_size;
+    updated.adr_margin_db = config["adr_margin_db"] | updated.adr_margin_db;
+    bool network_changed = copy_string(config, "wifi_ssid", updated.wifi_ssid, sizeof(updated.wifi_ssid));
+    network_changed |= copy_string(config, "wifi_password", updated.wifi_password, sizeof(updated.wifi_password));
+    network_changed |= copy_string(config, "server_host", updated.server_host, sizeof(updated.server_host));
+    uint16_t port = config["server_port"] | updated.server_port;
+    network_changed |= port != updated.server_port;
+    updated.server_port = port;
+
+    if (updated.stats_period_ms < 5000 ||
+        updated.batch_latency_budget_ms < BATCH_MIN_TIMEOUT_MS ||
+        updated.batch_max_size < BATCH_MIN_SIZE || updated.batch_max_size > BATCH_MAX_SIZE ||
+        updated.adr_margin_db < 0.0f || updated.server_port == 0) {
+        LOG_WARN("Config: update out of range, ignored\n");
+        return false;
+    }
+
+    if (!preferences.begin(CONFIG_NAMESPACE, false)) {
+        return false;
+    }
+    preferences.putUInt("stats_ms", updated.stats_period_ms);
+    preferences.putUInt("batch_ms", updated.batch_latency_budget_ms);
+    preferences.putUShort("batch_max", updated.batch_max_size);
+    preferences.putFloat("adr_margin", updated.adr_margin_db);
+    if (network_changed) {
+        preferences.putString("wifi_ssid", updated.wifi_ssid);
+        preferences.putString("wifi_pass", updated.wifi_password);
+        preferences.putString("host", updated.server_host);
+        preferences.putUShort("port", updated.server_port);
+        LOG_INFO("Config: network settings stored, used after restart\n");
+    }
+    preferences.end();
+
+    gateway_config.stats_period_ms = updated.stats_period_ms;
+    gateway_config.batch_latency_budget_ms = updated.batch_latency_budget_ms;
+    gateway_config.batch_max_size = updated.batch_max_size;
+    gateway_config.adr_margin_db = updated.adr_margin_db;
+    return true;
+}
+
+// Energy model currents by state name, e.g. {"wifi_tx": 180}; all-or-nothing
+static bool apply_energy_currents(JsonObject currents) {
+    float updated[ENERGY_STATE_COUNT];
+    memcpy(updated, energy.current_ma, sizeof(updated));
+    for (uint8_t s = 0; s < ENERGY_STATE_COUNT; s++) {
+        updated[s] = currents[energy_state_name(static_cast<EnergyState>(s))] | updated[s];
+        if (updated[s] < 0.0f || updated[s] > 1000.0f) {
+            LOG_WARN("Config: energy current out of range, ignored\n");
+            return false;
+        }
+    }
+
+    if (!preferences.begin(CONFIG_NAMESPACE, false)) {
+        return false;
+    }
+    preferences.putBytes("currents", updated, sizeof(updated));
+    preferences.end();
+
+    for (uint8_t s = 0; s < ENERGY_STATE_COUNT; s++) {
+        energy_set_current(static_cast<EnergyState>(s), updated[s]);
+    }
+    return true;
+}
+
+static void queue_node_setting(NodeState* node, ConfigKey key, JsonObject entry, const char* name) {
+    JsonVariant value = entry[name];
+    if (value.isNull()) {
+        return;
+    }
+    uint32_t encoded = key == CONFIG_KEY_HUMIDITY_THRESHOLD
+        ? static_cast<uint32_t>(value.as<float>() * 100.0f) : value.as<uint32_t>();
+    node_table_queue_config(node, key, encoded);
+    config_stats.node_updates++;
+}
+
+// Node settings wait in the node table until the node opens its next RX window
+static void apply_node_settings(JsonArray entries) {
+    for (JsonObject entry : entries) {
+        uint8_t client_id = entry["node_id"] | 0;
+        NodeState* node = node_table_find(client_id);
+        if (node == nullptr) {
+            LOG_WARN("Config: node %u not tracked, settings ignored\n", client_id);
+            continue;
+        }
+        queue_node_setting(node, CONFIG_KEY_TX_INTERVAL_S, entry, "tx_interval_s");
+        queue_node_setting(node, CONFIG_KEY_HUMIDITY_THRESHOLD, entry, "humidity_threshold");
+        queue_node_setting(node, CONFIG_KEY_DISTANCE_THRESHOLD, entry, "distance_threshold_cm");
+        queue_node_setting(node, CONFIG_KEY_READINGS_PER_FRAME, entry, "readings_per_frame");
+    }
+}
+
+void config_service() {
+    if (pending_length == 0) {
+        return;
+    }
+
+    static char update[UPLINK_RESPONSE_MAX_SIZE];
+    portENTER_CRITICAL(&pending_mux);
+    size_t length = pending_length;
+    memcpy(update, pending_update, length);
+    pending_length = 0;
+    portEXIT_CRITICAL(&pending_mux);
+
+    JsonDocument doc;
+    if (deserializeJson(doc, update, length)) {
+        config_stats.rejected++;
+        return;
+    }
+
+    JsonObject config = doc["config"];
+    if (!config.isNull()) {
+        if (apply_gateway_settings(config)) {
+            config_stats.updates++;
+            LOG_INFO("Config: remote update applied\n");
+        } else {
+            config_stats.rejected++;
+        }
+
+        JsonObject currents = config["energy_current_ma"];
+        if (!currents.isNull()) {
+            if (apply_energy_currents(currents)) {
+                LOG_INFO("Config: energy current table updated\n");
+            } else {
+                config_stats.rejected++;
+            }
+        }
+    }
+
+    JsonArray nodes = doc["node_config"];
+    if (!nodes.isNull()) {
+        apply_node_settings(nodes);
+    }
+}
@@ -1,17 +1,161 @@
 #include "energy_manager.h"
-#include "wifi.h"
-#include "utils.h"
+#include "constants.h"
+#include <freertos/FreeRTOS.h>
 
-struct energy_t energy = {0, 0.0f, 0};
+typedef enum {
+    ENERGY_DOMAIN_CPU,
+    ENERGY_DOMAIN_LORA,
+    ENERGY_DOMAIN_WIFI,
+    ENERGY_DOMAIN_COUNT
+} EnergyDomain;
 
+static const EnergyDomain state_domain[ENERGY_STATE_COUNT] = {
+    ENERGY_DOMAIN_CPU, ENERGY_DOMAIN_CPU,
+    ENERGY_DOMAIN_LORA, ENERGY_DOMAIN_LORA, ENERGY_DOMAIN_LORA,
+    ENERGY_DOMAIN_WIFI, ENERGY_DOMAIN_WIFI, ENERGY_DOMAIN_WIFI, ENERGY_DOMAIN_WIFI, ENERGY_DOMAIN_WIFI,
+};
+
+static const char* const state_names[ENERGY_STATE_COUNT] = {
+    "cpu_active", "cpu_idle",
+    "lora_standby", "lora_rx", "lora_tx",
+    "wifi_off", "wifi_connect", "wifi_idle", "wifi_sleep", "wifi_tx",
+};
+
+struct energy_t energy = {
+    0,
+    0.0f,
+    {0},
+    {0.0f},
+    {
+        CURRENT_CPU_ACTIVE_MA, CURRENT_CPU_IDLE_MA,
+        CURRENT_LORA_STANDBY_MA, CURRENT_LORA_RX_MA, CURRENT_LORA_TX_MA,
+        CURRENT_WIFI_OFF_MA, CURRENT_WIFI_CONNECT_MA, CURRENT_WIFI_IDLE_MA, CURRENT_WIFI_SLEEP_MA,
+        CURRENT_WIFI_TX_MA,
+    }
+};
+
+// Hooks run on the loop, LoRa RX and uplink tasks, so the domain state is shared
+static EnergyState domain_state[ENERGY_DOMAIN_COUNT] = {
+    ENERGY_STATE_CPU_ACTIVE, ENERGY_STATE_LORA_STANDBY, ENERGY_STATE_WIFI_OFF
+};
+static uint32_t domain_since[ENERGY_DOMAIN_COUNT] = {0, 0, 0};
+static uint32_t last_update_time = 0;
+static uint32_t idle_mhz = 0;              // Clock while idle under frequency scaling, 0 = measured
+static portMUX_TYPE energy_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Charges the time since the domain entered its state; caller holds energy_mux
+static void close_interval(EnergyDomain domain, uint32_t now, float cpu_scale) {
+    EnergyState state = domain_state[domain];
+    uint32_t elapsed_ms = now - domain_since[domain];
+    float current_ma = energy.current_ma[state];
+    if (state == ENERGY_STATE_CPU_IDLE && idle_mhz != 0) {
+        // The clock is sampled by active code, never at the scaled-down idle frequency
+        current_ma *= idle_mhz / 240.0f;
+    } else if (domain == ENERGY_DOMAIN_CPU) {
+        current_ma *= cpu_scale;
+    }
+    float mah = current_ma * (elapsed_ms / 3600000.0f);
+
+    energy.residency_ms[state] += elapsed_ms;
+    energy.state_mah[state] += mah;
+    energy.total_mah += mah;
+    domain_since[domain] = now;
+}
+
+// CPU current is roughly proportional to the clock; the table is for 240 MHz
+static float cpu_scale() {
+    return getCpuFrequencyMhz() / 240.0f;
+}
+
+void energy_init() {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&energy_mux);
+    energy.start_time = now;
+    for (uint8_t d = 0; d < ENERGY_DOMAIN_COUNT; d++) {
+        domain_since[d] = now;
+    }
+    last_update_time = now;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+// Moves the state's domain into it; returns the state it replaced for energy_leave()
+EnergyState energy_enter(EnergyState state) {
+    float scale = cpu_scale();
+    uint32_t now = millis();
+    EnergyDomain domain = state_domain[state];
+
+    portENTER_CRITICAL(&energy_mux);
+    EnergyState previous = domain_state[domain];
+    if (previous != state) {
+        close_interval(domain, now, scale);
+        domain_state[domain] = state;
+    }
+    portEXIT_CRITICAL(&energy_mux);
+    return previous;
+}
+
+// Ends a burst state; a no-op when another task moved the domain on meanwhile
+void energy_leave(EnergyState state, EnergyState next) {
+    float scale = cpu_scale();
+    uint32_t now = millis();
+    EnergyDomain domain = state_domain[state];
+
+    portENTER_CRITICAL(&energy_mux);
+    if (domain_state[domain] == state) {
+        close_interval(domain, now, scale);
+        domain_state[domain] = next;
+    }
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+static void close_all_intervals(uint32_t now) {
+    float scale = cpu_scale();
+    portENTER_CRITICAL(&energy_mux);
+    for (uint8_t d = 0; d < ENERGY_DOMAIN_COUNT; d++) {
+        close_interval(static_cast<EnergyDomain>(d), now, scale);
+    }
+    last_update_time = now;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+// Called from loop(): closes the open intervals so totals stay current between transitions
 void update_energy_consumption() {
     uint32_t now = millis();
-    uint32_t elapsed_ms = now - energy.last_calc_time;
+    if (now - last_update_time >= ENERGY_UPDATE_INTERVAL_MS) {
+        close_all_intervals(now);
+    }
+}
+
+// Consistent copy for reporting (the 64-bit counters are not updated atomically)
+void energy_snapshot(struct energy_t& out) {
+    portENTER_CRITICAL(&energy_mux);
+    out = energy;
+    portEXIT_CRITICAL(&energy_mux);
+}
 
-    if (elapsed_ms >= 1000) {
-        float current_ma = wifi_connected ? CURRENT_ACTIVE_MA : CURRENT_IDLE_MA;
-        float hours = elapsed_ms / 3600000.0f;
-        energy.total_mah += current_ma * hours;
-        energy.last_calc_time = now;
+bool energy_set_current(EnergyState state, float current_ma) {
+    if (state >= ENERGY_STATE_COUNT || current_ma < 0.0f || current_ma > 1000.0f) {
+        return false;
     }
+    // Time already spent is charged at the old value
+    close_all_intervals(millis());
+    portENTER_CRITICAL(&energy_mux);
+    energy.current_ma[state] = current_ma;
+    portEXIT_CRITICAL(&energy_mux);
+    return true;
+}
+
+void energy_set_idle_mhz(uint32_t mhz) {
+    portENTER_CRITICAL(&energy_mux);
+    idle_mhz = mhz;
+    portEXIT_CRITICAL(&energy_mux);
+}
+
+const char* energy_state_name(EnergyState state) {
+    return state < ENERGY_STATE_COUNT ? state_names[state] : "unknown";
+}
+
+float energy_average_current_ma() {
+    uint32_t elapsed_ms = millis() - energy.start_time;
+    return elapsed_ms > 0 ? energy.total_mah * 3600000.0f / elapsed_ms : 0.0f;
 }
@@ -0,0 +1,305 @@
+#include "loadgen.h"
+
+#ifdef SIMUL_DATA
+#include "lora.h"
+#include "protocol.h"
+#include "logger.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define SIMUL_NODES_PER_TASK    ((SIMUL_NODES + SIMUL_TASKS - 1) / SIMUL_TASKS)
+
+struct VirtualNode {
+    uint8_t  client_id;
+    uint16_t sequence;
+    bool     started;           // First frame carries SENSOR_FLAG_SEQUENCE_RESTART
+    uint32_t next_tx_ms;
+    uint8_t  battery;
+    bool     legacy;            // Original firmware: V1 readings, XOR trailer instead of CRC-16
+};
+
+struct Generator {
+    uint16_t node_count;
+    VirtualNode nodes[SIMUL_NODES_PER_TASK];
+    struct loadgen_stats_t stats;   // Written by this generator's task only
+};
+
+static Generator generators[SIMUL_TASKS];
+static uint32_t loadgen_started_ms = 0;
+
+// Each node transmits periodically; together they offer SIMUL_RATE_FPS
+static const uint32_t node_period_ms = static_cast<uint32_t>(SIMUL_NODES * 1000.0f / SIMUL_RATE_FPS);
+
+static uint32_t random_below(uint32_t bound) {
+    return esp_random() % bound;
+}
+
+static bool percent_chance(uint32_t percent) {
+    return random_below(100) < percent;
+}
+
+static uint32_t jittered_period_ms() {
+    uint32_t jitter = node_period_ms * SIMUL_JITTER_PERCENT / 100;
+    return node_period_ms - jitter + random_below(2 * jitter + 1);
+}
+
+// Readings inside the rules.cpp thresholds, about 1 in 100 outside
+static void sample(int16_t* temperature, uint16_t* humidity, uint16_t* distance_cm, uint16_t* luminosity_lux) {
+    bool outlier = percent_chance(1);
+    *temperature = static_cast<int16_t>(outlier ? 4100 + random_below(500) : 1500 + random_below(2000));
+    *humidity = static_cast<uint16_t>(outlier ? 8100 + random_below(1800) : 3000 + random_below(4500));
+    *distance_cm = static_cast<uint16_t>(outlier ? 5 + random_below(90) : 150 + random_below(250));
+    *luminosity_lux = static_cast<uint16_t>(random_below(2000));
+}
+
+static uint8_t next_flags(VirtualNode& node) {
+    uint8_t flags = node.started ? 0 : SENSOR_FLAG_SEQUENCE_RESTART;
+    node.started = true;
+    if (percent_chance(10)) {
+        flags |= SENSOR_FLAG_CONFIRMED;
+    }
+    return flags;
+}
+
+static size_t build_sensor_data(VirtualNode& node, uint8_t* frame) {
+    SensorDataMessage msg;
+    msg.msg_type = MSG_TYPE_SENSOR_DATA;
+    msg.client_id = node.client_id;
+    msg.timestamp = millis();
+    int16_t temperature;
+    uint16_t humidity, distance_cm, luminosity_lux;
+    sample(&temperature, &humidity, &distance_cm, &luminosity_lux);
+    msg.temperature = temperature;
+    msg.humidity = humidity;
+    msg.distance_cm = distance_cm;
+    msg.luminosity_lux = luminosity_lux;
+    msg.battery = node.battery;
+    msg.sequence = node.sequence++;
+    msg.flags = next_flags(node);
+    msg.awake_ms = static_cast<uint16_t>(100 + random_below(300));
+    memcpy(frame, &msg, sizeof(msg));
+    return sizeof(msg);
+}
+
+// Original firmware: 17-byte layout without sequence, flags or awake time
+static size_t build_sensor_data_v1(VirtualNode& node, uint8_t* frame) {
+    SensorDataMessageV1 msg;
+    msg.msg_type = MSG_TYPE_SENSOR_DATA;
+    msg.client_id = node.client_id;
+    msg.timestamp = millis();
+    int16_t temperature;
+    uint16_t humidity, distance_cm, luminosity_lux;
+    sample(&temperature, &humidity, &distance_cm, &luminosity_lux);
+    msg.temperature = temperature;
+    msg.humidity = humidity;
+    msg.distance_cm = distance_cm;
+    msg.luminosity_lux = luminosity_lux;
+    msg.battery = node.battery;
+    msg.reserved = 0;
+    memcpy(frame, &msg, sizeof(msg));
+    return sizeof(msg);
+}
+
+static size_t build_sensor_batch(VirtualNode& node, uint8_t* frame) {
+    uint8_t count = static_cast<uint8_t>(1 + random_below(SENSOR_BATCH_MAX_READINGS));
+    SensorBatchHeader header;
+    header.msg_type = MSG_TYPE_SENSOR_BATCH;
+    header.client_id = node.client_id;
+    header.timestamp = millis();
+    header.sequence = node.sequence;
+    header.flags = next_flags(node);
+    header.count = count;
+    header.interval_s = static_cast<uint16_t>(node_period_ms / 1000 / count + 1);
+    int16_t temperature;
+    uint16_t humidity, distance_cm, luminosity_lux;
+    sample(&temperature, &humidity, &distance_cm, &luminosity_lux);
+    header.temperature = temperature;
+    header.humidity = humidity;
+    header.distance_cm = distance_cm;
+    header.luminosity_lux = luminosity_lux;
+    header.battery = node.battery;
+    header.awake_ms = static_cast<uint16_t>(100 + random_below(300));
+    node.sequence += count;
+
+    memcpy(frame, &header, sizeof(header));
+    size_t offset = sizeof(header);
+    for (uint8_t i = 1; i < count; i++) {
+        SensorBatchRecord record;
+        record.temperature_delta = static_cast<int8_t>(random_below(21)) - 10;
+        record.humidity_delta = static_cast<int8_t>(random_below(21)) - 10;
+        record.distance_delta = static_cast<int16_t>(random_below(41)) - 20;
+        record.luminosity_delta = static_cast<int16_t>(random_below(201)) - 100;
+        memcpy(frame + offset, &record, sizeof(record));
+        offset += sizeof(record);
+    }
+    return SENSOR_BATCH_FRAME_SIZE(count);
+}
+
+static size_t build_sensor_aggregate(VirtualNode& node, uint8_t* frame) {
+    SensorAggregateMessage msg;
+    msg.msg_type = MSG_TYPE_SENSOR_AGGREGATE;
+    msg.client_id = node.client_id;
+    msg.timestamp = millis();
+    msg.sequence = node.sequence++;
+    msg.flags = next_flags(node);
+    msg.count = static_cast<uint8_t>(2 + random_below(30));
+    msg.interval_s = static_cast<uint16_t>(node_period_ms / 1000 / msg.count + 1);
+    int16_t temperature;
+    uint16_t humidity, distance_cm, luminosity_lux;
+    sample(&temperature, &humidity, &distance_cm, &luminosity_lux);
+    msg.temperature_mean = temperature;
+    msg.temperature_min = temperature - 100;
+    msg.temperature_max = temperature + 100;
+    msg.humidity_mean = humidity;
+    msg.humidity_min = humidity - 200;
+    msg.humidity_max = humidity + 200;
+    msg.distance_mean = distance_cm;
+    msg.distance_min = distance_cm / 2;
+    msg.distance_max = distance_cm + distance_cm / 2;
+    msg.luminosity_mean = luminosity_lux;
+    msg.luminosity_min = luminosity_lux / 2;
+    msg.luminosity_max = luminosity_lux + 100;
+    msg.battery = node.battery;
+    msg.awake_ms = static_cast<uint16_t>(100 + random_below(300));
+    memcpy(frame, &msg, sizeof(msg));
+    return sizeof(msg);
+}
+
+static size_t build_heartbeat(VirtualNode& node, uint8_t* frame) {
+    HeartbeatMessage msg;
+    msg.msg_type = MSG_TYPE_HEARTBEAT;
+    msg.client_id = node.client_id;
+    msg.timestamp = millis();
+    msg.status = node.battery < ALERT_BATTERY_LOW_PERCENT ? STATUS_LOW_BATTERY : STATUS_OK;
+    memcpy(frame, &msg, sizeof(msg));
+    return sizeof(msg);
+}
+
+static size_t build_alert(VirtualNode& node, uint8_t* frame) {
+    AlertMessage msg;
+    msg.msg_type = MSG_TYPE_ALERT;
+    msg.client_id = node.client_id;
+    msg.timestamp = millis();
+    msg.alert_code = ALERT_DISTANCE_LOW;
+    msg.alert_value = static_cast<int16_t>(5 + random_below(90));
+    msg.severity = static_cast<uint8_t>(1 + random_below(3));
+    msg.reserved = 0;
+    memcpy(frame, &msg, sizeof(msg));
+    return sizeof(msg);
+}
+
+// Builders lay frames out as their structs; transmit() adds the trailer.
+// Mix of a deployed network: mostly readings, some multi-reading frames, few alerts.
+// Legacy nodes only send what the original firmware knows: V1 readings, heartbeats, alerts.
+static size_t build_frame(VirtualNode& node, uint8_t* frame) {
+    uint32_t roll = random_below(100);
+    if (node.legacy && roll < 86) return build_sensor_data_v1(node, frame);
+    if (roll < 70) return build_sensor_data(node, frame);
+    if (roll < 78) return build_sensor_batch(node, frame);
+    if (roll < 86) return build_sensor_aggregate(node, frame);
+    if (roll < 96) return build_heartbeat(node, frame);
+    return build_alert(node, frame);
+}
+
+static void inject(Generator* generator, const uint8_t* frame, size_t length, float rssi, float snr) {
+    generator->stats.generated++;
+    if (!LoRaRadio::get_instance().push_frame(frame, length, rssi, snr)) {
+        generator->stats.ring_full++;
+    }
+}
+
+static void transmit(Generator* generator, VirtualNode& node) {
+    uint8_t frame[LORA_MAX_PACKET_SIZE];
+    if (!node.legacy && percent_chance(SIMUL_REBOOT_PERCENT)) {
+        // Power cycle: the sequence starts over at 0, but that frame (with the restart flag)
+        // never arrives, so the next ones reuse sequences the gateway still has in its window
+        node.sequence = 0;
+        node.started = false;
+        build_sensor_data(node, frame);
+        generator->stats.reboots++;
+    }
+    size_t length = protocol_seal(frame, build_frame(node, frame), node.legacy ? FRAME_TRAILER_XOR : FRAME_TRAILER_CRC16);
+    float rssi = -120.0f + random_below(800) / 10.0f;
+    float snr = -15.0f + random_below(250) / 10.0f;
+
+    if (percent_chance(SIMUL_CORRUPT_PERCENT)) {
+        uint8_t corrupted[LORA_MAX_PACKET_SIZE];
+        memcpy(corrupted, frame, length);
+        corrupted[1 + random_below(length - 1)] ^= static_cast<uint8_t>(1 + random_below(255));
+        generator->stats.corrupted++;
+        inject(generator, corrupted, length, rssi, snr);
+    } else {
+        inject(generator, frame, length, rssi, snr);
+    }
+    if (percent_chance(SIMUL_DUPLICATE_PERCENT)) {
+        generator->stats.duplicates++;
+        inject(generator, frame, length, rssi, snr);
+    }
+}
+
+static void generator_task(void* arg) {
+    Generator* generator = static_cast<Generator*>(arg);
+    for (;;) {
+        uint32_t now = millis();
+        int32_t wait = static_cast<int32_t>(node_period_ms);
+        for (uint16_t i = 0; i < generator->node_count; i++) {
+            VirtualNode& node = generator->nodes[i];
+            int32_t due = static_cast<int32_t>(node.next_tx_ms - now);
+            if (due <= 0) {
+                transmit(generator, node);
+                node.next_tx_ms += jittered_period_ms();
+                due = static_cast<int32_t>(node.next_tx_ms - now);
+            }
+            if (due < wait) {
+                wait = due;
+            }
+        }
+        // At least one tick, so a generator that falls behind still lets its core idle
+        vTaskDelay(pdMS_TO_TICKS(wait > 1 ? wait : 1));
+    }
+}
+
+void init_loadgen() {
+    loadgen_started_ms = millis();
+    for (uint16_t n = 0; n < SIMUL_NODES; n++) {
+        Generator& generator = generators[n % SIMUL_TASKS];
+        VirtualNode& node = generator.nodes[generator.node_count++];
+        node.client_id = static_cast<uint8_t>(n + 1);
+        node.sequence = static_cast<uint16_t>(esp_random());
+        node.started = false;
+        node.next_tx_ms = loadgen_started_ms + random_below(node_period_ms);  // Spread the first frames
+        node.battery = static_cast<uint8_t>(10 + random_below(91));
+        node.legacy = percent_chance(SIMUL_LEGACY_PERCENT);
+    }
+    for (uint8_t core = 0; core < SIMUL_TASKS; core++) {
+        xTaskCreatePinnedToCore(
+            generator_task,
+            "loadgen",
+            SIMUL_TASK_STACK_SIZE,
+            &generators[core],
+            SIMUL_TASK_PRIORITY,
+            nullptr,
+            core
+        );
+    }
+    LOG_INFO("Load generator: %u nodes, %.1f frames/s, period %u ms per node\n",
+              SIMUL_NODES, SIMUL_RATE_FPS, node_period_ms);
+}
+
+struct loadgen_stats_t loadgen_totals() {
+    struct loadgen_stats_t total = {0, 0, 0, 0, 0};
+    for (uint8_t i = 0; i < SIMUL_TASKS; i++) {
+        total.generated += generators[i].stats.generated;
+        total.duplicates += generators[i].stats.duplicates;
+        total.corrupted += generators[i].stats.corrupted;
+        total.reboots += generators[i].stats.reboots;
+        total.ring_full += generators[i].stats.ring_full;
+    }
+    return total;
+}
+
+float loadgen_offered_fps() {
+    uint32_t elapsed_ms = millis() - loadgen_started_ms;
+    return elapsed_ms > 0 ? loadgen_totals().generated * 1000.0f / elapsed_ms : 0.0f;
+}
+#endif
@@ -0,0 +1,187 @@
+#include "logger.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+struct log_stats_t log_stats = {0, 0};
+
+#ifdef LOG_DEFERRED_ON
+static QueueHandle_t log_queue = nullptr;
+static TaskHandle_t log_task_handle = nullptr;
+static portMUX_TYPE log_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t reported_drops = 0;
+
+void log_pack_string(struct log_entry_t& entry, const char* value) {
+    if (value == nullptr) {
+        value = "(null)";
+    }
+    size_t room = sizeof(entry.text) - entry.text_length;
+    if (room == 0) {
+        // Text is full and its last byte is a terminator: later strings print as empty
+        entry.args[entry.argc++].integer = sizeof(entry.text) - 1;
+        return;
+    }
+    size_t length = strlen(value);
+    if (length >= room) {
+        length = room - 1;                  // Truncated; the terminator still fits
+    }
+    memcpy(entry.text + entry.text_length, value, length);
+    entry.args[entry.argc++].integer = entry.text_length;
+    entry.text_length += length;
+    entry.text[entry.text_length++] = '\0';
+}
+
+// Length modifier of a conversion spec: "hh", "h", "l", "ll", "z"...
+static bool is_length_modifier(char c) {
+    return c == 'h' || c == 'l' || c == 'z' || c == 'j' || c == 't' || c == 'L';
+}
+
+// Re-runs printf one conversion at a time, casting each stored argument to the type the
+// spec expects, so the variadic call sees the same types the original call passed
+static size_t format_entry(const struct log_entry_t& entry, char* out, size_t size) {
+    size_t used = 0;
+    uint8_t arg = 0;
+    const char* p = entry.format;
+
+    while (*p != '\0' && used + 1 < size) {
+        if (*p != '%') {
+            out[used++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[used++] = '%';
+            p += 2;
+            continue;
+        }
+
+        char spec[16];
+        size_t spec_length = 0;
+        spec[spec_length++] = *p++;
+        while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr && spec_length < sizeof(spec) - 4) {
+            spec[spec_length++] = *p++;
+        }
+        uint8_t longs = 0;
+        while (is_length_modifier(*p) && spec_length < sizeof(spec) - 2) {
+            longs += (*p == 'l') ? 1 : 0;
+            spec[spec_length++] = *p++;
+        }
+        char conversion = *p;
+        if (conversion == '\0') {
+            break;
+        }
+        spec[spec_length++] = *p++;
+        spec[spec_length] = '\0';
+
+        if (arg >= entry.argc) {
+            continue;   // More specs than arguments: print nothing rather than garbage
+        }
+        const union log_arg_t& value = entry.args[arg++];
+        char* dest = out + used;
+        size_t room = size - used;
+        int written = 0;
+        switch (conversion) {
+        case 'd':
+        case 'i':
+            written = longs >= 2 ? snprintf(dest, room, spec, static_cast<long long>(value.integer))
+                    : longs == 1 ? snprintf(dest, room, spec, static_cast<long>(value.integer))
+                    : snprintf(dest, room, spec, static_cast<int>(value.integer));
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            written = longs >= 2 ? snprintf(dest, room, spec, static_cast<unsigned long long>(value.integer))
+                    : longs == 1 ? snprintf(dest, room, spec, static_cast<unsigned long>(value.integer))
+                    : snprintf(dest, room, spec, static_cast<unsigned int>(value.integer));
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+            written = snprintf(dest, room, spec, value.real);
+            break;
+        case 's':
+            written = snprintf(dest, room, spec, entry.text + value.integer);
+            break;
+        case 'p':
+            written = snprintf(dest, room, spec, value.pointer);
+            break;
+        default:
+            break;
+        }
+        if (written > 0) {
+            used += static_cast<size_t>(written) < room ? static_cast<size_t>(written) : room - 1;
+        }
+    }
+    out[used] = '\0';
+    return used;
+}
+
+static void print_entry(const struct log_entry_t& entry) {
+    char line[LOG_LINE_MAX_SIZE];
+    format_entry(entry, line, sizeof(line));
+    fputs(line, stdout);
+}
+
+void log_submit(struct log_entry_t& entry) {
+    if (log_queue == nullptr) {
+        print_entry(entry);
+        return;
+    }
+    // Never waits: a full ring costs the message, not the caller's time
+    bool queued = xQueueSend(log_queue, &entry, 0) == pdTRUE;
+    portENTER_CRITICAL(&log_mux);
+    if (queued) {
+        log_stats.queued++;
+    } else {
+        log_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&log_mux);
+}
+
+static void log_task(void* arg) {
+    struct log_entry_t entry;
+    for (;;) {
+        if (xQueueReceive(log_queue, &entry, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        print_entry(entry);
+
+        if (log_stats.dropped != reported_drops && uxQueueMessagesWaiting(log_queue) == 0) {
+            uint32_t dropped = log_stats.dropped;
+            printf("[log] %u messages dropped (ring full)\n", dropped - reported_drops);
+            reported_drops = dropped;
+        }
+    }
+}
+
+void init_logger() {
+    if (log_task_handle != nullptr) {
+        return;
+    }
+    log_queue = xQueueCreate(LOG_RING_SIZE, sizeof(struct log_entry_t));
+    xTaskCreatePinnedToCore(
+        log_task,
+        "log",
+        LOG_TASK_STACK_SIZE,
+        nullptr,
+        LOG_TASK_PRIORITY,
+        &log_task_handle,
+        LOG_TASK_CORE
+    );
+}
+#else
+void log_write(uint8_t level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+void init_logger() {}
+#endif
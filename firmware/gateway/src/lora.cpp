@@ -1,11 +1,15 @@
 #include "lora.h"
-#include "utils.h"
+#include "logger.h"
 #include "batch.h"
 #include "processing.h"
 #include "wifi.h"
+#include "energy_manager.h"
+#include "power.h"
+#include "trace.h"
 #include <SPI.h>
 
 LoRaRadio* LoRaRadio::loRaRadio = nullptr;
+TaskHandle_t LoRaRadio::rx_task_handle = nullptr;
 
 LoRaRadio& LoRaRadio::get_instance() {
     if (loRaRadio == nullptr) {
@@ -19,13 +23,18 @@ LoRaRadio::LoRaRadio() :
       LORA_PIN_CS, LORA_PIN_IRQ, LORA_PIN_RST, LORA_PIN_GPIO_INT
     )),
     stats(),
+    last_rx_time_ms(0),
+    reported_crc_errors(0),
     packet_rx_buffer{0},
-    last_rx_time_ms(0) {
+    rx_ring_head(0),
+    rx_ring_tail(0),
+    rx_ring_mux(portMUX_INITIALIZER_UNLOCKED),
+    downlink_queue(nullptr) {
       last_rx_time_ms = millis();
     }
 
 void LoRaRadio::setup() {
-  print_log("Setting up LoRa radio...\n");
+  LOG_INFO("Setting up LoRa radio...\n");
   
   // Hardware reset do módulo LoRa
   pinMode(LORA_PIN_RST, OUTPUT);
@@ -48,7 +57,7 @@ void LoRaRadio::setup() {
       LORA_TX_POWER,
       LORA_PREAMBLE_LENGTH
   );
-  print_log(
+  LOG_INFO(
     "Lora setup - %.1f MHz | SF=%d | BW=%.0f kHz\n",
     LORA_FREQUENCY_MHZ,
     LORA_SPREADING_FACTOR,
@@ -58,23 +67,58 @@ void LoRaRadio::setup() {
   if (status_code == RADIOLIB_ERR_NONE) {
       lora_handler.setCurrentLimit(140);
       lora_handler.setCRC(true);  // Habilita verificação de CRC
-      print_log("Lora setup completed\n");
+      LOG_INFO("Lora setup completed\n");
+
+      // Task de RX dedicada, acordada pela interrupção DIO1 (RX_DONE) ou por um downlink na fila
+      downlink_queue = xQueueCreate(LORA_DOWNLINK_QUEUE_DEPTH, sizeof(Downlink));
+      xTaskCreatePinnedToCore(
+          rx_task,
+          "lora_rx",
+          LORA_RX_TASK_STACK_SIZE,
+          this,
+          LORA_RX_TASK_PRIORITY,
+          &rx_task_handle,
+          LORA_RX_TASK_CORE
+      );
+      lora_handler.setDio1Action(on_dio1);
       lora_handler.startReceive();
+      energy_enter(ENERGY_STATE_LORA_RX);
   } else {
     while (true) {
-        print_log("Lora error %d\n", status_code);
+        LOG_ERROR("Lora error %d\n", status_code);
         delay(1000);
       }
   }
 }
 
-void LoRaRadio::check_packets() {
+void IRAM_ATTR LoRaRadio::on_dio1() {
+    BaseType_t higher_priority_woken = pdFALSE;
+    TRACE_IRQ();
+    if (rx_task_handle != nullptr) {
+        vTaskNotifyGiveFromISR(rx_task_handle, &higher_priority_woken);
+    }
+    portYIELD_FROM_ISR(higher_priority_woken);
+}
+
+void LoRaRadio::rx_task(void* arg) {
+    LoRaRadio* radio = static_cast<LoRaRadio*>(arg);
+    for (;;) {
+        // Bloqueia até a DIO1 sinalizar; o timeout cobre uma borda perdida
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LORA_RX_POLL_TIMEOUT_MS));
+        radio->service_radio();
+        radio->send_downlinks();
+    }
+}
+
+// Executa apenas na task de RX: é o único ponto que acessa o SX1262 após o setup
+void LoRaRadio::service_radio() {
     // Verifica se há um novo pacote usando o status de interrupção
     // Isso evita ler pacotes duplicados ou dados inválidos
     int irq = lora_handler.getIrqStatus();
     if (!(irq & RADIOLIB_SX126X_IRQ_RX_DONE)) {
         return;
     }
+    TRACE_IRQ_SERVICED();
 
     size_t packet_size = lora_handler.getPacketLength();
     
@@ -84,7 +128,9 @@ void LoRaRadio::check_packets() {
         return;
     }
 
+    TRACE_BEGIN(read_start);
     int state = lora_handler.readData(packet_rx_buffer, packet_size);
+    TRACE_END(TRACE_READ_DATA, read_start);
     float rssi = lora_handler.getRSSI();
     float snr = lora_handler.getSNR();
 
@@ -92,9 +138,11 @@ void LoRaRadio::check_packets() {
     lora_handler.startReceive();
 
     // Verifica erros de CRC
+    // Contado aqui, logado pelo loop(): total_rx_invalids pertence ao core de processamento
     if (state == RADIOLIB_ERR_CRC_MISMATCH) {
-        print_log("Lora packet RX CRC error - packet discarded\n");
-        stats.total_rx_invalids++;
+        portENTER_CRITICAL(&rx_ring_mux);
+        stats.total_rx_crc_errors++;
+        portEXIT_CRITICAL(&rx_ring_mux);
         return;
     }
 
@@ -108,16 +156,116 @@ void LoRaRadio::check_packets() {
         return;
     }
 
+    push_frame(packet_rx_buffer, packet_size, rssi, snr);
+}
+
+// Chamado da task de RX e, com SIMUL_DATA, dos geradores nos dois cores: os contadores
+// de RX são atualizados dentro da seção crítica
+bool LoRaRadio::push_frame(const uint8_t* data, size_t length, float rssi, float snr) {
+    if (length == 0 || length > LORA_MAX_PACKET_SIZE) {
+        return false;
+    }
+
+    // Relógios lidos fora da seção crítica; o epoch é 0 até o NTP sincronizar
+    struct sample_time_t received;
+    received.uptime_ms = millis();
+    received.epoch_ms = get_epoch_ms();
+    bool pushed = false;
+    portENTER_CRITICAL(&rx_ring_mux);
     stats.total_rx_packets++;
-    last_rx_time_ms = millis();
+    last_rx_time_ms = received.uptime_ms;
+    uint16_t next_head = (rx_ring_head + 1) % LORA_RX_RING_SIZE;
+    if (next_head != rx_ring_tail) {
+        RxFrame& frame = rx_ring[rx_ring_head];
+        memcpy(frame.data, data, length);
+        frame.length = length;
+        frame.rssi = rssi;
+        frame.snr = snr;
+        frame.received = received;
+        rx_ring_head = next_head;
+        pushed = true;
+    } else {
+        stats.total_rx_dropped++;
+    }
+    portEXIT_CRITICAL(&rx_ring_mux);
+
+    if (pushed) {
+        power_wake();
+    }
+    return pushed;
+}
+
+// Chamado do loop(): o SX1262 pertence à task de RX, que faz a transmissão
+bool LoRaRadio::queue_downlink(const uint8_t* data, size_t length) {
+    if (downlink_queue == nullptr || length == 0 || length > LORA_DOWNLINK_MAX_SIZE) {
+        return false;
+    }
 
-    print_log(
-      "Received packet - #%u: %d bytes | RSSI=%.0f dBm | SNR=%.1f dB\n",
-      stats.total_rx_packets,
-      packet_size,
-      rssi,
-      snr
-    );
+    Downlink downlink;
+    memcpy(downlink.data, data, length);
+    downlink.length = length;
+    if (xQueueSend(downlink_queue, &downlink, 0) != pdTRUE) {
+        portENTER_CRITICAL(&rx_ring_mux);
+        stats.total_tx_downlink_errors++;
+        portEXIT_CRITICAL(&rx_ring_mux);
+        return false;
+    }
+    xTaskNotifyGive(rx_task_handle);
+    return true;
+}
 
-    process_rx_lora_message(packet_rx_buffer, packet_size, rssi, snr);
+// Executa na task de RX; o nó só escuta por LORA_RX_WINDOW_MS após o uplink, então envia logo
+void LoRaRadio::send_downlinks() {
+    Downlink downlink;
+    bool transmitted = false;
+    while (downlink_queue != nullptr && xQueueReceive(downlink_queue, &downlink, 0) == pdTRUE) {
+        energy_enter(ENERGY_STATE_LORA_TX);
+        int state = lora_handler.transmit(downlink.data, downlink.length);
+        portENTER_CRITICAL(&rx_ring_mux);
+        if (state == RADIOLIB_ERR_NONE) {
+            stats.total_tx_downlinks++;
+        } else {
+            stats.total_tx_downlink_errors++;
+        }
+        portEXIT_CRITICAL(&rx_ring_mux);
+        transmitted = true;
+    }
+    if (transmitted) {
+        lora_handler.startReceive();
+        energy_enter(ENERGY_STATE_LORA_RX);
+    }
+}
+
+uint16_t LoRaRadio::get_pending_frames() const {
+    uint16_t head = rx_ring_head;
+    uint16_t tail = rx_ring_tail;
+    return (head + LORA_RX_RING_SIZE - tail) % LORA_RX_RING_SIZE;
+}
+
+// Consome o ring no core do loop(); o frame é processado no próprio slot
+void LoRaRadio::check_packets() {
+    uint32_t crc_errors = stats.total_rx_crc_errors;
+    if (crc_errors != reported_crc_errors) {
+        LOG_WARN("Lora packet RX CRC error - %u packet(s) discarded\n", crc_errors - reported_crc_errors);
+        stats.total_rx_invalids += crc_errors - reported_crc_errors;
+        reported_crc_errors = crc_errors;
+    }
+
+    while (rx_ring_tail != rx_ring_head) {
+        RxFrame& frame = rx_ring[rx_ring_tail];
+
+        LOG_DEBUG(
+          "Received packet - #%u: %d bytes | RSSI=%.0f dBm | SNR=%.1f dB\n",
+          stats.total_rx_packets,
+          frame.length,
+          frame.rssi,
+          frame.snr
+        );
+
+        process_rx_lora_message(frame.data, frame.length, frame.rssi, frame.snr, frame.received);
+
+        portENTER_CRITICAL(&rx_ring_mux);
+        rx_ring_tail = (rx_ring_tail + 1) % LORA_RX_RING_SIZE;
+        portEXIT_CRITICAL(&rx_ring_mux);
+    }
 }
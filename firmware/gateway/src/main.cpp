@@ -8,133 +8,177 @@
 #include "lora.h"
 #include "wifi.h"
 #include "batch.h"
+#include "node_table.h"
 #include "processing.h"
 #include "energy_manager.h"
-#include "utils.h"
+#include "logger.h"
+#include "uplink.h"
+#include "spool.h"
+#include "config_store.h"
+#include "power.h"
+#include "alerts.h"
+#include "loadgen.h"
 
 
 static uint32_t last_stats_time = 0;
 
-#ifdef SIMUL_DATA
-static uint32_t last_simul_time = 0;
-static void generate_fake_packet();
-#endif
-
 static void print_statistics();
+#ifdef POWER_SAVE_ON
+static uint32_t next_wake_ms();
+#endif
 
 void setup() {
     Serial.begin(SERIAL_BAUD_RATE);
     delay(500);  // Aguarda estabilização do Serial
-    
-    print_log("\n========================================\n");
-    print_log("Gateway Node %d - Setting up...\n", NODE_ID);
-    print_log("========================================\n");
+    init_logger();
+
+    LOG_INFO("\n========================================\n");
+    LOG_INFO("Gateway Node %d - Setting up...\n", NODE_ID);
+    LOG_INFO("========================================\n");
+
+    config_load();
 
-    energy.start_time = millis();
-    energy.last_calc_time = millis();
+    energy_init();
 
     LoRaRadio::get_instance().setup();
 
+#ifdef SPOOL_ON
+    init_spool();
+#endif
+
     init_wifi();
+    init_uplink();
+    init_power();
+
+#ifdef SIMUL_DATA
+    init_loadgen();
+#endif
 
-    print_log("Initialized\n");
+    LOG_INFO("Initialized\n");
     last_stats_time = millis();
 }
 
 void loop() {
-#ifdef SIMUL_DATA
-    if (millis() - last_simul_time >= SIMUL_PERIOD_MS) {
-        generate_fake_packet();
-        last_simul_time = millis();
-    }
-#else
     LoRaRadio::get_instance().check_packets();
+
+#ifdef ALERTS_ON
+    alert_service();
 #endif
 
     update_energy_consumption();
 
 #ifdef BATCH_ON
-    if (batch_count > 0 && (millis() - batch_start_time >= BATCH_TIMEOUT_MS)) {
-        print_log("Flushing batch, timeout reached...");
+    if (batch_due()) {
+        LOG_DEBUG("Flushing batch, timeout reached...");
         flush_batch();
     }
 #endif
 
-    if (millis() - last_stats_time >= STATS_PERIOD_MS) {
+    // Data requests the server did not confirm go back to flash before replay picks any up
+#ifdef SPOOL_ON
+    uplink_reclaim(spool_store_undelivered);
+    spool_drain();
+#else
+    uplink_reclaim(nullptr);    // Nowhere to keep them: counted in uplink_stats.undelivered
+#endif
+
+    config_service();
+
+    if (millis() - last_stats_time >= gateway_config.stats_period_ms) {
         print_statistics();
         send_gateway_statistics();
         last_stats_time = millis();
     }
 
     check_wifi_connection();
+
+#ifdef POWER_SAVE_ON
+    power_idle(next_wake_ms());
+#endif
+}
+
+#ifdef POWER_SAVE_ON
+static uint32_t remaining_ms(uint32_t since, uint32_t period, uint32_t now) {
+    uint32_t elapsed = now - since;
+    return elapsed >= period ? 0 : period - elapsed;
+}
+
+// Time loop() may sleep: frames, WiFi events and finished uplinks wake it earlier
+static uint32_t next_wake_ms() {
+    if (LoRaRadio::get_instance().get_pending_frames() > 0) {
+        return 0;
+    }
+    uint32_t now = millis();
+    uint32_t wait = POWER_IDLE_MAX_MS;
+
+    uint32_t stats_wait = remaining_ms(last_stats_time, gateway_config.stats_period_ms, now);
+    if (stats_wait < wait) wait = stats_wait;
+#ifdef BATCH_ON
+    if (batch_count > 0) {
+        uint32_t batch_wait = remaining_ms(batch_start_time, batch_policy.timeout_ms, now);
+        if (batch_wait < wait) wait = batch_wait;
+    }
+#endif
+    return wait;
 }
+#endif
 
 static void print_statistics() {
+#if LOG_LEVEL >= LOG_LEVEL_INFO
     LoRaRadio::Stats lora_stats = LoRaRadio::get_instance().get_stats();
     
+    struct server_stats_t server_totals;
+    struct latency_t rtt;
+    server_stats_snapshot(server_totals, rtt);
+    
     uint32_t uptime_s = (millis() - energy.start_time) / 1000;
-    float avg_latency = latency.samples > 0
-        ? (static_cast<float>(latency.total_ms) / latency.samples) : 0.0f;
-    float packet_loss = lora_stats.total_rx_packets > 0
-        ? (static_cast<float>(lora_stats.total_rx_invalids) / lora_stats.total_rx_packets * 100.0f) : 0.0f;
-    float server_success = server_stats.total > 0
-        ? (static_cast<float>(server_stats.success) / server_stats.total * 100.0f) : 0.0f;
-
-    print_log("\n\nStatistics of gateway:\n");
-    print_log("Uptime: %02u:%02u:%02u\n", uptime_s / 3600, (uptime_s % 3600) / 60, uptime_s % 60);
-    print_log("LoRa RX - Valid: %u | Invalid: %u | Duplicates: %u | Loss: %.1f%%\n",
+    float avg_latency = rtt.samples > 0
+        ? (static_cast<float>(rtt.total_ms) / rtt.samples) : 0.0f;
+    float packet_loss = node_loss_percent(node_table_stats.accepted, node_table_stats.lost);
+    float server_success = server_totals.total > 0
+        ? (static_cast<float>(server_totals.success) / server_totals.total * 100.0f) : 0.0f;
+
+    LOG_INFO("\n\nStatistics of gateway:\n");
+    LOG_INFO("Uptime: %02u:%02u:%02u\n", uptime_s / 3600, (uptime_s % 3600) / 60, uptime_s % 60);
+    LOG_INFO("LoRa RX - Valid: %u | Invalid: %u | Duplicates: %u | Loss: %.1f%%\n",
           lora_stats.total_rx_valids, lora_stats.total_rx_invalids, get_duplicate_count(), packet_loss);
-    print_log("Server TX - Success: %u/%u | Rate: %.1f%%\n",
-          server_stats.success, server_stats.total, server_success);
-    if (latency.samples > 0) {
-        print_log("Latency - Avg: %.0f ms | Range: %u-%u ms\n", avg_latency,
-              latency.min_ms == UINT32_MAX ? 0 : latency.min_ms, latency.max_ms);
+    LOG_INFO("Nodes - Tracked: %u/%u | Evictions: %u | Lost: %u | Reordered: %u\n",
+          node_table_stats.tracked, NODE_TABLE_CAPACITY, node_table_stats.evictions,
+          node_table_stats.lost, node_table_stats.reordered);
+    LOG_INFO("Server TX - Success: %u/%u | Rate: %.1f%%\n",
+          server_totals.success, server_totals.total, server_success);
+    if (rtt.samples > 0) {
+        LOG_INFO("Latency - Avg: %.0f ms | Range: %u-%u ms\n", avg_latency,
+              rtt.min_ms == UINT32_MAX ? 0 : rtt.min_ms, rtt.max_ms);
     }
-    print_log("Energy consumption: %.2f mAh\n", energy.total_mah);
+#ifdef ALERTS_ON
+    LOG_INFO("Alerts - Raised: %u (from nodes: %u) | Delivered: %u | Pending: %u | Latency: %u ms (max %u)\n",
+          alert_stats.raised, alert_stats.from_nodes, alert_stats.delivered, alert_pending(),
+          alert_stats.last_latency_ms, alert_stats.max_latency_ms);
+#endif
+#ifdef SIMUL_DATA
+    struct loadgen_stats_t load = loadgen_totals();
+    LOG_INFO("Load generator - Offered: %.1f/%.1f frames/s | Sent: %u | Dups: %u | Corrupt: %u | Reboots: %u | Ring full: %u\n",
+          loadgen_offered_fps(), SIMUL_RATE_FPS, load.generated, load.duplicates, load.corrupted, load.reboots,
+          load.ring_full);
+#endif
+    LOG_INFO("Energy consumption: %.2f mAh | Avg: %.1f mA\n", energy.total_mah, energy_average_current_ma());
+#ifdef POWER_SAVE_ON
+    LOG_INFO("Power save - Sleeps: %u | Early wakes: %u | Slept: %u s | DFS: %s\n",
+          power_stats.sleeps, power_stats.early_wakes, power_stats.slept_ms / 1000,
+          power_stats.dfs_enabled ? "on" : "off");
+#endif
 #ifdef WIFI_ON
     if (wifi_connected) {
-        print_log("WiFi signal strength: %d dBm\n", get_current_wifi_rssi());
+        LOG_INFO("WiFi signal strength: %d dBm\n", get_current_wifi_rssi());
     }
+    LOG_INFO("WiFi - Attempts: %u | Reconnects: %u | Disconnects: %u | Downtime: %u s\n",
+          wifi_stats.connect_attempts, wifi_stats.reconnects, wifi_stats.disconnects,
+          get_wifi_downtime_ms() / 1000);
 #endif
-    print_log("\n\n");
-}
-
-#ifdef SIMUL_DATA
-static void generate_fake_packet() {
-    print_log("\nGenerating simulated sensor packet\n");
-
-    SensorDataMessage test_msg;
-    test_msg.msg_type = MSG_TYPE_SENSOR_DATA;
-    test_msg.client_id = 42;
-    test_msg.timestamp = millis() / 1000;
-    test_msg.humidity = random(3000, 8000);
-    test_msg.distance_cm = random(5, 200);
-    test_msg.temperature = 0;
-    test_msg.battery = random(60, 100);
-    test_msg.reserved = 0;
-
-    uint8_t* data = reinterpret_cast<uint8_t*>(&test_msg);
-    test_msg.checksum = calculate_checksum(data, sizeof(SensorDataMessage));
-
-    float fake_rssi = static_cast<float>(random(-90, -30));
-    float fake_snr = static_cast<float>(random(5, 12));
-
-    LoRaRadio::Stats lora_stats = LoRaRadio::get_instance().get_stats();
-
-    lora_stats.total_rx_packets++;
-
-    print_log("Fake data - Moisture: %.1f%% | Distance: %dcm | Presence: %s\n",
-          test_msg.humidity / 100.0f,
-          test_msg.distance_cm,
-          (test_msg.distance_cm < 100) ? "YES" : "No");
-
-    process_rx_lora_message(
-        reinterpret_cast<uint8_t*>(&test_msg),
-        sizeof(SensorDataMessage),
-        fake_rssi,
-        fake_snr
-    );
-
-    send_gateway_statistics();
-}
+#ifdef LOG_DEFERRED_ON
+    LOG_INFO("Log - Queued: %u | Dropped: %u\n", log_stats.queued, log_stats.dropped);
+#endif
+    LOG_INFO("\n\n");
 #endif
+}
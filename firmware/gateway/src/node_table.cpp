@@ -0,0 +1,199 @@
+#include "node_table.h"
+#include "logger.h"
+
+// Open addressing with linear probing over a power-of-two table. Slots are never
+// emptied, only reused in place, so a lookup can stop at the first free slot.
+static_assert((NODE_TABLE_CAPACITY & (NODE_TABLE_CAPACITY - 1)) == 0, "NODE_TABLE_CAPACITY must be a power of two");
+static_assert(NODE_TABLE_MAX_PROBE <= NODE_TABLE_CAPACITY, "Probe window larger than the table");
+
+static NodeState nodes[NODE_TABLE_CAPACITY];
+
+struct node_table_stats_t node_table_stats = {0, 0, 0, 0, 0, 0};
+
+static inline uint16_t home_slot(uint8_t client_id) {
+    // Odd multiplier permutes the ids and spreads consecutive ones apart
+    return (client_id * 157u) & (NODE_TABLE_CAPACITY - 1);
+}
+
+static inline uint16_t probe_slot(uint16_t home, uint8_t step) {
+    return (home + step) & (NODE_TABLE_CAPACITY - 1);
+}
+
+static void reset_node(NodeState* node, uint8_t client_id) {
+    memset(node, 0, sizeof(*node));
+    node->client_id = client_id;
+    node->first_seen_ms = millis();
+    node->tx_power_dbm = LORA_TX_POWER;     // Until the node reports otherwise, it uses the default
+    node->adr_target_dbm = LORA_TX_POWER;
+}
+
+NodeState* node_table_find(uint8_t client_id) {
+    if (client_id == 0) {
+        return nullptr;
+    }
+    uint16_t home = home_slot(client_id);
+    for (uint8_t step = 0; step < NODE_TABLE_MAX_PROBE; step++) {
+        NodeState* node = &nodes[probe_slot(home, step)];
+        if (node->client_id == client_id) {
+            return node;
+        }
+        if (node->client_id == 0) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+// Finds or inserts the node and records reception; when the probe window is full,
+// the least recently seen node in it is replaced
+NodeState* node_table_touch(uint8_t client_id, float rssi, float snr) {
+    if (client_id == 0) {
+        return nullptr;
+    }
+
+    uint32_t now = millis();
+    uint16_t home = home_slot(client_id);
+    NodeState* node = nullptr;
+    NodeState* oldest = nullptr;
+
+    for (uint8_t step = 0; step < NODE_TABLE_MAX_PROBE; step++) {
+        NodeState* candidate = &nodes[probe_slot(home, step)];
+        if (candidate->client_id == client_id) {
+            node = candidate;
+            break;
+        }
+        if (candidate->client_id == 0) {
+            reset_node(candidate, client_id);
+            node_table_stats.tracked++;
+            node_table_stats.inserts++;
+            node = candidate;
+            break;
+        }
+        if (oldest == nullptr || (now - candidate->last_seen_ms) > (now - oldest->last_seen_ms)) {
+            oldest = candidate;
+        }
+    }
+
+    if (node == nullptr) {
+        LOG_WARN("Node table - evicting node %u for node %u\n", oldest->client_id, client_id);
+        reset_node(oldest, client_id);
+        node_table_stats.inserts++;
+        node_table_stats.evictions++;
+        node = oldest;
+    }
+
+    node->last_seen_ms = now;
+    node->last_rssi = rssi;
+    node->last_snr = snr;
+    node->rx_frames++;
+    return node;
+}
+
+static void reset_sequence(NodeState* node, uint16_t sequence) {
+    node->sequence_valid = true;
+    node->highest_sequence = sequence;
+    node->sequence_window = 1;
+}
+
+// Tracks the node's sequence numbers: gaps count as lost until a late frame fills them.
+// A sequence already in the window is a duplicate only if its timestamp matches too; with
+// another timestamp the node rebooted and its restart frame was lost. Returns false for a
+// duplicate, which the caller drops.
+bool node_table_accept(NodeState* node, uint16_t sequence, bool restarted, uint32_t timestamp) {
+    // Signed distance from the newest sequence, correct across the 16-bit wrap
+    int16_t ahead = static_cast<int16_t>(sequence - node->highest_sequence);
+    bool seen = node->sequence_valid && ahead <= 0 && -ahead < 32 && (node->sequence_window & (1UL << -ahead));
+    uint16_t stamp = static_cast<uint16_t>(timestamp);
+
+    if (!node->sequence_valid) {
+        reset_sequence(node, sequence);
+    } else if (seen && node->window_timestamps[sequence % 32] == stamp) {
+        node->duplicates++;
+        return false;
+    } else if (restarted || seen) {
+        LOG_INFO("Node %u restarted its sequence at %u%s\n", node->client_id, sequence,
+          restarted ? "" : " (restart frame lost)");
+        node->resets++;
+        reset_sequence(node, sequence);
+    } else if (ahead > 0 && ahead <= NODE_SEQUENCE_MAX_GAP) {
+        uint32_t missed = ahead - 1;
+        node->lost += missed;
+        node_table_stats.lost += missed;
+        node->sequence_window = ahead >= 32 ? 1 : (node->sequence_window << ahead) | 1;
+        node->highest_sequence = sequence;
+    } else if (ahead < 0 && -ahead < 32) {
+        // Late arrival of a frame already counted as lost
+        node->sequence_window |= 1UL << -ahead;
+        node->reordered++;
+        node_table_stats.reordered++;
+        if (node->lost > 0) {
+            node->lost--;
+            node_table_stats.lost--;
+        }
+    } else {
+        // Too far from the window to be a gap: the node restarted its counter
+        LOG_INFO("Node %u sequence restart: %u -> %u\n", node->client_id, node->highest_sequence, sequence);
+        node->resets++;
+        reset_sequence(node, sequence);
+    }
+
+    node->window_timestamps[sequence % 32] = stamp;
+    node->last_timestamp = timestamp;
+    node->last_accepted_ms = millis();
+    node->accepted++;
+    node_table_stats.accepted++;
+    return true;
+}
+
+// Nodes without sequence numbers (V1 frames): a repeat of the last accepted timestamp
+// within DUPLICATE_WINDOW_MS is a duplicate. Returns false for one, which the caller drops.
+bool node_table_accept_legacy(NodeState* node, uint32_t timestamp) {
+    uint32_t now = millis();
+    if (node->accepted > 0 && timestamp == node->last_timestamp &&
+        (now - node->last_accepted_ms) < DUPLICATE_WINDOW_MS) {
+        node->duplicates++;
+        return false;
+    }
+
+    node->last_timestamp = timestamp;
+    node->last_accepted_ms = now;
+    node->accepted++;
+    node_table_stats.accepted++;
+    return true;
+}
+
+// Share of sent frames that never arrived, from sequence gaps
+float node_loss_percent(uint32_t accepted, uint32_t lost) {
+    uint32_t sent = accepted + lost;
+    return sent > 0 ? (static_cast<float>(lost) / sent * 100.0f) : 0.0f;
+}
+
+// Raw slot access for reporting; nullptr for free slots
+const NodeState* node_table_slot(uint16_t index) {
+    if (index >= NODE_TABLE_CAPACITY || nodes[index].client_id == 0) {
+        return nullptr;
+    }
+    return &nodes[index];
+}
+
+// Settings for the node, sent one per downlink; a newer value replaces one not yet sent
+void node_table_queue_config(NodeState* node, ConfigKey key, uint32_t value) {
+    if (key == CONFIG_KEY_NONE || key >= CONFIG_KEY_COUNT) {
+        return;
+    }
+    node->config_values[key] = value;
+    node->config_pending |= 1u << key;
+}
+
+// Takes the lowest pending setting off the node's queue
+bool node_table_next_config(NodeState* node, ConfigKey& key, uint32_t& value) {
+    for (uint8_t k = CONFIG_KEY_NONE + 1; k < CONFIG_KEY_COUNT; k++) {
+        if (node->config_pending & (1u << k)) {
+            node->config_pending &= ~(1u << k);
+            key = static_cast<ConfigKey>(k);
+            value = node->config_values[k];
+            return true;
+        }
+    }
+    return false;
+}
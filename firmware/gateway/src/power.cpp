@@ -0,0 +1,75 @@
+#include "power.h"
+#include "logger.h"
+#include "energy_manager.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+struct power_stats_t power_stats = {0, 0, 0, false};
+
+#ifdef POWER_SAVE_ON
+#include <esp_pm.h>
+#include <esp_wifi.h>
+
+static TaskHandle_t loop_task_handle = nullptr;
+
+// Must run on the loop() task: that is the task power_idle() blocks and power_wake() notifies
+void init_power() {
+    loop_task_handle = xTaskGetCurrentTaskHandle();
+
+    // Dynamic frequency scaling: the clock drops to the minimum whenever every task is blocked.
+    // Light sleep stays off, it would drop the USB serial port and stretch LoRa IRQ latency.
+    esp_pm_config_esp32s3_t pm_config;
+    pm_config.max_freq_mhz = POWER_CPU_MAX_MHZ;
+    pm_config.min_freq_mhz = POWER_CPU_MIN_MHZ;
+    pm_config.light_sleep_enable = false;
+    esp_err_t err = esp_pm_configure(&pm_config);
+    power_stats.dfs_enabled = err == ESP_OK;
+    if (power_stats.dfs_enabled) {
+        energy_set_idle_mhz(POWER_CPU_MIN_MHZ);
+        LOG_INFO("Power save: CPU %d-%d MHz\n", POWER_CPU_MIN_MHZ, POWER_CPU_MAX_MHZ);
+    } else {
+        LOG_WARN("Power save: frequency scaling unavailable (%s)\n", esp_err_to_name(err));
+    }
+}
+
+// Blocks loop() until power_wake() or the deadline; a wake that came in while loop()
+// was busy is still pending, so nothing is missed between the last check and the wait
+void power_idle(uint32_t max_wait_ms) {
+    if (loop_task_handle == nullptr || max_wait_ms == 0) {
+        return;
+    }
+    uint32_t start = millis();
+    energy_enter(ENERGY_STATE_CPU_IDLE);
+    uint32_t notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(max_wait_ms));
+    energy_enter(ENERGY_STATE_CPU_ACTIVE);
+
+    power_stats.sleeps++;
+    power_stats.slept_ms += millis() - start;
+    if (notified > 0) {
+        power_stats.early_wakes++;
+    }
+}
+
+// Safe from any task (LoRa RX, uplink, WiFi event)
+void power_wake() {
+    if (loop_task_handle != nullptr) {
+        xTaskNotifyGive(loop_task_handle);
+    }
+}
+
+// Max modem sleep only while no uplink is in flight: it stretches the time to receive
+// the HTTP response to a DTIM interval
+void power_modem_sleep(bool enable) {
+    esp_wifi_set_ps(enable ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+    if (enable) {
+        energy_leave(ENERGY_STATE_WIFI_IDLE, ENERGY_STATE_WIFI_SLEEP);
+    } else {
+        energy_leave(ENERGY_STATE_WIFI_SLEEP, ENERGY_STATE_WIFI_IDLE);
+    }
+}
+#else
+void init_power() {}
+void power_idle(uint32_t max_wait_ms) {}
+void power_wake() {}
+void power_modem_sleep(bool enable) {}
+#endif
@@ -1,215 +1,456 @@
 #include "processing.h"
 #include "lora.h"
 #include "wifi.h"
-#include "utils.h"
+#include "protocol.h"
+#include "logger.h"
 #include "batch.h"
 #include "constants.h"
-#include <ArduinoJson.h>
+#include "spool.h"
+#include "uplink.h"
+#include "node_table.h"
+#include "adr.h"
+#include "config_store.h"
+#include "alerts.h"
+#include "rules.h"
+#include "trace.h"
 
-// Estrutura para rastreamento de pacotes duplicados
-struct LastPacket {
-    uint8_t client_id;
-    uint32_t timestamp;
-    uint32_t rx_time;
-};
-static LastPacket last_packets[MAX_CLIENTS] = {0};
 static uint32_t rx_duplicate_count = 0;
 
-// Verifica se um pacote é duplicado baseado no client_id e timestamp
-static bool is_duplicate(uint8_t client_id, uint32_t timestamp) {
-    uint32_t now = millis();
-    
-    // Procura pelo cliente na lista
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (last_packets[i].client_id == client_id) {
-            // Se o timestamp é igual e está dentro da janela de tempo, é duplicado
-            if (last_packets[i].timestamp == timestamp &&
-                (now - last_packets[i].rx_time) < DUPLICATE_WINDOW_MS) {
-                return true;
-            }
-            // Atualiza o registro para este cliente
-            last_packets[i].timestamp = timestamp;
-            last_packets[i].rx_time = now;
-            return false;
-        }
+uint32_t get_duplicate_count() {
+    return rx_duplicate_count;
+}
+
+// Responde na janela de RX do nó: ACK de uplink confirmado (também para duplicatas,
+// pois o ACK anterior pode ter se perdido) e/ou parâmetros de rádio do ADR, repetidos
+// até o nó informar a nova potência nos seus frames
+static void send_downlink(NodeState* node, uint8_t flags, uint16_t sequence, float snr, FrameTrailer trailer) {
+    if (node == nullptr) {
+        return;
     }
-    
-    // Cliente não encontrado, procura slot vazio
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (last_packets[i].client_id == 0) {
-            last_packets[i].client_id = client_id;
-            last_packets[i].timestamp = timestamp;
-            last_packets[i].rx_time = now;
-            return false;
+
+    AckMessage ack;
+    ack.msg_type = MSG_TYPE_ACK;
+    ack.client_id = node->client_id;
+    ack.sequence = sequence;
+    ack.flags = (flags & SENSOR_FLAG_CONFIRMED) ? ACK_FLAG_CONFIRMED : 0;
+    ack.spreading_factor = LORA_SPREADING_FACTOR;
+    ack.tx_power_dbm = node->tx_power_dbm;
+    ack.config_key = CONFIG_KEY_NONE;
+    ack.config_value = 0;
+
+#ifdef ADR_ON
+    adr_record_frame(node, flags, snr);
+    if (flags & (SENSOR_FLAG_RX_WINDOW | SENSOR_FLAG_CONFIRMED)) {
+        adr_fill_settings(node, ack);
+    }
+#endif
+
+    // Configuração remota pendente: uma chave por janela de RX
+    ConfigKey key;
+    uint32_t value;
+    if ((flags & (SENSOR_FLAG_RX_WINDOW | SENSOR_FLAG_CONFIRMED)) && node_table_next_config(node, key, value)) {
+        ack.flags |= ACK_FLAG_CONFIG;
+        ack.config_key = key;
+        ack.config_value = value;
+    }
+
+    if (ack.flags == 0) {
+        return;
+    }
+    // Mesmo formato de trailer do uplink: nós ainda não atualizados só verificam o XOR
+    uint8_t frame[sizeof(ack) + PROTOCOL_CRC_EXTRA_BYTES];
+    memcpy(frame, &ack, sizeof(ack));
+    size_t length = protocol_seal(frame, sizeof(ack), trailer);
+    if (LoRaRadio::get_instance().queue_downlink(frame, length)) {
+        node->downlinks++;
+        return;
+    }
+    // Fila de downlink cheia: a chave de configuração volta a ficar pendente; o ADR
+    // reenvia sozinho, pois a potência só é registrada quando o nó a informa
+    LOG_DEBUG("Lora downlink to Node %u not queued - resent in its next RX window\n", node->client_id);
+    if (ack.flags & ACK_FLAG_CONFIG) {
+        node_table_queue_config(node, static_cast<ConfigKey>(ack.config_key), ack.config_value);
+    }
+}
+
+static bool checksum_ok(const uint8_t* data, size_t length, FrameTrailer trailer) {
+    TRACE_BEGIN(start);
+    bool ok = protocol_verify(data, length, trailer);
+    TRACE_END(TRACE_CHECKSUM, start);
+    if (ok && trailer == FRAME_TRAILER_XOR) {
+        LoRaRadio::get_instance().get_stats().total_rx_legacy++;   // Nó ainda com firmware antigo
+    }
+    return ok;
+}
+
+// Dedup pela sequência e encaminha; leituras repetidas são descartadas
+static void accept_sensor_reading(
+    NodeState* node,
+    const SensorDataMessage* msg,
+    float rssi,
+    float snr,
+    const struct sample_time_t& sampled
+) {
+    bool restarted = msg->flags & SENSOR_FLAG_SEQUENCE_RESTART;
+    TRACE_BEGIN(dedup_start);
+    bool accepted = node == nullptr || node_table_accept(node, msg->sequence, restarted, msg->timestamp);
+    TRACE_END(TRACE_DEDUP, dedup_start);
+    if (!accepted) {
+        rx_duplicate_count++;
+        LOG_DEBUG(
+          "Lora packet RX duplicate - packet ignored (client=%d, seq=%u)\n",
+          msg->client_id,
+          msg->sequence
+        );
+        return;
+    }
+#ifdef ALERTS_ON
+    // Regras avaliadas antes do batch: o alerta sai pela via rápida, a leitura segue o lote
+    rules_evaluate(node, msg);
+#endif
+    handle_sensor_data(msg, rssi, snr, sampled);
+}
+
+// Sinal e horário do frame recebido, repassados aos handlers pela tabela de despacho
+struct RxContext {
+    float rssi;
+    float snr;
+    struct sample_time_t received;
+};
+
+// Horário de uma leitura feita age_ms antes da recepção do frame que a trouxe
+static struct sample_time_t sampled_before(const RxContext& rx, uint32_t age_ms) {
+    struct sample_time_t sampled;
+    sampled.uptime_ms = rx.received.uptime_ms - age_ms;
+    sampled.epoch_ms = rx.received.epoch_ms != 0 ? rx.received.epoch_ms - age_ms : 0;
+    return sampled;
+}
+
+static void on_sensor_data(const SensorDataMessage& msg, const struct protocol_frame_t& frame, RxContext& rx) {
+    // Estado do nó (O(1)): dedup por número de sequência, perdas e estatísticas por nó
+    NodeState* node = node_table_touch(msg.client_id, rx.rssi, rx.snr);
+    if (node != nullptr && msg.awake_ms != 0) {
+        node->awake_ms = msg.awake_ms;
+    }
+    accept_sensor_reading(node, &msg, rx.rssi, rx.snr, rx.received);
+    send_downlink(node, msg.flags, msg.sequence, rx.snr, frame.trailer);
+}
+
+// Nó com o firmware original: sem sequência, o dedup volta a ser pelo timestamp (como no
+// firmware original) e não há contagem de perdas; sem janela de RX não há downlink
+static void on_sensor_data_v1(const SensorDataMessageV1& legacy, const struct protocol_frame_t& frame, RxContext& rx) {
+    NodeState* node = node_table_touch(legacy.client_id, rx.rssi, rx.snr);
+    TRACE_BEGIN(dedup_start);
+    bool accepted = node == nullptr || node_table_accept_legacy(node, legacy.timestamp);
+    TRACE_END(TRACE_DEDUP, dedup_start);
+    if (!accepted) {
+        rx_duplicate_count++;
+        LOG_DEBUG("Lora packet RX duplicate - packet ignored (client=%d, legacy)\n", legacy.client_id);
+        return;
+    }
+    SensorDataMessage msg = sensor_data_from_v1(legacy);
+#ifdef ALERTS_ON
+    rules_evaluate(node, &msg);
+#endif
+    handle_sensor_data(&msg, rx.rssi, rx.snr, rx.received, false);
+}
+
+// Expande um frame com várias leituras em SensorDataMessage individuais, da mais antiga à mais nova
+static void on_sensor_batch(const SensorBatchHeader& header, const struct protocol_frame_t& frame, RxContext& rx) {
+    LOG_DEBUG("Lora packet RX - Sensor batch from Node %d: %u readings\n", header.client_id, header.count);
+    NodeState* node = node_table_touch(header.client_id, rx.rssi, rx.snr);
+    if (node != nullptr && header.awake_ms != 0) {
+        node->awake_ms = header.awake_ms;
+    }
+
+    // Registros de delta logo após o cabeçalho, lidos no próprio buffer de RX
+    const SensorBatchRecord* records =
+        protocol_view<SensorBatchRecord>(reinterpret_cast<const uint8_t*>(&header) + sizeof(header));
+
+    for (uint8_t i = 0; i < header.count; i++) {
+        SensorDataMessage msg;
+        msg.msg_type = MSG_TYPE_SENSOR_DATA;
+        msg.client_id = header.client_id;
+        msg.temperature = header.temperature;
+        msg.humidity = header.humidity;
+        msg.distance_cm = header.distance_cm;
+        msg.luminosity_lux = header.luminosity_lux;
+        msg.battery = header.battery;
+        msg.sequence = header.sequence + i;
+        msg.flags = (i == 0) ? header.flags : 0;
+        msg.awake_ms = header.awake_ms;
+
+        if (i > 0) {
+            const SensorBatchRecord& record = records[i - 1];
+            msg.temperature += record.temperature_delta * SENSOR_BATCH_DELTA_SCALE;
+            msg.humidity += record.humidity_delta * SENSOR_BATCH_DELTA_SCALE;
+            msg.distance_cm += record.distance_delta;
+            msg.luminosity_lux += record.luminosity_delta;
         }
+
+        // A última leitura é a mais nova; as anteriores foram amostradas a cada interval_s
+        uint32_t age_ms = static_cast<uint32_t>(header.count - 1 - i) * header.interval_s * 1000UL;
+        msg.timestamp = header.timestamp - age_ms;
+        msg.checksum = calculate_checksum(reinterpret_cast<uint8_t*>(&msg), sizeof(msg));
+
+        accept_sensor_reading(node, &msg, rx.rssi, rx.snr, sampled_before(rx, age_ms));
     }
-    
-    // Sem slot vazio, substitui o primeiro
-    last_packets[0].client_id = client_id;
-    last_packets[0].timestamp = timestamp;
-    last_packets[0].rx_time = now;
-    return false;
+
+    send_downlink(node, header.flags, header.sequence + header.count - 1, rx.snr, frame.trailer);
 }
 
-uint32_t get_duplicate_count() {
-    return rx_duplicate_count;
+// Agregado do nó (min/max/média): a média segue como leitura normal, min/max ficam no log
+static void on_sensor_aggregate(const SensorAggregateMessage& aggregate, const struct protocol_frame_t& frame, RxContext& rx) {
+    LOG_DEBUG(
+      "Lora packet RX - Sensor aggregate from Node %d: %u samples | Temp=%.1f..%.1f°C | "
+      "Moisture=%.1f..%.1f%% | Distance=%u..%ucm | Lux=%u..%u\n",
+      aggregate.client_id,
+      aggregate.count,
+      decode_temperature(aggregate.temperature_min),
+      decode_temperature(aggregate.temperature_max),
+      decode_humidity(aggregate.humidity_min),
+      decode_humidity(aggregate.humidity_max),
+      aggregate.distance_min,
+      aggregate.distance_max,
+      aggregate.luminosity_min,
+      aggregate.luminosity_max
+    );
+    NodeState* node = node_table_touch(aggregate.client_id, rx.rssi, rx.snr);
+    if (node != nullptr && aggregate.awake_ms != 0) {
+        node->awake_ms = aggregate.awake_ms;
+    }
+
+    SensorDataMessage msg;
+    msg.msg_type = MSG_TYPE_SENSOR_DATA;
+    msg.client_id = aggregate.client_id;
+    msg.timestamp = aggregate.timestamp;
+    msg.temperature = aggregate.temperature_mean;
+    msg.humidity = aggregate.humidity_mean;
+    msg.distance_cm = aggregate.distance_mean;
+    msg.luminosity_lux = aggregate.luminosity_mean;
+    msg.battery = aggregate.battery;
+    msg.sequence = aggregate.sequence;
+    msg.flags = aggregate.flags;
+    msg.awake_ms = aggregate.awake_ms;
+    msg.checksum = calculate_checksum(reinterpret_cast<uint8_t*>(&msg), sizeof(msg));
+
+    accept_sensor_reading(node, &msg, rx.rssi, rx.snr, rx.received);
+    send_downlink(node, aggregate.flags, aggregate.sequence, rx.snr, frame.trailer);
+}
+
+static void on_heartbeat(const HeartbeatMessage& hb, const struct protocol_frame_t& frame, RxContext& rx) {
+    // Não é encaminhado: o status vai junto com as estatísticas do nó
+    NodeState* node = node_table_touch(hb.client_id, rx.rssi, rx.snr);
+    if (node != nullptr) {
+        node->heartbeat_status = hb.status;
+        node->heartbeats++;
+        node->last_heartbeat_ms = millis();
+    }
+    LOG_DEBUG(
+      "Lora packet RX - Heartbeat from Node %d (status: 0x%02X)\n",
+      hb.client_id,
+      hb.status
+    );
+}
+
+static void on_alert(const AlertMessage& alert, const struct protocol_frame_t& frame, RxContext& rx) {
+    node_table_touch(alert.client_id, rx.rssi, rx.snr);
+    LOG_DEBUG(
+      "Lora packet RX - ALERT from Node %d: code=0x%02X | value=%d | severity=%d\n",
+      alert.client_id,
+      alert.alert_code,
+      alert.alert_value,
+      alert.severity
+    );
+#ifdef ALERTS_ON
+    alert_raise(alert.client_id, alert.alert_code, alert.alert_value, alert.severity, ALERT_SOURCE_NODE);
+#endif
 }
 
+// Tabela de despacho por msg_type: tamanho e checksum são validados pelo codec antes do handler;
+// layouts com o mesmo msg_type são tentados na ordem da tabela
+static const protocol_route_t<RxContext> rx_routes[] = {
+    PROTOCOL_ROUTE(SensorDataMessage, RxContext, on_sensor_data),
+    PROTOCOL_ROUTE(SensorDataMessageV1, RxContext, on_sensor_data_v1),     // Mesmo msg_type, 17 bytes
+    PROTOCOL_ROUTE(SensorBatchHeader, RxContext, on_sensor_batch),
+    PROTOCOL_ROUTE(SensorAggregateMessage, RxContext, on_sensor_aggregate),
+    PROTOCOL_ROUTE(HeartbeatMessage, RxContext, on_heartbeat),
+    PROTOCOL_ROUTE(AlertMessage, RxContext, on_alert),
+};
+
 void process_rx_lora_message(
     uint8_t* data,
     size_t length,
     float rssi,
-    float snr
+    float snr,
+    const struct sample_time_t& received
 ) {
-    LoRaRadio& radio = LoRaRadio::get_instance();
-    LoRaRadio::Stats& stats = radio.get_stats();  // Use reference to modify original
+    LoRaRadio::Stats& stats = LoRaRadio::get_instance().get_stats();  // Use reference to modify original
 
-    if (length < 1) {
+    RxContext rx = {rssi, snr, received};
+    const protocol_route_t<RxContext>* route = nullptr;
+    switch (protocol_dispatch(rx_routes, data, length, rx, checksum_ok, &route)) {
+    case PROTOCOL_OK:
+        stats.total_rx_valids++;
+        break;
+    case PROTOCOL_BAD_CHECKSUM:
+        LOG_WARN("Lora packet RX checksum error - %s discarded\n", route->name());
+        stats.total_checksum_errors++;
         stats.total_rx_invalids++;
-        return;
-    }
-
-    uint8_t msg_type = data[0];
-
-    switch (msg_type) {
-    case MSG_TYPE_SENSOR_DATA:
-        if (length == sizeof(SensorDataMessage)) {
-            SensorDataMessage* sensor_msg = reinterpret_cast<SensorDataMessage*>(data);
-            if (verify_checksum(data, length)) {
-                // Verifica se é um pacote duplicado
-                if (is_duplicate(sensor_msg->client_id, sensor_msg->timestamp)) {
-                    rx_duplicate_count++;
-                    print_log("Lora packet RX duplicate - packet ignored (client=%d)\n", sensor_msg->client_id);
-                } else {
-                    handle_sensor_data(sensor_msg, rssi, snr);
-                    stats.total_rx_valids++;
-                }
-            } else {
-                print_log("Lora packet RX checksum error - packet discarded\n");
-                stats.total_checksum_errors++;
-                stats.total_rx_invalids++;
-            }
-        } else {
-            print_log(
-              "Lora packet RX invalid sensor data length: %d (expected %d)\n",
-              length,
-              sizeof(SensorDataMessage)
-            );
-            stats.total_rx_invalids++;
-        }
         break;
-
-    case MSG_TYPE_HEARTBEAT:
-        if (length == sizeof(HeartbeatMessage) && verify_checksum(data, length)) {
-            HeartbeatMessage* hb = reinterpret_cast<HeartbeatMessage*>(data);
-            print_log(
-              "Lora packet RX - Heartbeat from Node %d (status: 0x%02X)\n",
-              hb->client_id,
-              hb->status
-            );
-            stats.total_rx_valids++;
-        } else {
-            stats.total_rx_invalids++;
-        }
+    case PROTOCOL_BAD_LENGTH:
+        LOG_WARN("Lora packet RX invalid %s length: %d\n", route->name(), length);
+        stats.total_rx_invalids++;
         break;
-
-    case MSG_TYPE_ALERT:
-        if (length == sizeof(AlertMessage) && verify_checksum(data, length)) {
-            AlertMessage* alert = reinterpret_cast<AlertMessage*>(data);
-            print_log(
-              "Lora packet RX - ALERT from Node %d: code=0x%02X | value=%d | severity=%d\n",
-              alert->client_id,
-              alert->alert_code,
-              alert->alert_value,
-              alert->severity
-            );
-            stats.total_rx_valids++;
-        } else {
-            stats.total_rx_invalids++;
-        }
+    case PROTOCOL_UNKNOWN_TYPE:
+        LOG_WARN("Lora packet RX - Unknown message type: 0x%02X\n", data[0]);
+        stats.total_rx_invalids++;
         break;
-
+    case PROTOCOL_EMPTY:
     default:
-        print_log("Lora packet RX - Unknown message type: 0x%02X\n", msg_type);
         stats.total_rx_invalids++;
         break;
     }
 }
 
-static String build_sensor_json(SensorDataMessage* msg, float rssi, float snr) {
-    StaticJsonDocument<512> doc;
-
-    // Node identification
-    char node_id[20];
-    snprintf(node_id, sizeof(node_id), "node-%d", msg->client_id);
-    doc["node_id"] = node_id;
-    doc["NODE_ID"] = NODE_ID;
+size_t write_sensor_json(
+    char* out,
+    size_t capacity,
+    const SensorDataMessage* msg,
+    float rssi,
+    float snr,
+    uint64_t rx_epoch_ms,
+    bool sequenced
+) {
+    TRACE_BEGIN(start);
+    // Horário da leitura, não o da montagem do JSON: a espera no ring e no batch não conta
+    char timestamp[40];
+    if (rx_epoch_ms != 0) {
+        format_epoch_timestamp(timestamp, sizeof(timestamp), rx_epoch_ms);
+    } else {
+        format_iso8601_timestamp(timestamp, sizeof(timestamp));
+    }
 
-    // Timestamps
-    doc["timestamp"] = get_iso8601_timestamp();
-    doc["client_timestamp"] = msg->timestamp;
+    // Epoch absoluto em inteiro: o servidor usa este campo em vez de interpretar o texto
+    char epoch_field[40] = "";
+    if (rx_epoch_ms != 0) {
+        snprintf(epoch_field, sizeof(epoch_field), ",\"epoch_ms\":%llu", static_cast<unsigned long long>(rx_epoch_ms));
+    }
+    // Sem sequência (nó com firmware V1) o campo é omitido: o servidor não deduplica a leitura
+    char sequence_field[24] = "";
+    if (sequenced) {
+        snprintf(sequence_field, sizeof(sequence_field), ",\"sequence\":%u", msg->sequence);
+    }
 
-    // Sensor data
     const float temperature = decode_temperature(msg->temperature);
     const float humidity = decode_humidity(msg->humidity);
     const uint16_t distance = msg->distance_cm;
-    const uint16_t luminosity = msg->luminosity_lux;
-    const bool presence = distance < 100;
-
-    JsonObject sensors = doc["sensors"].to<JsonObject>();
-    sensors["temperature_celsius"] = temperature;
-    sensors["humidity_percent"] = humidity;
-    sensors["distance_cm"] = distance;
-    sensors["luminosity_lux"] = luminosity;
-    sensors["presence_detected"] = presence;
-
-    // Battery
-    doc["battery_percent"] = msg->battery;
-
-    // Radio metrics
-    JsonObject radio = doc["radio"].to<JsonObject>();
-    radio["rssi_dbm"] = rssi;
-    radio["snr_db"] = snr;
-
-    String json;
-    serializeJson(doc, json);
-    return json;
+    const bool presence = distance < MAX_DISTANCE_TO_BE_PRESENCE_CM;
+
+    // Escrita direta no buffer do chamador: sem String, sem JsonDocument
+    int written = snprintf(
+        out,
+        capacity,
+        "{\"node_id\":\"node-%u\",\"NODE_ID\":%d,"
+        "\"timestamp\":\"%s\"%s,\"client_timestamp\":%lu%s,"
+        "\"sensors\":{\"temperature_celsius\":%.2f,\"humidity_percent\":%.2f,"
+        "\"distance_cm\":%u,\"luminosity_lux\":%u,\"presence_detected\":%s},"
+        "\"battery_percent\":%u,\"awake_ms\":%u,"
+        "\"radio\":{\"rssi_dbm\":%.1f,\"snr_db\":%.2f}}",
+        msg->client_id,
+        NODE_ID,
+        timestamp,
+        epoch_field,
+        static_cast<unsigned long>(msg->timestamp),
+        sequence_field,
+        temperature,
+        humidity,
+        distance,
+        msg->luminosity_lux,
+        presence ? "true" : "false",
+        msg->battery,
+        msg->awake_ms,
+        rssi,
+        snr
+    );
+    TRACE_END(TRACE_JSON, start);
+
+    if (written <= 0 || static_cast<size_t>(written) >= capacity) {
+        return 0;
+    }
+    return written;
 }
 
-void handle_sensor_data(SensorDataMessage* msg, float rssi, float snr) {
-    const float temperature = decode_temperature(msg->temperature);
-    const float humidity = decode_humidity(msg->humidity);
-    const uint16_t distance = msg->distance_cm;
-    const uint16_t luminosity = msg->luminosity_lux;
-    const bool presence = distance < MAX_DISTANCE_TO_BE_PRESENCE_CM;
+#ifdef WIFI_ON
+#if !defined(BATCH_ON) || defined(BATCH_BINARY)
+// Sem batch, ou leituras sem sequência no batch binário, seguem em um POST avulso
+static bool forward_sensor_json(const SensorDataMessage* msg, float rssi, float snr, const struct sample_time_t& sampled, bool sequenced) {
+    char json[SENSOR_JSON_MAX_SIZE];
+    size_t length = write_sensor_json(json, sizeof(json), msg, rssi, snr, sampled.epoch_ms, sequenced);
+    if (length == 0) {
+        return false;
+    }
+    LOG_DEBUG("Forwarding to server...\n");
+    return forward_to_server(json, length);
+}
+#endif
+#endif
 
-    print_log(
+void handle_sensor_data(const SensorDataMessage* msg, float rssi, float snr, const struct sample_time_t& sampled, bool sequenced) {
+    // Decodificação só acontece dentro do LOG_DEBUG: abaixo do nível, nada é avaliado
+    LOG_DEBUG(
       "Lora Data handling - Node %d: Temp=%.1f°C | Moisture=%.1f%% | Distance=%dcm | Lux=%u | Presence=%s | Battery=%d%%\n",
       msg->client_id,
-      temperature,
-      humidity,
-      distance,
-      luminosity,
-      presence ? "YES" : "No",
+      decode_temperature(msg->temperature),
+      decode_humidity(msg->humidity),
+      msg->distance_cm,
+      msg->luminosity_lux,
+      msg->distance_cm < MAX_DISTANCE_TO_BE_PRESENCE_CM ? "YES" : "No",
       msg->battery
     );
 
-    String json = build_sensor_json(msg, rssi, snr);
-
 #ifdef WIFI_ON
-    print_log("WiFi status: %s\n", wifi_connected ? "connected" : "disconnected");
-    if (wifi_connected) {
-#ifdef BATCH_ON
-        print_log("Adding to batch...\n");
-        add_to_batch(json);
+    LOG_DEBUG("WiFi status: %s\n", wifi_connected ? "connected" : "disconnected");
+    bool forwarded = false;
+    // Mesmo critério do uplink_enqueue(), inclusive os slots reservados para alertas
+    if (wifi_connected && uplink_has_room(UPLINK_SENSOR_DATA)) {
+#if defined(BATCH_ON) && defined(BATCH_BINARY)
+        // Registros binários sempre levam sequência: leituras sem ela seguem em JSON avulso
+        if (sequenced) {
+            LOG_DEBUG("Adding to batch...\n");
+            forwarded = add_to_batch(msg, rssi, snr, sampled);
+        } else {
+            forwarded = forward_sensor_json(msg, rssi, snr, sampled, sequenced);
+        }
+#elif defined(BATCH_ON)
+        LOG_DEBUG("Adding to batch...\n");
+        forwarded = add_to_batch(msg, rssi, snr, sampled, sequenced);
 #else
-        print_log("Forwarding to server...\n");
-        forward_to_server(json.c_str());
+        forwarded = forward_sensor_json(msg, rssi, snr, sampled, sequenced);
+#endif
+    }
+
+    if (!forwarded) {
+#ifdef SPOOL_ON
+        // Uplink indisponível: guarda o frame bruto na flash para replay posterior, no
+        // layout V1 se o nó não numera as leituras (o replay distingue pelo tamanho)
+        bool stored;
+        if (sequenced) {
+            stored = spool_store(reinterpret_cast<const uint8_t*>(msg), sizeof(SensorDataMessage), rssi, snr, sampled);
+        } else {
+            SensorDataMessageV1 legacy = sensor_data_to_v1(*msg);
+            stored = spool_store(reinterpret_cast<const uint8_t*>(&legacy), sizeof(legacy), rssi, snr, sampled);
+        }
+        if (stored) {
+            LOG_WARN("Uplink unavailable - reading spooled to flash\n");
+        } else {
+            LOG_ERROR("Uplink unavailable - spool write failed, reading dropped\n");
+        }
+#else
+        LOG_WARN("Skipping server forward - uplink unavailable\n");
 #endif
-    } else {
-        print_log("Skipping server forward - WiFi not connected\n");
     }
 #else
-    print_log("WiFi is disabled (WIFI_ON not defined)\n");
+    LOG_WARN("WiFi is disabled (WIFI_ON not defined)\n");
 #endif
 }
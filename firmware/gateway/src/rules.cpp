@@ -0,0 +1,86 @@
+#include "rules.h"
+#include "alerts.h"
+#include "protocol.h"
+#include "logger.h"
+
+#ifdef ALERTS_ON
+typedef enum {
+    RULE_METRIC_TEMPERATURE,
+    RULE_METRIC_HUMIDITY,
+    RULE_METRIC_DISTANCE,
+    RULE_METRIC_BATTERY,
+} RuleMetric;
+
+// Raised when the value crosses the threshold, cleared once it is back past
+// threshold -/+ hysteresis, so a reading hovering at the limit raises only once
+struct AlertRule {
+    AlertCode   code;
+    RuleMetric  metric;
+    bool        above;          // true: alert when value > threshold
+    float       threshold;
+    float       hysteresis;
+    uint8_t     severity;
+};
+
+static const AlertRule rules[] = {
+    {ALERT_TEMPERATURE_HIGH, RULE_METRIC_TEMPERATURE, true,  ALERT_TEMPERATURE_HIGH_C,    1.0f,  3},
+    {ALERT_TEMPERATURE_LOW,  RULE_METRIC_TEMPERATURE, false, ALERT_TEMPERATURE_LOW_C,     1.0f,  3},
+    {ALERT_HUMIDITY_HIGH,    RULE_METRIC_HUMIDITY,    true,  ALERT_HUMIDITY_HIGH_PERCENT, 2.0f,  2},
+    {ALERT_HUMIDITY_LOW,     RULE_METRIC_HUMIDITY,    false, ALERT_HUMIDITY_LOW_PERCENT,  2.0f,  2},
+    {ALERT_DISTANCE_LOW,     RULE_METRIC_DISTANCE,    false, ALERT_DISTANCE_LOW_CM,       10.0f, 1},
+    {ALERT_BATTERY_LOW,      RULE_METRIC_BATTERY,     false, ALERT_BATTERY_LOW_PERCENT,   5.0f,  2},
+};
+
+static const uint8_t RULE_COUNT = sizeof(rules) / sizeof(rules[0]);
+static_assert(sizeof(rules) / sizeof(rules[0]) <= 8, "NodeState::alerts_active holds 8 rules");
+
+static float metric_value(RuleMetric metric, const SensorDataMessage* msg) {
+    switch (metric) {
+    case RULE_METRIC_TEMPERATURE:   return decode_temperature(msg->temperature);
+    case RULE_METRIC_HUMIDITY:      return decode_humidity(msg->humidity);
+    case RULE_METRIC_DISTANCE:      return msg->distance_cm;
+    case RULE_METRIC_BATTERY:
+    default:                        return msg->battery;
+    }
+}
+
+// Same encoding as the node's AlertMessage.alert_value
+static int16_t metric_encoded(RuleMetric metric, const SensorDataMessage* msg) {
+    switch (metric) {
+    case RULE_METRIC_TEMPERATURE:   return msg->temperature;
+    case RULE_METRIC_HUMIDITY:      return static_cast<int16_t>(msg->humidity);
+    case RULE_METRIC_DISTANCE:      return static_cast<int16_t>(msg->distance_cm);
+    case RULE_METRIC_BATTERY:
+    default:                        return msg->battery;
+    }
+}
+
+// Runs on every accepted reading, before it joins the batch
+void rules_evaluate(NodeState* node, const SensorDataMessage* msg) {
+    if (node == nullptr) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < RULE_COUNT; i++) {
+        const AlertRule& rule = rules[i];
+        float value = metric_value(rule.metric, msg);
+        uint8_t bit = 1u << i;
+
+        if (!(node->alerts_active & bit)) {
+            bool triggered = rule.above ? value > rule.threshold : value < rule.threshold;
+            if (triggered) {
+                node->alerts_active |= bit;
+                alert_raise(node->client_id, rule.code, metric_encoded(rule.metric, msg), rule.severity, ALERT_SOURCE_GATEWAY);
+            }
+        } else {
+            bool cleared = rule.above
+                ? value < rule.threshold - rule.hysteresis
+                : value > rule.threshold + rule.hysteresis;
+            if (cleared) {
+                node->alerts_active &= ~bit;
+                LOG_DEBUG("Alert cleared - node %u: rule 0x%02X\n", node->client_id, rule.code);
+            }
+        }
+    }
+}
+#endif
@@ -0,0 +1,470 @@
+#include "spool.h"
+#include "logger.h"
+#include "wifi.h"
+#include "uplink.h"
+#include "processing.h"
+#include "protocol.h"
+#include <LittleFS.h>
+#include <HTTPClient.h>
+
+#ifdef SPOOL_ON
+#define SPOOL_DIR               "/spool"
+#define SPOOL_META_PATH         "/spool/meta"
+#define SPOOL_RECORD_MAGIC      0xA5
+#define SPOOL_META_MAGIC        0x53504F4CUL    // "SPOL"
+
+// Records are raw frames (uplink unavailable at reception) or whole request bodies the
+// server did not confirm, replayed unchanged
+enum SpoolRecordKind : uint8_t {
+    SPOOL_RECORD_FRAME = 0,     // Older firmware wrote 0 here: its records read as frames
+    SPOOL_RECORD_JSON_BODY,
+    SPOOL_RECORD_BINARY_BODY,
+};
+
+// Append-only log: each segment file is a sequence of [header][raw frame or body]
+struct __attribute__((packed)) SpoolRecordHeader {
+    uint8_t     magic;          // SPOOL_RECORD_MAGIC
+    uint8_t     length;         // Record length, low byte (a frame is always shorter than 256)
+    uint8_t     length_high;    // Record length, high byte: bodies only
+    uint8_t     kind;           // SpoolRecordKind
+    float       rssi;           // Frames only
+    float       snr;
+    uint32_t    boot_session;   // Random per boot, to trust rx_uptime_ms
+    uint32_t    rx_uptime_ms;   // millis() at reception
+    uint64_t    rx_epoch_ms;    // Epoch at reception, 0 if time was not synced
+};
+
+struct SpoolCursor {
+    uint8_t segment;
+    uint32_t offset;
+};
+
+struct SpoolMeta {
+    uint32_t magic;
+    uint8_t head_segment;
+    SpoolCursor tail;
+};
+
+struct spool_stats_t spool_stats = {0, 0, 0, 0};
+
+static bool spool_ready = false;
+static uint32_t boot_session = 0;
+static File head_file;
+
+static SpoolCursor head = {0, 0};           // Next write position
+static SpoolCursor tail = {0, 0};           // Oldest frame not yet confirmed by the server
+static SpoolCursor read_cursor = {0, 0};    // Next frame to replay
+
+// Replay in flight on the uplink task; the result is applied from spool_drain()
+static volatile bool replay_in_flight = false;
+static volatile int8_t replay_result = 0;   // 0 = pending, 1 = delivered, -1 = failed
+static bool replay_invalidated = false;     // Segment dropped while the replay was in flight
+static SpoolCursor replay_end = {0, 0};
+static uint16_t replay_count = 0;
+static uint32_t last_drain_time = 0;
+
+static UplinkKind replay_kind = UPLINK_SENSOR_DATA;
+static char replay_buffer[UPLINK_MAX_BODY_SIZE];
+
+static size_t record_length(const SpoolRecordHeader& header) {
+    return header.length | (static_cast<size_t>(header.length_high) << 8);
+}
+
+static void segment_path(uint8_t segment, char* out, size_t size) {
+    snprintf(out, size, SPOOL_DIR "/%u.log", segment);
+}
+
+static bool same_position(const SpoolCursor& a, const SpoolCursor& b) {
+    return a.segment == b.segment && a.offset == b.offset;
+}
+
+static void save_meta() {
+    SpoolMeta meta = {SPOOL_META_MAGIC, head.segment, tail};
+    File f = LittleFS.open(SPOOL_META_PATH, FILE_WRITE);
+    if (!f || f.write(reinterpret_cast<const uint8_t*>(&meta), sizeof(meta)) != sizeof(meta)) {
+        spool_stats.errors++;
+    }
+    if (f) {
+        f.close();
+    }
+}
+
+static void open_head_file() {
+    char path[24];
+    segment_path(head.segment, path, sizeof(path));
+    head_file = LittleFS.open(path, FILE_APPEND);
+    head.offset = head_file ? head_file.size() : 0;
+}
+
+static void remove_segment(uint8_t segment) {
+    char path[24];
+    segment_path(segment, path, sizeof(path));
+    if (LittleFS.exists(path)) {
+        LittleFS.remove(path);
+    }
+}
+
+static uint32_t count_records(uint8_t segment) {
+    char path[24];
+    segment_path(segment, path, sizeof(path));
+    File f = LittleFS.open(path, FILE_READ);
+    if (!f) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    uint32_t offset = 0;
+    SpoolRecordHeader header;
+    while (f.seek(offset) &&
+           f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+           header.magic == SPOOL_RECORD_MAGIC) {
+        count++;
+        offset += sizeof(header) + record_length(header);
+    }
+    f.close();
+    return count;
+}
+
+// Moves writing to the next segment; when the ring is full the oldest segment is dropped
+static void rotate_head() {
+    head_file.close();
+    uint8_t next = (head.segment + 1) % SPOOL_SEGMENT_COUNT;
+
+    if (next == tail.segment) {
+        spool_stats.overwritten += count_records(next);
+        tail.segment = (next + 1) % SPOOL_SEGMENT_COUNT;
+        tail.offset = 0;
+        if (read_cursor.segment == next) {
+            read_cursor = tail;
+        }
+        if (replay_in_flight) {
+            replay_invalidated = true;
+        }
+        LOG_WARN("Spool full - oldest segment %u overwritten\n", next);
+    }
+
+    remove_segment(next);
+    head.segment = next;
+    open_head_file();
+    save_meta();
+}
+
+void init_spool() {
+    if (!LittleFS.begin(true)) {
+        LOG_ERROR("Spool: LittleFS mount failed, store-and-forward disabled\n");
+        return;
+    }
+    if (!LittleFS.exists(SPOOL_DIR)) {
+        LittleFS.mkdir(SPOOL_DIR);
+    }
+    boot_session = esp_random();
+
+    SpoolMeta meta;
+    File f = LittleFS.open(SPOOL_META_PATH, FILE_READ);
+    bool meta_valid = f &&
+        f.read(reinterpret_cast<uint8_t*>(&meta), sizeof(meta)) == sizeof(meta) &&
+        meta.magic == SPOOL_META_MAGIC &&
+        meta.head_segment < SPOOL_SEGMENT_COUNT &&
+        meta.tail.segment < SPOOL_SEGMENT_COUNT;
+    if (f) {
+        f.close();
+    }
+
+    if (meta_valid) {
+        head.segment = meta.head_segment;
+        tail = meta.tail;
+    } else {
+        for (uint8_t i = 0; i < SPOOL_SEGMENT_COUNT; i++) {
+            remove_segment(i);
+        }
+        head.segment = 0;
+        tail.segment = 0;
+        tail.offset = 0;
+    }
+
+    open_head_file();
+    read_cursor = tail;
+    if (!meta_valid) {
+        save_meta();
+    }
+    spool_ready = true;
+
+    LOG_INFO(
+      "Spool ready - head %u:%u | tail %u:%u\n",
+      head.segment, head.offset, tail.segment, tail.offset
+    );
+}
+
+static bool append_record(SpoolRecordHeader& header, const uint8_t* data, size_t length) {
+    if (head.offset + sizeof(SpoolRecordHeader) + length > SPOOL_SEGMENT_SIZE) {
+        rotate_head();
+    }
+
+    header.magic = SPOOL_RECORD_MAGIC;
+    header.length = length & 0xFF;
+    header.length_high = length >> 8;
+    header.boot_session = boot_session;
+
+    if (!head_file ||
+        head_file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) != sizeof(header) ||
+        head_file.write(data, length) != length) {
+        spool_stats.errors++;
+        return false;
+    }
+    head_file.flush();
+
+    head.offset += sizeof(header) + length;
+    spool_stats.stored++;
+    return true;
+}
+
+bool spool_store(const uint8_t* frame, size_t length, float rssi, float snr, const struct sample_time_t& sampled) {
+    if (!spool_ready || length == 0 || length > UINT8_MAX) {
+        return false;
+    }
+
+    SpoolRecordHeader header;
+    header.kind = SPOOL_RECORD_FRAME;
+    header.rssi = rssi;
+    header.snr = snr;
+    // Time the reading was sampled, already backdated for readings carried in a batch frame
+    header.rx_uptime_ms = sampled.uptime_ms;
+    header.rx_epoch_ms = sampled.epoch_ms;
+    return append_record(header, frame, length);
+}
+
+// A sensor data body as it was sent: readings inside already carry their own timestamps
+bool spool_store_body(UplinkKind kind, const char* body, size_t length) {
+    if (!spool_ready || length == 0 || length > UPLINK_MAX_BODY_SIZE ||
+        (kind != UPLINK_SENSOR_DATA && kind != UPLINK_SENSOR_DATA_BIN)) {
+        return false;
+    }
+
+    SpoolRecordHeader header;
+    header.kind = kind == UPLINK_SENSOR_DATA_BIN ? SPOOL_RECORD_BINARY_BODY : SPOOL_RECORD_JSON_BODY;
+    header.rssi = 0.0f;
+    header.snr = 0.0f;
+    header.rx_uptime_ms = millis();
+    header.rx_epoch_ms = 0;
+    return append_record(header, reinterpret_cast<const uint8_t*>(body), length);
+}
+
+// uplink_reclaim() handler: a data request the server did not confirm
+void spool_store_undelivered(UplinkKind kind, const char* body, size_t length) {
+    if (spool_store_body(kind, body, length)) {
+        LOG_WARN("Uplink not confirmed - %u bytes spooled to flash\n", length);
+    } else {
+        LOG_ERROR("Uplink not confirmed - spool write failed, %u bytes dropped\n", length);
+    }
+}
+
+bool spool_is_empty() {
+    return same_position(tail, head);
+}
+
+// Runs on the uplink sender task
+static void on_replay_complete(const struct uplink_result_t& result) {
+    bool delivered = result.http_code == HTTP_CODE_OK || result.http_code == HTTP_CODE_CREATED;
+    replay_result = delivered ? 1 : -1;
+}
+
+// Deletes segments the committed tail has moved past
+static void commit_tail(const SpoolCursor& new_tail) {
+    while (tail.segment != new_tail.segment) {
+        remove_segment(tail.segment);
+        tail.segment = (tail.segment + 1) % SPOOL_SEGMENT_COUNT;
+    }
+    tail.offset = new_tail.offset;
+    save_meta();
+}
+
+static void apply_replay_result() {
+    if (replay_result > 0 && !replay_invalidated) {
+        commit_tail(replay_end);
+        spool_stats.replayed += replay_count;
+        LOG_INFO("Spool replay delivered %u records\n", replay_count);
+    } else {
+        // Not delivered: resend from the last confirmed position
+        read_cursor = tail;
+    }
+    replay_invalidated = false;
+    replay_result = 0;
+    replay_in_flight = false;
+}
+
+static uint64_t record_epoch_ms(const SpoolRecordHeader& header) {
+    if (header.rx_epoch_ms != 0) {
+        return header.rx_epoch_ms;
+    }
+    // Received before NTP sync: recover the time if it happened during this boot
+    uint64_t now_epoch = get_epoch_ms();
+    if (now_epoch != 0 && header.boot_session == boot_session) {
+        return now_epoch - (millis() - header.rx_uptime_ms);
+    }
+    return 0;
+}
+
+// Reads frames from read_cursor into a JSON array; returns the number of records added.
+// A spooled body is sent on its own, unchanged, with its original request kind.
+static uint16_t build_replay_batch(size_t& length, UplinkKind& kind) {
+    uint16_t count = 0;
+    length = 0;
+    kind = UPLINK_SENSOR_DATA;
+
+    char path[24];
+    File f;
+    int16_t open_segment = -1;
+    uint8_t frame[UINT8_MAX];
+    SpoolRecordHeader header;
+
+    while (count < SPOOL_REPLAY_BATCH) {
+        if (same_position(read_cursor, head)) {
+            break;
+        }
+
+        if (open_segment != read_cursor.segment) {
+            if (f) {
+                f.close();
+            }
+            segment_path(read_cursor.segment, path, sizeof(path));
+            f = LittleFS.open(path, FILE_READ);
+            open_segment = read_cursor.segment;
+        }
+
+        bool at_end = !f || read_cursor.offset >= f.size();
+        if (at_end && read_cursor.segment != head.segment) {
+            read_cursor.segment = (read_cursor.segment + 1) % SPOOL_SEGMENT_COUNT;
+            read_cursor.offset = 0;
+            continue;
+        }
+
+        bool body = false;
+        bool readable = !at_end &&
+            f.seek(read_cursor.offset) &&
+            f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+            header.magic == SPOOL_RECORD_MAGIC;
+        if (readable) {
+            body = header.kind != SPOOL_RECORD_FRAME;
+            if (body && count > 0) {
+                break;      // Bodies go alone: send the frames gathered so far first
+            }
+            uint8_t* dest = body ? reinterpret_cast<uint8_t*>(replay_buffer) : frame;
+            size_t capacity = body ? sizeof(replay_buffer) : sizeof(frame);
+            readable = record_length(header) <= capacity &&
+                f.read(dest, record_length(header)) == record_length(header);
+        }
+        if (!readable) {
+            // Torn write or corruption: the rest of this segment cannot be trusted
+            spool_stats.errors++;
+            if (read_cursor.segment == head.segment) {
+                read_cursor = head;
+            } else {
+                read_cursor.segment = (read_cursor.segment + 1) % SPOOL_SEGMENT_COUNT;
+                read_cursor.offset = 0;
+            }
+            continue;
+        }
+
+        uint32_t record_size = sizeof(header) + record_length(header);
+
+        if (body) {
+            read_cursor.offset += record_size;
+            if (header.kind != SPOOL_RECORD_JSON_BODY && header.kind != SPOOL_RECORD_BINARY_BODY) {
+                spool_stats.errors++;
+                length = 0;     // Unknown kind, skipped; the buffer holds nothing to send
+                continue;
+            }
+            if (f) {
+                f.close();
+            }
+            kind = header.kind == SPOOL_RECORD_BINARY_BODY ? UPLINK_SENSOR_DATA_BIN : UPLINK_SENSOR_DATA;
+            length = record_length(header);
+            return 1;
+        }
+
+        // Frames from nodes without sequence numbers are kept in their V1 layout
+        bool sequenced = header.length == sizeof(SensorDataMessage);
+        if ((!sequenced && header.length != sizeof(SensorDataMessageV1)) || frame[0] != MSG_TYPE_SENSOR_DATA) {
+            spool_stats.errors++;
+            read_cursor.offset += record_size;
+            continue;
+        }
+        SensorDataMessage msg = sequenced
+            ? *protocol_view<SensorDataMessage>(frame)
+            : sensor_data_from_v1(*protocol_view<SensorDataMessageV1>(frame));
+
+        // Leave room for the separator and the closing ']' + NUL
+        size_t written = write_sensor_json(
+            replay_buffer + length + 1,
+            sizeof(replay_buffer) - length - 3,
+            &msg,
+            header.rssi,
+            header.snr,
+            record_epoch_ms(header),
+            sequenced
+        );
+        if (written == 0) {
+            break;  // Batch full, this frame goes in the next one
+        }
+
+        replay_buffer[length] = (count == 0) ? '[' : ',';
+        length += 1 + written;
+        read_cursor.offset += record_size;
+        count++;
+    }
+
+    if (f) {
+        f.close();
+    }
+    replay_buffer[length++] = ']';
+    replay_buffer[length] = '\0';
+    return count;
+}
+
+void spool_drain() {
+    if (!spool_ready) {
+        return;
+    }
+    if (replay_in_flight) {
+        if (replay_result != 0) {
+            apply_replay_result();
+        }
+        return;
+    }
+    if (same_position(read_cursor, head)) {
+        return;
+    }
+
+    // Replay only over an idle uplink, at a bounded rate, so live traffic goes first
+    if (!wifi_connected || uplink_pending() > 0) {
+        return;
+    }
+    if (millis() - last_drain_time < SPOOL_DRAIN_INTERVAL_MS) {
+        return;
+    }
+    last_drain_time = millis();
+
+    size_t length = 0;
+    SpoolCursor start = read_cursor;
+    uint16_t count = build_replay_batch(length, replay_kind);
+
+    if (count == 0) {
+        // Only unusable records were skipped; nothing to deliver for them
+        if (!same_position(start, read_cursor)) {
+            commit_tail(read_cursor);
+        }
+        return;
+    }
+
+    replay_end = read_cursor;
+    replay_count = count;
+    replay_result = 0;
+    replay_in_flight = true;
+    if (!uplink_enqueue(replay_kind, replay_buffer, length, on_replay_complete)) {
+        replay_in_flight = false;
+        read_cursor = start;
+        return;
+    }
+    LOG_DEBUG("Spool replay - %u records (%u bytes) queued\n", count, length);
+}
+#endif
@@ -0,0 +1,159 @@
+#include "trace.h"
+
+#ifdef TRACE_ON
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Log-linear histogram: values below 8 cycles exact, then 4 buckets per power of two
+// (at most 12.5% error on a percentile)
+#define TRACE_EXACT_BUCKETS     8
+#define TRACE_SUB_BUCKETS       4
+#define TRACE_BUCKETS           (TRACE_EXACT_BUCKETS + (32 - 3) * TRACE_SUB_BUCKETS)
+
+struct StageHistogram {
+    uint32_t count;
+    uint32_t max_cycles;
+    uint32_t buckets[TRACE_BUCKETS];
+};
+
+struct TraceSlot {
+    volatile uint32_t seq;      // Ring position + 1 once the event is complete
+    struct trace_event_t event;
+};
+
+static StageHistogram histograms[TRACE_STAGE_COUNT];
+static TraceSlot ring[TRACE_RING_SIZE];
+static uint32_t ring_next = 0;
+
+static volatile int64_t irq_time_us = 0;   // Set by the DIO1 ISR, cleared by the RX task
+
+static uint16_t bucket_of(uint32_t cycles) {
+    if (cycles < TRACE_EXACT_BUCKETS) {
+        return cycles;
+    }
+    uint8_t exponent = 31 - __builtin_clz(cycles);
+    uint8_t sub = (cycles >> (exponent - 2)) & (TRACE_SUB_BUCKETS - 1);
+    return TRACE_EXACT_BUCKETS + (exponent - 3) * TRACE_SUB_BUCKETS + sub;
+}
+
+// Midpoint of the bucket, in cycles
+static float bucket_value(uint16_t bucket) {
+    if (bucket < TRACE_EXACT_BUCKETS) {
+        return bucket;
+    }
+    uint8_t exponent = 3 + (bucket - TRACE_EXACT_BUCKETS) / TRACE_SUB_BUCKETS;
+    uint8_t sub = (bucket - TRACE_EXACT_BUCKETS) % TRACE_SUB_BUCKETS;
+    float width = static_cast<float>(1UL << (exponent - 2));
+    return (TRACE_SUB_BUCKETS + sub) * width + width / 2.0f;
+}
+
+static void record_cycles(TraceStage stage, uint32_t cycles) {
+    StageHistogram& histogram = histograms[stage];
+    histogram.count++;
+    histogram.buckets[bucket_of(cycles)]++;
+    if (cycles > histogram.max_cycles) {
+        histogram.max_cycles = cycles;
+    }
+
+    uint32_t position = __atomic_fetch_add(&ring_next, 1, __ATOMIC_RELAXED);
+    TraceSlot& slot = ring[position % TRACE_RING_SIZE];
+    slot.seq = 0;
+    slot.event.stage = stage;
+    slot.event.core = static_cast<uint8_t>(xPortGetCoreID());
+    slot.event.cycles = cycles;
+    slot.event.time_ms = millis();
+    __atomic_store_n(&slot.seq, position + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t trace_cycles() {
+    return esp_cpu_get_cycle_count();
+}
+
+void trace_record(TraceStage stage, uint32_t start_cycles) {
+    record_cycles(stage, esp_cpu_get_cycle_count() - start_cycles);
+}
+
+void IRAM_ATTR trace_irq() {
+    irq_time_us = esp_timer_get_time();
+}
+
+void trace_irq_serviced() {
+    int64_t raised = irq_time_us;
+    if (raised == 0) {
+        return;     // Serviced on the poll timeout, not woken by an interrupt
+    }
+    irq_time_us = 0;
+    record_cycles(TRACE_RX_IRQ, static_cast<uint32_t>((esp_timer_get_time() - raised) * trace_cpu_mhz()));
+}
+
+const char* trace_stage_name(TraceStage stage) {
+    switch (stage) {
+    case TRACE_RX_IRQ:      return "rx_irq";
+    case TRACE_READ_DATA:   return "read_data";
+    case TRACE_CHECKSUM:    return "checksum";
+    case TRACE_DEDUP:       return "dedup";
+    case TRACE_JSON:        return "json";
+    case TRACE_ENQUEUE:     return "enqueue";
+    case TRACE_POST:        return "post";
+    default:                return "unknown";
+    }
+}
+
+// Cycle to time conversion; with dynamic frequency scaling this is the current frequency
+uint32_t trace_cpu_mhz() {
+    return getCpuFrequencyMhz();
+}
+
+void trace_summary(TraceStage stage, struct trace_summary_t& out) {
+    const StageHistogram& histogram = histograms[stage];
+    float mhz = static_cast<float>(trace_cpu_mhz());
+    uint32_t count = histogram.count;
+    out.count = count;
+    out.p50_us = 0.0f;
+    out.p99_us = 0.0f;
+    out.max_us = histogram.max_cycles / mhz;
+    if (count == 0) {
+        return;
+    }
+
+    // Ranks of the percentiles, 1-based; buckets may move on while this runs, which only
+    // shifts the estimate by the samples recorded meanwhile
+    uint32_t p50_rank = (count + 1) / 2;
+    uint32_t p99_rank = count - count / 100;
+    uint32_t seen = 0;
+    bool p50_done = false;
+    for (uint16_t b = 0; b < TRACE_BUCKETS; b++) {
+        seen += histogram.buckets[b];
+        if (!p50_done && seen >= p50_rank) {
+            out.p50_us = bucket_value(b) / mhz;
+            p50_done = true;
+        }
+        if (seen >= p99_rank) {
+            out.p99_us = bucket_value(b) / mhz;
+            break;
+        }
+    }
+    if (out.p99_us > out.max_us) out.p99_us = out.max_us;
+    if (out.p50_us > out.max_us) out.p50_us = out.max_us;
+}
+
+// Newest events first; slots being rewritten are skipped
+uint16_t trace_recent(struct trace_event_t* out, uint16_t max_events) {
+    uint32_t newest = __atomic_load_n(&ring_next, __ATOMIC_ACQUIRE);
+    uint16_t copied = 0;
+    for (uint32_t i = 0; i < TRACE_RING_SIZE && i < newest && copied < max_events; i++) {
+        uint32_t position = newest - 1 - i;
+        const TraceSlot& slot = ring[position % TRACE_RING_SIZE];
+        if (__atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) != position + 1) {
+            continue;
+        }
+        out[copied] = slot.event;
+        if (slot.seq == position + 1) {
+            copied++;
+        }
+    }
+    return copied;
+}
+#endif
@@ -0,0 +1,234 @@
+#include "uplink.h"
+#include "constants.h"
+#include "logger.h"
+#include "wifi.h"
+#include "config_store.h"
+#include "energy_manager.h"
+#include "power.h"
+#include "trace.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+struct UplinkSlot {
+    UplinkKind kind;
+    uplink_callback_t callback;
+    bool reclaim;
+    size_t length;
+    char body[UPLINK_MAX_BODY_SIZE];
+};
+
+struct uplink_stats_t uplink_stats = {0, 0, 0, 0, 0, 0};
+static portMUX_TYPE uplink_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Fixed pool of request bodies; the queues only carry slot indexes
+static UplinkSlot slots[UPLINK_QUEUE_DEPTH];
+static QueueHandle_t free_slots = nullptr;
+static QueueHandle_t pending_slots = nullptr;
+static QueueHandle_t failed_slots = nullptr;       // Undelivered reclaimable bodies, for loop()
+static TaskHandle_t uplink_task_handle = nullptr;
+static char response_body[UPLINK_RESPONSE_MAX_SIZE];   // Valid during the completion callback
+
+static void count_dropped() {
+    portENTER_CRITICAL(&uplink_stats_mux);
+    uplink_stats.dropped++;
+    portEXIT_CRITICAL(&uplink_stats_mux);
+}
+
+void uplink_stats_snapshot(struct uplink_stats_t& out) {
+    portENTER_CRITICAL(&uplink_stats_mux);
+    out = uplink_stats;
+    portEXIT_CRITICAL(&uplink_stats_mux);
+}
+
+static const char* endpoint_for(UplinkKind kind) {
+    switch (kind) {
+    case UPLINK_GATEWAY_STATS:
+        return SERVER_ENDPOINT_STATS;
+    case UPLINK_SENSOR_DATA_BIN:
+        return SERVER_ENDPOINT_DATA_BIN;
+    case UPLINK_ALERT:
+        return SERVER_ENDPOINT_ALERTS;
+    case UPLINK_SENSOR_DATA:
+    default:
+        return SERVER_ENDPOINT_DATA;
+    }
+}
+
+static const char* content_type_for(UplinkKind kind) {
+    return kind == UPLINK_SENSOR_DATA_BIN ? "application/octet-stream" : "application/json";
+}
+
+static void uplink_task(void* arg) {
+    // Client and socket live for the whole task so keep-alive connections are reused
+    WiFiClient client;
+    HTTPClient http;
+    http.setReuse(true);
+
+    for (;;) {
+        uint8_t index;
+        if (xQueueReceive(pending_slots, &index, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        UplinkSlot& slot = slots[index];
+        struct uplink_result_t result = {slot.kind, HTTPC_ERROR_NOT_CONNECTED, 0, slot.length, response_body, 0};
+
+        if (wifi_connected) {
+            bool reused = client.connected();
+            portENTER_CRITICAL(&uplink_stats_mux);
+            if (reused) {
+                uplink_stats.reused++;
+            } else {
+                uplink_stats.connections++;
+            }
+            portEXIT_CRITICAL(&uplink_stats_mux);
+
+            power_modem_sleep(false);
+            uint32_t start_time = millis();
+            EnergyState previous = energy_enter(ENERGY_STATE_WIFI_TX);
+
+            http.begin(client, gateway_config.server_host, gateway_config.server_port, endpoint_for(slot.kind));
+            http.addHeader("Content-Type", content_type_for(slot.kind));
+            http.setTimeout(UPLINK_HTTP_TIMEOUT_MS);
+            TRACE_BEGIN(post_start);
+            result.http_code = http.POST(reinterpret_cast<uint8_t*>(slot.body), slot.length);
+
+            // Only the stats endpoint answers with a body the gateway uses (settings)
+            int response_size = http.getSize();
+            if (slot.kind == UPLINK_GATEWAY_STATS && result.http_code == HTTP_CODE_OK &&
+                response_size > 0 && static_cast<size_t>(response_size) < sizeof(response_body)) {
+                result.response_length = http.getStreamPtr()->readBytes(response_body, response_size);
+            }
+            http.end();
+            TRACE_END(TRACE_POST, post_start);
+            energy_leave(ENERGY_STATE_WIFI_TX, previous);
+
+            result.latency_ms = millis() - start_time;
+            if (uplink_pending() == 0) {
+                power_modem_sleep(true);
+            }
+        }
+
+        if (slot.callback != nullptr) {
+            slot.callback(result);
+        }
+
+        // Only a 200/201 counts as delivered: timeouts, lost WiFi and server errors are not
+        bool delivered = result.http_code == HTTP_CODE_OK || result.http_code == HTTP_CODE_CREATED;
+        if (slot.reclaim && !delivered) {
+            portENTER_CRITICAL(&uplink_stats_mux);
+            uplink_stats.undelivered++;
+            portEXIT_CRITICAL(&uplink_stats_mux);
+            xQueueSend(failed_slots, &index, 0);
+        } else {
+            xQueueSend(free_slots, &index, 0);
+        }
+        power_wake();   // Results (spool replay, remote settings) are applied by loop()
+    }
+}
+
+void init_uplink() {
+    if (uplink_task_handle != nullptr) {
+        return;
+    }
+
+    free_slots = xQueueCreate(UPLINK_QUEUE_DEPTH, sizeof(uint8_t));
+    pending_slots = xQueueCreate(UPLINK_QUEUE_DEPTH, sizeof(uint8_t));
+    failed_slots = xQueueCreate(UPLINK_QUEUE_DEPTH, sizeof(uint8_t));
+    for (uint8_t i = 0; i < UPLINK_QUEUE_DEPTH; i++) {
+        xQueueSend(free_slots, &i, 0);
+    }
+
+    xTaskCreatePinnedToCore(
+        uplink_task,
+        "uplink",
+        UPLINK_TASK_STACK_SIZE,
+        nullptr,
+        UPLINK_TASK_PRIORITY,
+        &uplink_task_handle,
+        UPLINK_TASK_CORE
+    );
+    LOG_INFO("Uplink sender task started (queue depth %d)\n", UPLINK_QUEUE_DEPTH);
+}
+
+bool uplink_enqueue(
+    UplinkKind kind,
+    const char* body,
+    size_t length,
+    uplink_callback_t callback,
+    bool reclaim
+) {
+    TRACE_BEGIN(start);
+    if (length > UPLINK_MAX_BODY_SIZE) {
+        portENTER_CRITICAL(&uplink_stats_mux);
+        uplink_stats.oversized++;
+        uplink_stats.dropped++;
+        portEXIT_CRITICAL(&uplink_stats_mux);
+        return false;
+    }
+    if (free_slots == nullptr) {
+        count_dropped();
+        return false;
+    }
+
+    if (!uplink_has_room(kind)) {
+        count_dropped();
+        return false;
+    }
+
+    // Never blocks: a full queue means the uplink is behind and the caller decides
+    uint8_t index;
+    if (xQueueReceive(free_slots, &index, 0) != pdTRUE) {
+        count_dropped();
+        return false;
+    }
+
+    UplinkSlot& slot = slots[index];
+    slot.kind = kind;
+    slot.callback = callback;
+    slot.reclaim = reclaim;
+    slot.length = length;
+    memcpy(slot.body, body, length);
+
+    if (kind == UPLINK_ALERT) {
+        xQueueSendToFront(pending_slots, &index, 0);
+    } else {
+        xQueueSend(pending_slots, &index, 0);
+    }
+    portENTER_CRITICAL(&uplink_stats_mux);
+    uplink_stats.enqueued++;
+    portEXIT_CRITICAL(&uplink_stats_mux);
+    TRACE_END(TRACE_ENQUEUE, start);
+    return true;
+}
+
+uint16_t uplink_pending() {
+    if (pending_slots == nullptr) {
+        return 0;
+    }
+    return uxQueueMessagesWaiting(pending_slots);
+}
+
+// The last free slots are kept for alerts, so bulk traffic cannot starve them
+bool uplink_has_room(UplinkKind kind) {
+    if (free_slots == nullptr) {
+        return false;
+    }
+    UBaseType_t reserved = kind == UPLINK_ALERT ? 0 : UPLINK_ALERT_RESERVED_SLOTS;
+    return uxQueueMessagesWaiting(free_slots) > reserved;
+}
+
+// Runs in loop(): the slot stays out of the pool until its body has been handed over
+void uplink_reclaim(uplink_reclaim_t store) {
+    uint8_t index;
+    while (failed_slots != nullptr && xQueueReceive(failed_slots, &index, 0) == pdTRUE) {
+        UplinkSlot& slot = slots[index];
+        if (store != nullptr) {
+            store(slot.kind, slot.body, slot.length);
+        }
+        xQueueSend(free_slots, &index, 0);
+    }
+}
@@ -1,10 +1,20 @@
 #include "wifi.h"
 #include "constants.h"
-#include "utils.h"
+#include "logger.h"
 #include "processing.h"
 #include "message_struct.h"
 #include "lora.h"
 #include "energy_manager.h"
+#include "uplink.h"
+#include "spool.h"
+#include "batch.h"
+#include "config_store.h"
+#include "node_table.h"
+#include "adr.h"
+#include "power.h"
+#include "alerts.h"
+#include "loadgen.h"
+#include "trace.h"
 #include <ArduinoJson.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
@@ -16,129 +26,316 @@ bool time_synced = false;
 
 struct server_stats_t server_stats = {0, 0, 0};
 
-struct latency_t latency = {0, 0, UINT32_MAX, 0, 0};
+struct latency_t latency = {0, 0, UINT32_MAX, 0, 0, 0};
+static portMUX_TYPE server_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+struct wifi_stats_t wifi_stats = {0, 0, 0, 0};
+
+static uint16_t node_report_cursor = 0;    // Next node table slot to report in the stats
 
 
-void init_wifi() {
 #ifdef WIFI_ON
-    print_log("Connecting to WiFi SSID: %s\n", WIFI_SSID);
+typedef enum {
+    WIFI_STATE_CONNECTING,      // WiFi.begin() issued, waiting for an IP
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_BACKOFF,         // Waiting before the next attempt
+} WifiState;
+
+static WifiState wifi_state = WIFI_STATE_BACKOFF;
+static uint32_t wifi_state_since = 0;
+static uint32_t wifi_backoff_ms = WIFI_BACKOFF_MIN_MS;
+static uint32_t wifi_next_attempt = 0;
+static uint32_t wifi_outage_start = 0;
+static bool ntp_configured = false;
+
+// Set from the WiFi event task, consumed by check_wifi_connection()
+static volatile bool event_got_ip = false;
+static volatile bool event_disconnected = false;
+
+static void on_wifi_event(WiFiEvent_t event, WiFiEventInfo_t info) {
+    switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        event_got_ip = true;
+        break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+        event_disconnected = true;
+        break;
+    default:
+        break;
+    }
+    power_wake();
+}
 
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+static void start_connect() {
+    event_got_ip = false;
+    event_disconnected = false;
+    wifi_stats.connect_attempts++;
+
+    LOG_INFO("Connecting to WiFi SSID: %s (attempt %u)\n", gateway_config.wifi_ssid, wifi_stats.connect_attempts);
+    WiFi.begin(gateway_config.wifi_ssid, gateway_config.wifi_password);
+    energy_enter(ENERGY_STATE_WIFI_CONNECT);
 
-    uint32_t start = millis();
-    while (WiFi.status() != WL_CONNECTED && (millis() - start) < WIFI_TIMEOUT_MS) {
-        delay(500);
-        print_log(".");
+    wifi_state = WIFI_STATE_CONNECTING;
+    wifi_state_since = millis();
+}
+
+static void schedule_backoff() {
+    WiFi.disconnect();
+    energy_enter(ENERGY_STATE_WIFI_OFF);
+
+    // Exponential backoff with jitter so several gateways do not retry in lockstep
+    uint32_t jitter = random(0, wifi_backoff_ms / 4 + 1);
+    wifi_next_attempt = millis() + wifi_backoff_ms + jitter;
+    LOG_INFO("WiFi retry in %u ms\n", wifi_backoff_ms + jitter);
+
+    wifi_backoff_ms = wifi_backoff_ms * 2;
+    if (wifi_backoff_ms > WIFI_BACKOFF_MAX_MS) {
+        wifi_backoff_ms = WIFI_BACKOFF_MAX_MS;
     }
-    print_log("\n");
 
-    if (WiFi.status() == WL_CONNECTED) {
-        wifi_connected = true;
-        print_log("WiFi connected - IP: %s\n", WiFi.localIP().toString().c_str());
+    wifi_state = WIFI_STATE_BACKOFF;
+    wifi_state_since = millis();
+}
+
+static void on_connected() {
+    uint32_t now = millis();
+    wifi_connected = true;
+    wifi_stats.downtime_ms += now - wifi_outage_start;
+    if (wifi_stats.connect_attempts > 1) {
+        wifi_stats.reconnects++;
+    }
+    wifi_backoff_ms = WIFI_BACKOFF_MIN_MS;
+    wifi_state = WIFI_STATE_CONNECTED;
+    wifi_state_since = now;
+    energy_enter(ENERGY_STATE_WIFI_IDLE);
+    power_modem_sleep(true);
 
+    LOG_INFO("WiFi connected - IP: %s\n", WiFi.localIP().toString().c_str());
+
+    // SNTP runs in the background; time_synced is set once the clock is valid
+    if (!ntp_configured) {
         configTime(-3 * 3600, 0, "pool.ntp.org");  // UTC-3 (Brazil)
-        int retry = 0;
-        while (time(nullptr) < 100000 && retry < 10) {
-            delay(500);
-            retry++;
-        }
-        time_synced = (time(nullptr) > 100000);
-        print_log("Time sync: %s\n", time_synced ? "OK" : "FAILED");
-    } else {
-        wifi_connected = false;
-        print_log("WiFi connection FAILED (status: %d)\n", WiFi.status());
+        ntp_configured = true;
     }
-    
-    print_log("wifi_connected = %s\n", wifi_connected ? "true" : "false");
+}
+
+static void on_disconnected() {
+    wifi_connected = false;
+    wifi_stats.disconnects++;
+    wifi_outage_start = millis();
+    LOG_INFO("WiFi disconnected, reconnecting in background\n");
+}
+#endif
+
+void init_wifi() {
+#ifdef WIFI_ON
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);  // Reconnects are driven by check_wifi_connection()
+    WiFi.onEvent(on_wifi_event);
+
+    wifi_outage_start = millis();
+    start_connect();
 #else
-    print_log("WiFi is disabled (WIFI_ON not defined)\n");
+    LOG_WARN("WiFi is disabled (WIFI_ON not defined)\n");
 #endif
 }
 
-void forward_to_server(const char* json_data) {
+// Non-blocking WiFi state machine, called from loop()
+void check_wifi_connection() {
 #ifdef WIFI_ON
-    if (!wifi_connected) {
-        print_log("forward_to_server: WiFi not connected, skipping\n");
-        return;
+    uint32_t now = millis();
+
+    switch (wifi_state) {
+    case WIFI_STATE_CONNECTING:
+        if (event_got_ip) {
+            event_got_ip = false;
+            on_connected();
+        } else if (event_disconnected || now - wifi_state_since >= WIFI_TIMEOUT_MS) {
+            LOG_ERROR("WiFi connection FAILED (status: %d)\n", WiFi.status());
+            schedule_backoff();
+        }
+        break;
+
+    case WIFI_STATE_CONNECTED:
+        if (event_disconnected) {
+            on_disconnected();
+            schedule_backoff();
+        }
+        break;
+
+    case WIFI_STATE_BACKOFF:
+        if (static_cast<int32_t>(now - wifi_next_attempt) >= 0) {
+            start_connect();
+        }
+        break;
     }
 
-    HTTPClient http;
-    String url = String("http://") + SERVER_HOST + ":" + SERVER_PORT + SERVER_ENDPOINT_DATA;
-    
-    print_log("Sending to: %s\n", url.c_str());
+    if (!time_synced && wifi_connected && time(nullptr) > 100000) {
+        time_synced = true;
+        LOG_INFO("Time sync: OK\n");
+    }
+#endif
+}
 
-    uint32_t start_time = millis();
+uint32_t get_wifi_downtime_ms() {
+#ifdef WIFI_ON
+    return wifi_stats.downtime_ms + (wifi_connected ? 0 : millis() - wifi_outage_start);
+#else
+    return 0;
+#endif
+}
 
-    http.begin(url);
-    http.addHeader("Content-Type", "application/json");
-    http.setTimeout(5000);  // Timeout de 5 segundos
-    int http_code = http.POST(json_data);
+// Runs on the uplink sender task once a sensor data POST completes
+static void on_data_uplink_complete(const struct uplink_result_t& result) {
+    bool delivered = result.http_code == HTTP_CODE_OK || result.http_code == HTTP_CODE_CREATED;
 
-    latency.last_ms = millis() - start_time;
+    portENTER_CRITICAL(&server_stats_mux);
+    latency.last_ms = result.latency_ms;
     server_stats.total++;
-
-    if (http_code > 0) {
+    if (result.http_code > 0) {
         latency.total_ms += latency.last_ms;
         latency.samples++;
         if (latency.last_ms < latency.min_ms) latency.min_ms = latency.last_ms;
         if (latency.last_ms > latency.max_ms) latency.max_ms = latency.last_ms;
-
-        if (http_code == HTTP_CODE_OK || http_code == HTTP_CODE_CREATED) {
-            server_stats.success++;
-            print_log("Forward to server success: %u ms (code: %d)\n", latency.last_ms, http_code);
-        } else {
-            server_stats.failed++;
-            print_log("Server response error code: %d\n", http_code);
-        }
+        latency.ewma_ms = latency.samples == 1
+            ? latency.last_ms : (latency.ewma_ms * 7 + latency.last_ms) / 8;
+    }
+    if (delivered) {
+        server_stats.success++;
     } else {
         server_stats.failed++;
-        print_log("HTTP request failed: %s (code: %d)\n", http.errorToString(http_code).c_str(), http_code);
+    }
+    portEXIT_CRITICAL(&server_stats_mux);
+
+    if (delivered) {
+        LOG_DEBUG("Forward to server success: %u ms (code: %d)\n", result.latency_ms, result.http_code);
+    } else if (result.http_code > 0) {
+        LOG_WARN("Server response error code: %d\n", result.http_code);
+    } else {
+        LOG_ERROR("HTTP request failed: %s (code: %d)\n", HTTPClient::errorToString(result.http_code).c_str(), result.http_code);
+    }
+}
+
+// The stats response may carry settings for the gateway and its nodes
+static void on_stats_uplink_complete(const struct uplink_result_t& result) {
+    LOG_DEBUG("[STATS] Sent to server - Response code: %d\n", result.http_code);
+    if (result.http_code == HTTP_CODE_OK && result.response_length > 0) {
+        config_queue_update(result.response, result.response_length);
+    }
+}
+
+bool forward_to_server(const char* json_data, size_t length) {
+    return forward_to_server(UPLINK_SENSOR_DATA, json_data, length);
+}
+
+// Sensor data only. false: not queued, the caller keeps the data (spool). Once queued, a body
+// the server does not confirm comes back through uplink_reclaim() instead of being lost.
+bool forward_to_server(UplinkKind kind, const char* data, size_t length) {
+#ifdef WIFI_ON
+    if (!wifi_connected) {
+        LOG_WARN("forward_to_server: WiFi not connected, skipping\n");
+        return false;
     }
 
-    http.end();
+    if (!uplink_enqueue(kind, data, length, on_data_uplink_complete, true)) {
+        portENTER_CRITICAL(&server_stats_mux);
+        server_stats.total++;
+        server_stats.failed++;
+        portEXIT_CRITICAL(&server_stats_mux);
+        LOG_WARN("forward_to_server: uplink queue full, %u bytes not queued\n", length);
+        return false;
+    }
+    return true;
 #else
-    print_log("forward_to_server: WIFI_ON not defined\n");
+    LOG_WARN("forward_to_server: WIFI_ON not defined\n");
+    return false;
 #endif
 }
 
+void server_stats_snapshot(struct server_stats_t& server, struct latency_t& rtt) {
+    portENTER_CRITICAL(&server_stats_mux);
+    server = server_stats;
+    rtt = latency;
+    portEXIT_CRITICAL(&server_stats_mux);
+}
+
 void send_gateway_statistics() {
 #ifdef WIFI_ON
     if (!wifi_connected) return;
 
-    HTTPClient http;
-    String url = String("http://") + SERVER_HOST + ":" + SERVER_PORT + SERVER_ENDPOINT_STATS;
     String stats_json = build_gateway_stats_json();
-
-    http.begin(url);
-    http.addHeader("Content-Type", "application/json");
-    int http_code = http.POST(stats_json);
-
-    print_log("[STATS] Sent to server - Response code: %d\n", http_code);
-    http.end();
+    if (stats_json.length() > UPLINK_MAX_BODY_SIZE) {
+        LOG_ERROR("[STATS] Statistics body too large (%u bytes), not sent\n", stats_json.length());
+    } else if (!uplink_enqueue(UPLINK_GATEWAY_STATS, stats_json.c_str(), stats_json.length(), on_stats_uplink_complete)) {
+        LOG_WARN("[STATS] Uplink queue full, statistics not sent\n");
+    }
 #endif
 }
 
-String get_iso8601_timestamp() {
-    if (time_synced) {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-
+// "2024-05-01T12:34:" is only rebuilt when the minute changes; every reading in between
+// appends seconds and millis as digits, without localtime_r/strftime/snprintf.
+// Loop task only: the cached prefix is not guarded.
+size_t format_epoch_timestamp(char* out, size_t size, uint64_t epoch_ms) {
+    static uint64_t cached_minute = UINT64_MAX;
+    static char cached_prefix[24];
+    static size_t cached_length = 0;
+
+    uint64_t minute = epoch_ms / 60000ULL;
+    if (minute != cached_minute) {
+        time_t seconds = static_cast<time_t>(minute * 60);
         struct tm timeinfo;
-        localtime_r(&tv.tv_sec, &timeinfo);
+        localtime_r(&seconds, &timeinfo);
+        cached_length = strftime(cached_prefix, sizeof(cached_prefix), "%Y-%m-%dT%H:%M:", &timeinfo);
+        cached_minute = minute;
+    }
 
-        char buffer[30];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &timeinfo);
+    const size_t suffix_length = sizeof("ss.mmmZ") - 1;
+    if (cached_length == 0 || cached_length + suffix_length >= size) {
+        return 0;
+    }
+    uint32_t ms = static_cast<uint32_t>(epoch_ms % 60000ULL);
+    char* p = out;
+    memcpy(p, cached_prefix, cached_length);
+    p += cached_length;
+    *p++ = '0' + ms / 10000;
+    *p++ = '0' + ms / 1000 % 10;
+    *p++ = '.';
+    *p++ = '0' + ms / 100 % 10;
+    *p++ = '0' + ms / 10 % 10;
+    *p++ = '0' + ms % 10;
+    *p++ = 'Z';
+    *p = '\0';
+    return p - out;
+}
 
-        char timestamp[40];
-        snprintf(timestamp, sizeof(timestamp), "%s.%03ldZ", buffer, tv.tv_usec / 1000);
+size_t format_iso8601_timestamp(char* out, size_t size) {
+    if (time_synced) {
+        return format_epoch_timestamp(out, size, get_epoch_ms());
+    }
+    int written = snprintf(out, size, "boot+%lu", millis());
+    return (written > 0 && static_cast<size_t>(written) < size) ? written : 0;
+}
 
-        return String(timestamp);
-    } else {
-        char buffer[30];
-        snprintf(buffer, sizeof(buffer), "boot+%lu", millis());
-        return String(buffer);
+uint64_t get_epoch_ms() {
+    if (!time_synced) {
+        return 0;
     }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000ULL + tv.tv_usec / 1000;
+}
+
+// Epoch of a reading sampled age_ms ago, 0 if time was not synced
+uint64_t get_sample_epoch_ms(uint32_t age_ms) {
+    uint64_t now_epoch = get_epoch_ms();
+    return now_epoch != 0 ? now_epoch - age_ms : 0;
+}
+
+String get_iso8601_timestamp() {
+    char timestamp[40];
+    format_iso8601_timestamp(timestamp, sizeof(timestamp));
+    return String(timestamp);
 }
 
 String build_gateway_stats_json() {
@@ -158,49 +355,240 @@ String build_gateway_stats_json() {
     lora["rx_valid"] = lora_stats.total_rx_valids;
     lora["rx_invalid"] = lora_stats.total_rx_invalids;
     lora["rx_checksum_error"] = lora_stats.total_checksum_errors;
-    lora["packet_loss_percent"] = lora_stats.total_rx_packets > 0
+    lora["rx_legacy_trailer"] = lora_stats.total_rx_legacy;
+    lora["invalid_percent"] = lora_stats.total_rx_packets > 0
         ? (static_cast<float>(lora_stats.total_rx_invalids) / lora_stats.total_rx_packets * 100.0f) : 0.0f;
+    // True loss: frames the nodes sent (per sequence numbers) that never arrived
+    lora["packet_loss_percent"] = node_loss_percent(node_table_stats.accepted, node_table_stats.lost);
+    lora["lost"] = node_table_stats.lost;
+    lora["reordered"] = node_table_stats.reordered;
+    lora["tx_downlinks"] = lora_stats.total_tx_downlinks;
+    lora["tx_downlink_errors"] = lora_stats.total_tx_downlink_errors;
+#ifdef ADR_ON
+    lora["adr_commands"] = adr_stats.commands;
+    lora["adr_power_down"] = adr_stats.power_down;
+    lora["adr_power_up"] = adr_stats.power_up;
+    lora["adr_resends"] = adr_stats.resends;
+#endif
 
     // Server statistics
+    struct server_stats_t server_totals;
+    struct latency_t rtt;
+    server_stats_snapshot(server_totals, rtt);
     JsonObject server = doc["server_stats"].to<JsonObject>();
-    server["tx_total"] = server_stats.total;
-    server["tx_success"] = server_stats.success;
-    server["tx_failed"] = server_stats.failed;
-    server["success_rate_percent"] = server_stats.total > 0
-        ? (static_cast<float>(server_stats.success) / server_stats.total * 100.0f) : 0.0f;
+    server["tx_total"] = server_totals.total;
+    server["tx_success"] = server_totals.success;
+    server["tx_failed"] = server_totals.failed;
+    server["success_rate_percent"] = server_totals.total > 0
+        ? (static_cast<float>(server_totals.success) / server_totals.total * 100.0f) : 0.0f;
 
     // latency_json statistics
     JsonObject latency_json = doc["latency_json"].to<JsonObject>();
-    latency_json["avms"] = latency.samples > 0
-        ? (static_cast<float>(latency.total_ms) / latency.samples) : 0.0f;
-    latency_json["min_ms"] = latency.min_ms == UINT32_MAX ? 0 : latency.min_ms;
-    latency_json["max_ms"] = latency.max_ms;
-    latency_json["last_ms"] = latency.last_ms;
-    latency_json["samples"] = latency.samples;
+    latency_json["avms"] = rtt.samples > 0
+        ? (static_cast<float>(rtt.total_ms) / rtt.samples) : 0.0f;
+    latency_json["min_ms"] = rtt.min_ms == UINT32_MAX ? 0 : rtt.min_ms;
+    latency_json["max_ms"] = rtt.max_ms;
+    latency_json["last_ms"] = rtt.last_ms;
+    latency_json["samples"] = rtt.samples;
+    latency_json["ewma_ms"] = rtt.ewma_ms;
+
+    // Uplink queue statistics
+    struct uplink_stats_t queue_stats;
+    uplink_stats_snapshot(queue_stats);
+    JsonObject uplink = doc["uplink_stats"].to<JsonObject>();
+    uplink["enqueued"] = queue_stats.enqueued;
+    uplink["dropped"] = queue_stats.dropped;
+    uplink["pending"] = uplink_pending();
+    uplink["connections"] = queue_stats.connections;
+    uplink["reused"] = queue_stats.reused;
+    uplink["oversized"] = queue_stats.oversized;
+    uplink["undelivered"] = queue_stats.undelivered;
+
+    // Per-node state; large tables are reported in chunks across uploads
+    JsonObject table = doc["node_table"].to<JsonObject>();
+    table["tracked"] = node_table_stats.tracked;
+    table["inserts"] = node_table_stats.inserts;
+    table["evictions"] = node_table_stats.evictions;
+    JsonArray nodes = doc["nodes"].to<JsonArray>();    // Filled last, see below
+
+#ifdef BATCH_ON
+    // Adaptive batching thresholds currently in effect
+    JsonObject batch = doc["batch_policy"].to<JsonObject>();
+    batch["target_size"] = batch_policy.target_size;
+    batch["timeout_ms"] = batch_policy.timeout_ms;
+    batch["pending"] = batch_count;
+#endif
+
+    // Runtime settings in effect (network credentials are not reported)
+    JsonObject config = doc["config"].to<JsonObject>();
+    config["stats_period_ms"] = gateway_config.stats_period_ms;
+    config["batch_latency_budget_ms"] = gateway_config.batch_latency_budget_ms;
+    config["batch_max_size"] = gateway_config.batch_max_size;
+    config["adr_margin_db"] = gateway_config.adr_margin_db;
+    config["updates"] = config_stats.updates;
+    config["rejected"] = config_stats.rejected;
+    config["node_updates"] = config_stats.node_updates;
+
+#ifdef ALERTS_ON
+    // Alert lane
+    JsonObject alerts = doc["alert_stats"].to<JsonObject>();
+    alerts["raised"] = alert_stats.raised;
+    alerts["from_nodes"] = alert_stats.from_nodes;
+    alerts["delivered"] = alert_stats.delivered;
+    alerts["retries"] = alert_stats.retries;
+    alerts["dropped"] = alert_stats.dropped;
+    alerts["pending"] = alert_pending();
+    alerts["last_latency_ms"] = alert_stats.last_latency_ms;
+    alerts["max_latency_ms"] = alert_stats.max_latency_ms;
+#endif
+
+#ifdef TRACE_ON
+    // Hot-path stage timing: percentiles per stage and the newest events
+    JsonObject trace = doc["trace"].to<JsonObject>();
+    trace["cpu_mhz"] = trace_cpu_mhz();
+    JsonObject trace_stages = trace["stages"].to<JsonObject>();
+    for (uint8_t s = 0; s < TRACE_STAGE_COUNT; s++) {
+        struct trace_summary_t summary;
+        trace_summary(static_cast<TraceStage>(s), summary);
+        if (summary.count == 0) {
+            continue;
+        }
+        JsonObject stage = trace_stages[trace_stage_name(static_cast<TraceStage>(s))].to<JsonObject>();
+        stage["count"] = summary.count;
+        stage["p50_us"] = summary.p50_us;
+        stage["p99_us"] = summary.p99_us;
+        stage["max_us"] = summary.max_us;
+    }
+    struct trace_event_t events[TRACE_EXPORT_EVENTS];
+    uint16_t event_count = trace_recent(events, TRACE_EXPORT_EVENTS);
+    JsonArray recent = trace["recent"].to<JsonArray>();
+    for (uint16_t i = 0; i < event_count; i++) {
+        JsonObject event = recent.add<JsonObject>();
+        event["stage"] = trace_stage_name(static_cast<TraceStage>(events[i].stage));
+        event["core"] = events[i].core;
+        event["us"] = static_cast<float>(events[i].cycles) / trace_cpu_mhz();
+        event["t_ms"] = events[i].time_ms;
+    }
+#endif
 
-    // Energy consumption
-    doc["energy_mah"] = energy.total_mah;
+#ifdef SIMUL_DATA
+    // Synthetic load offered to the RX ring
+    struct loadgen_stats_t load = loadgen_totals();
+    JsonObject loadgen = doc["loadgen_stats"].to<JsonObject>();
+    loadgen["nodes"] = SIMUL_NODES;
+    loadgen["target_fps"] = SIMUL_RATE_FPS;
+    loadgen["offered_fps"] = loadgen_offered_fps();
+    loadgen["generated"] = load.generated;
+    loadgen["duplicates"] = load.duplicates;
+    loadgen["corrupted"] = load.corrupted;
+    loadgen["reboots"] = load.reboots;
+    loadgen["ring_full"] = load.ring_full;
+#endif
+
+#ifdef LOG_DEFERRED_ON
+    JsonObject log_json = doc["log_stats"].to<JsonObject>();
+    log_json["level"] = LOG_LEVEL;
+    log_json["queued"] = log_stats.queued;
+    log_json["dropped"] = log_stats.dropped;
+#endif
+
+    // WiFi reconnect statistics
+    JsonObject wifi_json = doc["wifi_stats"].to<JsonObject>();
+    wifi_json["connect_attempts"] = wifi_stats.connect_attempts;
+    wifi_json["reconnects"] = wifi_stats.reconnects;
+    wifi_json["disconnects"] = wifi_stats.disconnects;
+    wifi_json["downtime_ms"] = get_wifi_downtime_ms();
+
+#ifdef SPOOL_ON
+    // Store-and-forward spool
+    JsonObject spool = doc["spool_stats"].to<JsonObject>();
+    spool["stored"] = spool_stats.stored;
+    spool["replayed"] = spool_stats.replayed;
+    spool["overwritten"] = spool_stats.overwritten;
+    spool["errors"] = spool_stats.errors;
+    spool["empty"] = spool_is_empty();
+#endif
+
+#ifdef POWER_SAVE_ON
+    JsonObject power = doc["power_stats"].to<JsonObject>();
+    power["sleeps"] = power_stats.sleeps;
+    power["early_wakes"] = power_stats.early_wakes;
+    power["slept_ms"] = power_stats.slept_ms;
+    power["dfs"] = power_stats.dfs_enabled;
+#endif
+
+    // Energy consumption, total and per power state
+    struct energy_t energy_now;
+    energy_snapshot(energy_now);
+    doc["energy_mah"] = energy_now.total_mah;
+    JsonObject energy_json = doc["energy"].to<JsonObject>();
+    energy_json["avg_current_ma"] = energy_average_current_ma();
+    energy_json["cpu_mhz"] = getCpuFrequencyMhz();
+    JsonObject states = energy_json["states"].to<JsonObject>();
+    for (uint8_t s = 0; s < ENERGY_STATE_COUNT; s++) {
+        JsonObject state = states[energy_state_name(static_cast<EnergyState>(s))].to<JsonObject>();
+        state["ms"] = energy_now.residency_ms[s];
+        state["mah"] = energy_now.state_mah[s];
+        state["current_ma"] = energy_now.current_ma[s];
+    }
 
     // WiFi signal
     if (wifi_connected) {
         doc["wifi_rssi"] = WiFi.RSSI();
     }
 
+    // Nodes go in last so the chunk can be cut where the body would outgrow one uplink
+    // request; a node that does not fit leads the next upload. Sizes are exact: the
+    // serialized document so far plus each node and its separating comma.
+    size_t body_length = measureJson(doc);
+    uint32_t now = millis();
+    uint16_t reported = 0;
+    for (uint16_t scanned = 0;
+         scanned < NODE_TABLE_CAPACITY && reported < NODE_STATS_REPORT_MAX;
+         scanned++) {
+        uint16_t slot = node_report_cursor;
+        const NodeState* state = node_table_slot(slot);
+        node_report_cursor = (node_report_cursor + 1) % NODE_TABLE_CAPACITY;
+        if (state == nullptr) {
+            continue;
+        }
+        JsonObject node = nodes.add<JsonObject>();
+        node["node_id"] = state->client_id;
+        node["rx"] = state->rx_frames;
+        node["accepted"] = state->accepted;
+        node["duplicates"] = state->duplicates;
+        node["lost"] = state->lost;
+        node["loss_percent"] = node_loss_percent(state->accepted, state->lost);
+        node["reorder_percent"] = state->accepted > 0
+            ? (static_cast<float>(state->reordered) / state->accepted * 100.0f) : 0.0f;
+        node["resets"] = state->resets;
+        node["last_sequence"] = state->highest_sequence;
+        node["tx_power_dbm"] = state->tx_power_dbm;
+        node["awake_ms"] = state->awake_ms;
+        node["status"] = state->heartbeat_status;
+        node["heartbeats"] = state->heartbeats;
+        node["alerts_active"] = state->alerts_active;
+#ifdef ADR_ON
+        node["adr_margin_db"] = adr_margin_db(state);
+#endif
+        node["rssi_dbm"] = state->last_rssi;
+        node["snr_db"] = state->last_snr;
+        node["last_seen_s"] = (now - state->last_seen_ms) / 1000;
+        size_t node_length = measureJson(node) + (reported > 0 ? 1 : 0);
+        if (body_length + node_length > UPLINK_MAX_BODY_SIZE) {
+            nodes.remove(reported);
+            node_report_cursor = slot;
+            break;
+        }
+        body_length += node_length;
+        reported++;
+    }
+
     String json;
     serializeJson(doc, json);
     return json;
 }
 
-void check_wifi_connection() {
-  #ifdef WIFI_ON
-  if (!WiFi.isConnected() && wifi_connected) {
-      print_log("WiFi disconnected, trying to connect again...");
-      wifi_connected = false;
-      init_wifi();
-  }
-  #endif
-}
-
 int get_current_wifi_rssi() {
 #ifdef WIFI_ON
     if (wifi_connected) {
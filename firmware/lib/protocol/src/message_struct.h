@@ -0,0 +1,188 @@
+#ifndef MESSAGE_STRUCT_H
+#define MESSAGE_STRUCT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    MSG_TYPE_SENSOR_DATA    = 0x01,     // Regular sensor data transmission
+    MSG_TYPE_HEARTBEAT      = 0x02,     // Keep-alive / status message
+    MSG_TYPE_ALERT          = 0x03,     // Alert/alarm notification
+    MSG_TYPE_SENSOR_BATCH   = 0x04,     // Several readings in one frame, delta-encoded
+    MSG_TYPE_SENSOR_AGGREGATE = 0x05,   // Min/max/mean of the samples taken since the last frame
+    MSG_TYPE_ACK            = 0xAA,     // Acknowledgment from gateway
+} MessageType;
+
+typedef enum {
+    STATUS_OK               = 0x00,     // All systems normal
+    STATUS_LOW_BATTERY      = 0x01,     // Battery below threshold
+    STATUS_SENSOR_ERROR     = 0x02,     // Sensor read failure
+    STATUS_LORA_ERROR       = 0x04,     // LoRa communication issue
+} NodeStatus;
+
+typedef enum {
+    // Temperature alerts (0x1x)
+    ALERT_TEMPERATURE_HIGH  = 0x10,
+    ALERT_TEMPERATURE_LOW   = 0x11,
+    
+    // Humidity alerts (0x2x)
+    ALERT_HUMIDITY_HIGH     = 0x20,
+    ALERT_HUMIDITY_LOW      = 0x21,
+    
+    // Distance/presence alerts (0x3x)
+    ALERT_DISTANCE_LOW      = 0x30,     // Object detected nearby
+
+    // Node status alerts (0x4x)
+    ALERT_BATTERY_LOW       = 0x40,
+} AlertCode;
+
+typedef enum {
+    SENSOR_FLAG_SEQUENCE_RESTART = 0x01,    // Counter restarted (RTC memory lost), not a duplicate
+    SENSOR_FLAG_RX_WINDOW        = 0x02,    // Node listens for a downlink right after this frame
+    SENSOR_FLAG_CONFIRMED        = 0x04,    // Node expects an ACK in its RX window, retransmits otherwise
+    SENSOR_FLAG_TX_POWER_MASK    = 0xF8,    // TX power the frame was sent at, see encode_tx_power() (0 = not reported)
+} SensorDataFlags;
+
+#define SENSOR_FLAG_TX_POWER_SHIFT  3
+#define SENSOR_TX_POWER_OFFSET      10      // Encoded power is dBm + 10, so -9..21 dBm fit the 5 bits
+
+typedef enum {
+    ACK_FLAG_RADIO_SETTINGS = 0x01,     // spreading_factor / tx_power_dbm are to be applied
+    ACK_FLAG_CONFIRMED      = 0x02,     // Acknowledges the confirmed uplink with this sequence
+    ACK_FLAG_CONFIG         = 0x04,     // config_key / config_value update the node's stored config
+} AckFlags;
+
+// Node settings that can be changed over the air, kept by the node in NVS
+typedef enum {
+    CONFIG_KEY_NONE                 = 0x00,
+    CONFIG_KEY_TX_INTERVAL_S        = 0x01,     // Seconds between transmissions
+    CONFIG_KEY_HUMIDITY_THRESHOLD   = 0x02,     // Humidity change that triggers a TX (% * 100)
+    CONFIG_KEY_DISTANCE_THRESHOLD   = 0x03,     // Distance change that triggers a TX (cm)
+    CONFIG_KEY_READINGS_PER_FRAME   = 0x04,     // Readings buffered per multi-reading frame
+} ConfigKey;
+
+#define CONFIG_KEY_COUNT    5
+
+struct __attribute__((packed)) SensorDataMessage {
+    uint8_t     msg_type;       // MSG_TYPE_SENSOR_DATA (0x01)
+    uint8_t     client_id;      // Node identifier (1-255)
+    uint32_t    timestamp;      // Milliseconds since boot
+    int16_t     temperature;    // Temperature * 100 (°C) - from AHT10 sensor
+    uint16_t    humidity;       // Humidity * 100 (%) - from AHT10 sensor
+    uint16_t    distance_cm;    // Distance in centimeters - from VL53L0X sensor
+    uint8_t     battery;        // Battery level (0-100%)
+    uint16_t    luminosity_lux; // Luminosity in lux - from BH1750 sensor
+    uint16_t    sequence;       // Per-node frame counter, kept across deep sleep (wraps)
+    uint8_t     flags;          // SensorDataFlags
+    uint16_t    awake_ms;       // Wake-to-sleep time of the node's previous cycle (0 = unknown)
+    uint8_t     checksum;       // Trailer, see FrameTrailer in protocol.h
+};
+
+// Layout sent by the original node firmware, before sequence numbers and flags. Only ever
+// sent with the XOR trailer; still accepted so nodes that were never reflashed keep reporting.
+struct __attribute__((packed)) SensorDataMessageV1 {
+    uint8_t     msg_type;       // MSG_TYPE_SENSOR_DATA (0x01)
+    uint8_t     client_id;      // Node identifier (1-255)
+    uint32_t    timestamp;      // Milliseconds since boot
+    int16_t     temperature;    // Encoded as in SensorDataMessage
+    uint16_t    humidity;
+    uint16_t    distance_cm;
+    uint8_t     battery;
+    uint16_t    luminosity_lux;
+    uint8_t     reserved;
+    uint8_t     checksum;       // XOR of all preceding bytes
+};
+
+#define SENSOR_BATCH_MAX_READINGS   8
+
+// MSG_TYPE_SENSOR_BATCH frame: the header carries the first reading in full, followed by
+// count - 1 records holding deltas against it, then the trailer
+struct __attribute__((packed)) SensorBatchHeader {
+    uint8_t     msg_type;       // MSG_TYPE_SENSOR_BATCH (0x04)
+    uint8_t     client_id;      // Node identifier (1-255)
+    uint32_t    timestamp;      // Milliseconds since boot, at transmission
+    uint16_t    sequence;       // Sequence of the first reading; reading i uses sequence + i
+    uint8_t     flags;          // SensorDataFlags of the first reading
+    uint8_t     count;          // Readings in the frame (1-SENSOR_BATCH_MAX_READINGS)
+    uint16_t    interval_s;     // Sampling period; the last reading is the newest
+    int16_t     temperature;    // First reading, encoded as in SensorDataMessage
+    uint16_t    humidity;
+    uint16_t    distance_cm;
+    uint16_t    luminosity_lux;
+    uint8_t     battery;        // Battery level at transmission (0-100%)
+    uint16_t    awake_ms;       // Wake-to-sleep time of the node's previous cycle (0 = unknown)
+};
+
+struct __attribute__((packed)) SensorBatchRecord {
+    int8_t      temperature_delta;  // Steps of 0.1 °C from the first reading
+    int8_t      humidity_delta;     // Steps of 0.1 % from the first reading
+    int16_t     distance_delta;     // cm from the first reading
+    int16_t     luminosity_delta;   // lux from the first reading
+};
+
+#define SENSOR_BATCH_DELTA_SCALE    10      // Encoded temperature/humidity units per delta step
+// Legacy (XOR trailer) length; CRC-16 frames are PROTOCOL_CRC_EXTRA_BYTES longer
+#define SENSOR_BATCH_FRAME_SIZE(count) \
+    (sizeof(SensorBatchHeader) + ((count) - 1) * sizeof(SensorBatchRecord) + 1)
+
+// MSG_TYPE_SENSOR_AGGREGATE frame: statistics over count samples taken every interval_s;
+// values are encoded as in SensorDataMessage, distance after the node's median filter
+struct __attribute__((packed)) SensorAggregateMessage {
+    uint8_t     msg_type;       // MSG_TYPE_SENSOR_AGGREGATE (0x05)
+    uint8_t     client_id;      // Node identifier (1-255)
+    uint32_t    timestamp;      // Milliseconds since boot, at transmission
+    uint16_t    sequence;       // Per-node frame counter
+    uint8_t     flags;          // SensorDataFlags
+    uint8_t     count;          // Samples aggregated
+    uint16_t    interval_s;     // Sampling period
+    int16_t     temperature_min;
+    int16_t     temperature_max;
+    int16_t     temperature_mean;
+    uint16_t    humidity_min;
+    uint16_t    humidity_max;
+    uint16_t    humidity_mean;
+    uint16_t    distance_min;
+    uint16_t    distance_max;
+    uint16_t    distance_mean;
+    uint16_t    luminosity_min;
+    uint16_t    luminosity_max;
+    uint16_t    luminosity_mean;
+    uint8_t     battery;        // Battery level at transmission (0-100%)
+    uint16_t    awake_ms;       // Wake-to-sleep time of the node's previous cycle (0 = unknown)
+    uint8_t     checksum;       // Trailer, see FrameTrailer in protocol.h
+};
+
+struct __attribute__((packed)) HeartbeatMessage {
+    uint8_t     msg_type;       // MSG_TYPE_HEARTBEAT (0x02)
+    uint8_t     client_id;      // Node identifier
+    uint32_t    timestamp;      // Milliseconds since boot
+    uint8_t     status;         // NodeStatus flags
+    uint8_t     checksum;       // Trailer, see FrameTrailer in protocol.h
+};
+
+struct __attribute__((packed)) AlertMessage {
+    uint8_t     msg_type;       // MSG_TYPE_ALERT (0x03)
+    uint8_t     client_id;      // Node identifier
+    uint32_t    timestamp;      // Milliseconds since boot
+    uint8_t     alert_code;     // AlertCode value
+    int16_t     alert_value;    // The value that triggered the alert
+    uint8_t     severity;       // Alert severity (1=low, 2=medium, 3=high)
+    uint8_t     reserved;       // Reserved for future use
+    uint8_t     checksum;       // Trailer, see FrameTrailer in protocol.h
+};
+
+// Gateway -> node downlink, sent only inside the node's RX window
+struct __attribute__((packed)) AckMessage {
+    uint8_t     msg_type;           // MSG_TYPE_ACK (0xAA)
+    uint8_t     client_id;          // Destination node
+    uint16_t    sequence;           // Newest sequence received from the node
+    uint8_t     flags;              // AckFlags
+    uint8_t     spreading_factor;   // SF the node should use (7-12)
+    int8_t      tx_power_dbm;       // TX power the node should use
+    uint8_t     config_key;         // ConfigKey, when ACK_FLAG_CONFIG is set
+    uint32_t    config_value;
+    uint8_t     checksum;           // Trailer, see FrameTrailer in protocol.h
+};
+
+#endif // MESSAGE_STRUCT_H
+
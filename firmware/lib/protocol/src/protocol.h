@@ -0,0 +1,390 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// Frame codec shared by the client and the gateway: checksum and value encoding, one
+// descriptor per message type, and a msg_type dispatch table for received frames.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "message_struct.h"
+
+// Frame trailer. Legacy frames end in the 1-byte XOR of the preceding bytes (the checksum
+// member of the structs below); v2 frames replace it with a 2-byte CRC-16, so a v2 frame is
+// one byte longer than its struct and the receiver tells the two apart by length.
+typedef enum {
+    FRAME_TRAILER_XOR,          // Legacy, accepted from nodes not yet updated
+    FRAME_TRAILER_CRC16,        // CRC-16/CCITT-FALSE, little-endian
+} FrameTrailer;
+
+#define PROTOCOL_CRC_EXTRA_BYTES    1       // v2 frame length - legacy frame length
+
+// XOR of every byte but the last, which is where the result goes
+inline uint8_t calculate_checksum(const uint8_t* data, size_t length) {
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < length - 1; i++) {
+        checksum ^= data[i];
+    }
+    return checksum;
+}
+
+inline bool verify_checksum(const uint8_t* data, size_t length) {
+    return calculate_checksum(data, length) == data[length - 1];
+}
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), one table lookup per byte. The table is a
+// function-local static so every translation unit shares the single copy in flash.
+inline const uint16_t* crc16_table() {
+    static const uint16_t table[256] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+        0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+        0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+        0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+        0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+        0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+        0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+        0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+        0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+        0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+        0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+        0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+        0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+        0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+        0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+        0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+        0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+        0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+        0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+        0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+        0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+        0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+        0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+        0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+        0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+        0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+        0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+        0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+        0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+        0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+        0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+    };
+    return table;
+}
+
+inline uint16_t crc16_ccitt(const uint8_t* data, size_t length) {
+    const uint16_t* table = crc16_table();
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc = static_cast<uint16_t>((crc << 8) ^ table[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+inline bool protocol_verify(const uint8_t* data, size_t length, FrameTrailer trailer) {
+    if (trailer == FRAME_TRAILER_XOR) {
+        return verify_checksum(data, length);
+    }
+    uint16_t received = static_cast<uint16_t>(data[length - 2] | (data[length - 1] << 8));
+    return crc16_ccitt(data, length - 2) == received;
+}
+
+// Writes the trailer of a frame laid out as its struct (legacy_length bytes, checksum member
+// last) and returns the length to transmit. CRC frames need one spare byte in the buffer.
+inline size_t protocol_seal(uint8_t* frame, size_t legacy_length, FrameTrailer trailer) {
+    if (trailer == FRAME_TRAILER_XOR) {
+        frame[legacy_length - 1] = calculate_checksum(frame, legacy_length);
+        return legacy_length;
+    }
+    uint16_t crc = crc16_ccitt(frame, legacy_length - 1);
+    frame[legacy_length - 1] = static_cast<uint8_t>(crc & 0xFF);
+    frame[legacy_length] = static_cast<uint8_t>(crc >> 8);
+    return legacy_length + PROTOCOL_CRC_EXTRA_BYTES;
+}
+
+// Trailer format implied by the length of a frame whose legacy layout is legacy_length bytes
+inline bool protocol_trailer_for(size_t legacy_length, size_t length, FrameTrailer& trailer) {
+    if (length == legacy_length) {
+        trailer = FRAME_TRAILER_XOR;
+        return true;
+    }
+    if (length == legacy_length + PROTOCOL_CRC_EXTRA_BYTES) {
+        trailer = FRAME_TRAILER_CRC16;
+        return true;
+    }
+    return false;
+}
+
+inline int16_t encode_temperature(float temp) {
+    return static_cast<int16_t>(temp * 100.0f);
+}
+
+inline float decode_temperature(int16_t encoded) {
+    return encoded / 100.0f;
+}
+
+inline uint16_t encode_humidity(float humidity) {
+    return static_cast<uint16_t>(humidity * 100.0f);
+}
+
+inline float decode_humidity(uint16_t encoded) {
+    return encoded / 100.0f;
+}
+
+// TX power bits of a SensorDataFlags byte. Higher powers are reported as the highest that
+// fits; nodes that predate the field leave the bits clear.
+inline uint8_t encode_tx_power(int8_t dbm) {
+    int encoded = dbm + SENSOR_TX_POWER_OFFSET;
+    const int max_encoded = SENSOR_FLAG_TX_POWER_MASK >> SENSOR_FLAG_TX_POWER_SHIFT;
+    if (encoded < 1) encoded = 1;
+    if (encoded > max_encoded) encoded = max_encoded;
+    return static_cast<uint8_t>(encoded << SENSOR_FLAG_TX_POWER_SHIFT);
+}
+
+// False when the frame does not report its TX power
+inline bool decode_tx_power(uint8_t flags, int8_t& dbm) {
+    int encoded = (flags & SENSOR_FLAG_TX_POWER_MASK) >> SENSOR_FLAG_TX_POWER_SHIFT;
+    if (encoded == 0) {
+        return false;
+    }
+    dbm = static_cast<int8_t>(encoded - SENSOR_TX_POWER_OFFSET);
+    return true;
+}
+
+// Wire layout. Both firmwares are built with the same compiler, but the frames also reach
+// the server decoders, so any change here is a protocol change and must fail the build.
+#define PROTOCOL_ASSERT_OFFSET(Msg, field, offset) \
+    static_assert(offsetof(Msg, field) == (offset), #Msg "::" #field " moved")
+
+static_assert(sizeof(SensorDataMessage) == 21, "SensorDataMessage size changed");
+PROTOCOL_ASSERT_OFFSET(SensorDataMessage, client_id, 1);
+PROTOCOL_ASSERT_OFFSET(SensorDataMessage, timestamp, 2);
+PROTOCOL_ASSERT_OFFSET(SensorDataMessage, temperature, 6);
+PROTOCOL_ASSERT_OFFSET(SensorDataMessage, battery, 12);
+PROTOCOL_ASSERT_OFFSET(SensorDataMessage, sequence, 15);
+PROTOCOL_ASSERT_OFFSET(SensorDataMessage, flags, 17);
+PROTOCOL_ASSERT_OFFSET(SensorDataMessage, awake_ms, 18);
+
+static_assert(sizeof(SensorDataMessageV1) == 17, "SensorDataMessageV1 size changed");
+PROTOCOL_ASSERT_OFFSET(SensorDataMessageV1, battery, 12);
+PROTOCOL_ASSERT_OFFSET(SensorDataMessageV1, luminosity_lux, 13);
+
+static_assert(sizeof(SensorBatchHeader) == 23, "SensorBatchHeader size changed");
+static_assert(sizeof(SensorBatchRecord) == 6, "SensorBatchRecord size changed");
+PROTOCOL_ASSERT_OFFSET(SensorBatchHeader, sequence, 6);
+PROTOCOL_ASSERT_OFFSET(SensorBatchHeader, count, 9);
+PROTOCOL_ASSERT_OFFSET(SensorBatchHeader, temperature, 12);
+PROTOCOL_ASSERT_OFFSET(SensorBatchHeader, awake_ms, 21);
+
+static_assert(sizeof(SensorAggregateMessage) == 40, "SensorAggregateMessage size changed");
+PROTOCOL_ASSERT_OFFSET(SensorAggregateMessage, sequence, 6);
+PROTOCOL_ASSERT_OFFSET(SensorAggregateMessage, temperature_min, 12);
+PROTOCOL_ASSERT_OFFSET(SensorAggregateMessage, battery, 36);
+
+static_assert(sizeof(HeartbeatMessage) == 8, "HeartbeatMessage size changed");
+PROTOCOL_ASSERT_OFFSET(HeartbeatMessage, status, 6);
+
+static_assert(sizeof(AlertMessage) == 12, "AlertMessage size changed");
+PROTOCOL_ASSERT_OFFSET(AlertMessage, alert_code, 6);
+PROTOCOL_ASSERT_OFFSET(AlertMessage, alert_value, 7);
+
+static_assert(sizeof(AckMessage) == 13, "AckMessage size changed");
+PROTOCOL_ASSERT_OFFSET(AckMessage, sequence, 2);
+PROTOCOL_ASSERT_OFFSET(AckMessage, config_value, 8);
+
+// Single-field load from a raw frame (memcpy, so any buffer alignment is fine)
+template <typename T>
+inline T protocol_load(const uint8_t* data) {
+    T value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+#define PROTOCOL_GET(Msg, field, data) \
+    protocol_load<decltype(Msg::field)>((data) + offsetof(Msg, field))
+
+// Zero-copy view of a frame in place. The structs are packed (alignment 1), so the compiler
+// emits byte loads for every field and the RX buffer needs no particular alignment. Members
+// must be read by value: a reference or pointer to a packed member loses that guarantee.
+template <typename Msg>
+inline const Msg* protocol_view(const uint8_t* data) {
+    static_assert(alignof(Msg) == 1, "frame structs must be packed");
+    return reinterpret_cast<const Msg*>(data);
+}
+
+// Per-type framing: msg_type, a name for logs and the accepted lengths. frame_format()
+// checks the length and reports which trailer it implies.
+template <typename Msg>
+struct protocol_descriptor;
+
+#define PROTOCOL_FIXED_FRAME(Msg, type, label)                                          \
+    template <>                                                                         \
+    struct protocol_descriptor<Msg> {                                                   \
+        static constexpr uint8_t msg_type = type;                                       \
+        static constexpr size_t max_length = sizeof(Msg) + PROTOCOL_CRC_EXTRA_BYTES;    \
+        static const char* name() { return label; }                                     \
+        static bool frame_format(const uint8_t*, size_t length, FrameTrailer& trailer) { \
+            return protocol_trailer_for(sizeof(Msg), length, trailer);                  \
+        }                                                                               \
+    }
+
+PROTOCOL_FIXED_FRAME(SensorDataMessage, MSG_TYPE_SENSOR_DATA, "sensor data");
+PROTOCOL_FIXED_FRAME(SensorAggregateMessage, MSG_TYPE_SENSOR_AGGREGATE, "sensor aggregate");
+PROTOCOL_FIXED_FRAME(HeartbeatMessage, MSG_TYPE_HEARTBEAT, "heartbeat");
+PROTOCOL_FIXED_FRAME(AlertMessage, MSG_TYPE_ALERT, "alert");
+PROTOCOL_FIXED_FRAME(AckMessage, MSG_TYPE_ACK, "ack");
+
+// Original node firmware: a msg_type shared with SensorDataMessage, told apart by length
+template <>
+struct protocol_descriptor<SensorDataMessageV1> {
+    static constexpr uint8_t msg_type = MSG_TYPE_SENSOR_DATA;
+    static constexpr size_t max_length = sizeof(SensorDataMessageV1);
+    static const char* name() { return "sensor data v1"; }
+    static bool frame_format(const uint8_t*, size_t length, FrameTrailer& trailer) {
+        trailer = FRAME_TRAILER_XOR;
+        return length == sizeof(SensorDataMessageV1);
+    }
+};
+
+// A V1 reading in the current layout; it has no sequence, flags or awake time, left 0
+inline SensorDataMessage sensor_data_from_v1(const SensorDataMessageV1& legacy) {
+    SensorDataMessage msg;
+    msg.msg_type = MSG_TYPE_SENSOR_DATA;
+    msg.client_id = legacy.client_id;
+    msg.timestamp = legacy.timestamp;
+    msg.temperature = legacy.temperature;
+    msg.humidity = legacy.humidity;
+    msg.distance_cm = legacy.distance_cm;
+    msg.battery = legacy.battery;
+    msg.luminosity_lux = legacy.luminosity_lux;
+    msg.sequence = 0;
+    msg.flags = 0;
+    msg.awake_ms = 0;
+    msg.checksum = calculate_checksum(reinterpret_cast<const uint8_t*>(&msg), sizeof(msg));
+    return msg;
+}
+
+// Back to the V1 layout, e.g. to store a reading as the node sent it
+inline SensorDataMessageV1 sensor_data_to_v1(const SensorDataMessage& msg) {
+    SensorDataMessageV1 legacy;
+    legacy.msg_type = MSG_TYPE_SENSOR_DATA;
+    legacy.client_id = msg.client_id;
+    legacy.timestamp = msg.timestamp;
+    legacy.temperature = msg.temperature;
+    legacy.humidity = msg.humidity;
+    legacy.distance_cm = msg.distance_cm;
+    legacy.battery = msg.battery;
+    legacy.luminosity_lux = msg.luminosity_lux;
+    legacy.reserved = 0;
+    legacy.checksum = calculate_checksum(reinterpret_cast<const uint8_t*>(&legacy), sizeof(legacy));
+    return legacy;
+}
+
+// Header plus count - 1 delta records plus the trailer, count read from the header. Legacy
+// and CRC lengths differ by one byte and records are 6 bytes, so they never collide.
+template <>
+struct protocol_descriptor<SensorBatchHeader> {
+    static constexpr uint8_t msg_type = MSG_TYPE_SENSOR_BATCH;
+    static constexpr size_t max_length =
+        SENSOR_BATCH_FRAME_SIZE(SENSOR_BATCH_MAX_READINGS) + PROTOCOL_CRC_EXTRA_BYTES;
+    static const char* name() { return "sensor batch"; }
+    static bool frame_format(const uint8_t* data, size_t length, FrameTrailer& trailer) {
+        if (length < SENSOR_BATCH_FRAME_SIZE(1)) {
+            return false;
+        }
+        uint8_t count = PROTOCOL_GET(SensorBatchHeader, count, data);
+        return count >= 1 && count <= SENSOR_BATCH_MAX_READINGS &&
+               protocol_trailer_for(SENSOR_BATCH_FRAME_SIZE(count), length, trailer);
+    }
+};
+
+// Type, length and trailer of a single expected frame type (e.g. a downlink)
+template <typename Msg>
+inline bool protocol_frame_ok(const uint8_t* data, size_t length) {
+    typedef protocol_descriptor<Msg> descriptor;
+    FrameTrailer trailer;
+    return length >= 1 && data[0] == descriptor::msg_type &&
+           descriptor::frame_format(data, length, trailer) && protocol_verify(data, length, trailer);
+}
+
+typedef enum {
+    PROTOCOL_OK,
+    PROTOCOL_EMPTY,
+    PROTOCOL_UNKNOWN_TYPE,
+    PROTOCOL_BAD_LENGTH,
+    PROTOCOL_BAD_CHECKSUM,
+} ProtocolStatus;
+
+// What a handler knows about its frame besides the fields
+struct protocol_frame_t {
+    size_t length;
+    FrameTrailer trailer;       // Replies to the node should use the same format
+};
+
+// One entry of a receive dispatch table; Context carries whatever the handlers need
+template <typename Context>
+struct protocol_route_t {
+    uint8_t msg_type;
+    const char* (*name)();
+    bool (*frame_format)(const uint8_t* data, size_t length, FrameTrailer& trailer);
+    void (*handle)(const uint8_t* data, const struct protocol_frame_t& frame, Context& context);
+};
+
+template <typename Msg, typename Context,
+          void (*Handler)(const Msg& msg, const struct protocol_frame_t& frame, Context& context)>
+inline void protocol_invoke(const uint8_t* data, const struct protocol_frame_t& frame, Context& context) {
+    Handler(*protocol_view<Msg>(data), frame, context);
+}
+
+// Route for a typed handler: the handler gets a view of the frame once it passed the checks
+#define PROTOCOL_ROUTE(Msg, Context, handler)                   \
+    protocol_route_t<Context> {                                 \
+        protocol_descriptor<Msg>::msg_type,                     \
+        &protocol_descriptor<Msg>::name,                        \
+        &protocol_descriptor<Msg>::frame_format,                \
+        &protocol_invoke<Msg, Context, handler>                 \
+    }
+
+// Looks the frame up by msg_type, checks length and trailer, then runs its handler.
+// Layouts sharing a msg_type are tried in table order; the first whose length matches wins.
+// verify is the trailer check (normally protocol_verify), so callers can instrument it.
+// route is set whenever the type is known, for logs.
+template <typename Context, size_t N>
+inline ProtocolStatus protocol_dispatch(
+    const protocol_route_t<Context> (&routes)[N],
+    const uint8_t* data,
+    size_t length,
+    Context& context,
+    bool (*verify)(const uint8_t* data, size_t length, FrameTrailer trailer),
+    const protocol_route_t<Context>** route = nullptr
+) {
+    if (length < 1) {
+        return PROTOCOL_EMPTY;
+    }
+    ProtocolStatus status = PROTOCOL_UNKNOWN_TYPE;
+    for (size_t i = 0; i < N; i++) {
+        const protocol_route_t<Context>& entry = routes[i];
+        if (entry.msg_type != data[0]) {
+            continue;
+        }
+        if (route != nullptr && status == PROTOCOL_UNKNOWN_TYPE) {
+            *route = &entry;
+        }
+        struct protocol_frame_t frame = {length, FRAME_TRAILER_XOR};
+        if (!entry.frame_format(data, length, frame.trailer)) {
+            status = PROTOCOL_BAD_LENGTH;
+            continue;
+        }
+        if (route != nullptr) {
+            *route = &entry;
+        }
+        if (!verify(data, length, frame.trailer)) {
+            return PROTOCOL_BAD_CHECKSUM;
+        }
+        entry.handle(data, frame, context);
+        return PROTOCOL_OK;
+    }
+    return status;
+}
+
+#endif // PROTOCOL_H
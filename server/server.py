@@ -7,10 +7,15 @@ Compatible with both old mock client and new LoRa gateway
 import http.server
 import socketserver
 import json
+import queue
 import sqlite3
+import struct
+import threading
+from collections import OrderedDict
+from contextlib import contextmanager
 from pathlib import Path
 from datetime import datetime, timedelta
-from typing import Any, Dict, List
+from typing import Any, Dict, Iterator, List, Optional, Tuple
 
 BASE_DIR = Path(__file__).resolve().parent
 DB_NAME = 'environmental_data.db'
@@ -18,14 +23,95 @@ DB_PATH = BASE_DIR / DB_NAME
 HOST = '0.0.0.0'
 PORT = 8080
 
+# Binary batch upload from the gateway (see firmware/gateway/include/batch.h)
+BINARY_BATCH_HEADER = struct.Struct('<BBHQ')     # version, gateway_id, count, base_epoch_ms
+BINARY_BATCH_RECORDS = {
+    1: struct.Struct('<BHhHHHBbb'),     # client_id, delta_ms, temp, hum, dist, lux, battery, rssi, snr_qdb
+    2: struct.Struct('<BHHhHHHBbb'),    # client_id, sequence, then as version 1
+    3: struct.Struct('<BHihHHHBbb'),    # client_id, sequence, signed offset_ms from the base, then as version 1
+}
+PRESENCE_DISTANCE_CM = 100                        # Mirrors MAX_DISTANCE_TO_BE_PRESENCE_CM
+
+# One writer connection behind a lock, a few readers; WAL lets them run while a batch commits
+DB_READER_CONNECTIONS = 4
+DB_BUSY_TIMEOUT_S = 5.0
+
+# Charts up to this range read the per-minute rollup, longer ones the per-hour rollup
+ROLLUP_MINUTE_MAX_HOURS = 6
+ROLLUP_TABLES = {
+    'sensor_rollup_minute': 16,     # Bucket = timestamp[:16] -> 'YYYY-MM-DDTHH:MM'
+    'sensor_rollup_hour': 13,       # Bucket = timestamp[:13] -> 'YYYY-MM-DDTHH'
+}
+# Rollup field -> raw sensor_data column, and its index in a sensor_row() tuple
+ROLLUP_COLUMNS = {
+    'temperature': ('temperature_celsius', 2),
+    'humidity': ('humidity_percent', 3),
+    'distance': ('distance_cm', 4),
+    'battery': ('battery_percent', 7),
+}
+ROLLUP_FIELDS = tuple(ROLLUP_COLUMNS)
+
+# A node heard by several gateways is uplinked once per gateway; copies share (node_id, sequence)
+# and a reception time within the window (gateways stamp frames at RX), the best SNR is kept
+DEDUP_CACHE_SIZE = 4096
+DEDUP_WINDOW_S = 60
+
 gateway_stats_cache: Dict[int, Dict[str, Any]] = {}
+
+# Settings posted to /api/config, handed to the gateway in its next stats response
+pending_config: Dict[int, Dict[str, Any]] = {}
+pending_config_lock = threading.Lock()
 server_start_time: datetime = None  # Tempo de início do servidor
 
+db_writer: sqlite3.Connection = None
+db_writer_lock = threading.RLock()     # Re-entrant: held across db_write() and the cache update after its commit
+db_readers: 'queue.Queue[sqlite3.Connection]' = queue.Queue()
+
+# (node_id, sequence) -> [reception time, stored timestamp, stored SNR]; guarded by db_writer_lock
+recent_readings: 'OrderedDict[Tuple[str, int], List[Any]]' = OrderedDict()
+dedup_stats = {'collapsed': 0, 'replaced': 0}
+
+
+def open_connection() -> sqlite3.Connection:
+    """Long-lived connection shared across request threads (access is serialized by the caller)"""
+    connection = sqlite3.connect(DB_PATH, timeout=DB_BUSY_TIMEOUT_S, check_same_thread=False)
+    connection.execute('PRAGMA journal_mode=WAL')
+    connection.execute('PRAGMA synchronous=NORMAL')    # WAL stays consistent; only the last commits are at risk on power loss
+    return connection
+
+
+@contextmanager
+def db_write() -> Iterator[sqlite3.Cursor]:
+    """One transaction on the writer connection, committed on exit, rolled back on error"""
+    with db_writer_lock:
+        with db_writer:
+            yield db_writer.cursor()
+
+
+@contextmanager
+def db_read() -> Iterator[sqlite3.Cursor]:
+    """Cursor on a pooled reader connection"""
+    connection = db_readers.get()
+    try:
+        yield connection.cursor()
+    finally:
+        db_readers.put(connection)
+
 
 def initialize_database() -> None:
     """Initialize SQLite database with sensor data table"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
+    global db_writer
+    db_writer = open_connection()
+    for _ in range(DB_READER_CONNECTIONS):
+        db_readers.put(open_connection())
+
+    with db_write() as cursor:
+        create_tables(cursor)
+    print(f"✓ Database '{DB_NAME}' initialized (WAL, {DB_READER_CONNECTIONS} readers).")
+
+
+def create_tables(cursor: sqlite3.Cursor) -> None:
+    """Tables, indexes and rollups; rollups are backfilled from raw rows when first created"""
     cursor.execute('''
         CREATE TABLE IF NOT EXISTS sensor_data (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -39,9 +125,13 @@ def initialize_database() -> None:
             battery_percent INTEGER,
             rssi_dbm REAL,
             snr_db REAL,
-            gateway_id INTEGER
+            gateway_id INTEGER,
+            sequence INTEGER
         )
     ''')
+    cursor.execute('PRAGMA table_info(sensor_data)')
+    if 'sequence' not in [column[1] for column in cursor.fetchall()]:
+        cursor.execute('ALTER TABLE sensor_data ADD COLUMN sequence INTEGER')    # Databases from before dedup
     cursor.execute('''
         CREATE TABLE IF NOT EXISTS gateway_stats (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -75,39 +165,63 @@ def initialize_database() -> None:
             acknowledged BOOLEAN DEFAULT FALSE
         )
     ''')
-    connection.commit()
-    connection.close()
-    print(f"✓ Database '{DB_NAME}' initialized.")
+    cursor.execute('CREATE INDEX IF NOT EXISTS idx_sensor_data_node_time ON sensor_data (node_id, timestamp)')
+    cursor.execute('CREATE INDEX IF NOT EXISTS idx_sensor_data_time ON sensor_data (timestamp)')
+    cursor.execute('CREATE INDEX IF NOT EXISTS idx_gateway_stats_gateway_time ON gateway_stats (gateway_id, timestamp)')
+    cursor.execute('CREATE INDEX IF NOT EXISTS idx_alerts_time ON alerts (timestamp)')
 
+    # Sums and non-NULL counts per field, so averages merge across buckets and batches
+    columns = ', '.join(f'{field}_sum REAL NOT NULL DEFAULT 0, {field}_count INTEGER NOT NULL DEFAULT 0'
+                        for field in ROLLUP_FIELDS)
+    for table, bucket_length in ROLLUP_TABLES.items():
+        cursor.execute(f"SELECT name FROM sqlite_master WHERE type = 'table' AND name = ?", (table,))
+        created = cursor.fetchone() is None
+        cursor.execute(f'''
+            CREATE TABLE IF NOT EXISTS {table} (
+                node_id TEXT NOT NULL,
+                bucket TEXT NOT NULL,
+                readings INTEGER NOT NULL DEFAULT 0,
+                {columns},
+                PRIMARY KEY (node_id, bucket)
+            ) WITHOUT ROWID
+        ''')
+        cursor.execute(f'CREATE INDEX IF NOT EXISTS idx_{table}_bucket ON {table} (bucket)')
+        if created:
+            sums = ', '.join(f'COALESCE(SUM({column}), 0), COUNT({column})'
+                             for column, _ in ROLLUP_COLUMNS.values())
+            cursor.execute(f'''
+                INSERT INTO {table}
+                SELECT node_id, substr(timestamp, 1, {bucket_length}), COUNT(*), {sums}
+                FROM sensor_data
+                GROUP BY node_id, substr(timestamp, 1, {bucket_length})
+            ''')
 
-def save_sensor_data(data: Dict[str, Any]) -> None:
-    """Save sensor data to database"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
-    
-    node_id = data.get('node_id', 'unknown')
-    
+
+def reading_timestamp(data: Dict[str, Any]) -> str:
+    """ISO timestamp of a reading, from the gateway's epoch when it has one"""
     # Converter timestamp da ESP (milissegundos desde conexão) para timestamp absoluto
     esp_timestamp_ms = data.get('timestamp')
-    if esp_timestamp_ms and isinstance(esp_timestamp_ms, (int, float)):
+    epoch_ms = data.get('epoch_ms')
+    if epoch_ms and isinstance(epoch_ms, (int, float)):
+        # Horário absoluto de recepção informado pelo gateway
+        timestamp = datetime.utcfromtimestamp(epoch_ms / 1000).isoformat()
+    elif esp_timestamp_ms and isinstance(esp_timestamp_ms, (int, float)):
         # Somar os milissegundos da ESP ao tempo de início do servidor
         absolute_time = server_start_time + timedelta(milliseconds=esp_timestamp_ms)
         timestamp = absolute_time.isoformat()
     else:
         # Fallback para timestamp atual se não houver timestamp da ESP
         timestamp = datetime.utcnow().isoformat()
-    
+    return timestamp
+
+
+def sensor_row(data: Dict[str, Any]) -> Tuple:
+    """sensor_data row for one reading (JSON or decoded binary)"""
     sensors = data.get('sensors', data)
     radio = data.get('radio', {})
-    
-    cursor.execute('''
-        INSERT INTO sensor_data (
-            node_id, timestamp, temperature_celsius, humidity_percent, distance_cm,
-            luminosity_lux, presence_detected, battery_percent, rssi_dbm, snr_db, gateway_id
-        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
-    ''', (
-        node_id,
-        timestamp,
+    return (
+        data.get('node_id', 'unknown'),
+        reading_timestamp(data),
         sensors.get('temperature_celsius', sensors.get('temperature')),
         sensors.get('humidity_percent', sensors.get('humidity')),
         sensors.get('distance_cm'),
@@ -116,34 +230,190 @@ def save_sensor_data(data: Dict[str, Any]) -> None:
         data.get('battery_percent'),
         radio.get('rssi_dbm', sensors.get('rssi_dbm')),
         radio.get('snr_db', sensors.get('snr_db')),
-        data.get('gateway_id')
-    ))
-    connection.commit()
-    
-    check_and_generate_alerts(data, connection)
-    
-    connection.close()
+        data.get('gateway_id', data.get('NODE_ID')),    # JSON uploads name the gateway NODE_ID
+        data.get('sequence')
+    )
+
+
+def find_copy(row: Tuple, pending: Dict[Tuple[str, int], List[Any]]) -> Optional[List[Any]]:
+    """Entry of an earlier copy of this reading, or None after noting it as new in pending.
+
+    Matches come from this batch (pending) or from committed batches (the cache). Cache entries
+    are copied into pending, so nothing reaches the cache before remember_readings()."""
+    node_id, timestamp, sequence = row[0], row[1], row[11]
+    if sequence is None:
+        return None     # Binary batch v1, V1 nodes and the mock client carry no sequence
+
+    key = (node_id, sequence)
+    received = datetime.fromisoformat(timestamp)
+    entry = pending.get(key)
+    if entry is None:
+        entry = recent_readings.get(key)
+    # Same sequence long after the first copy: the node restarted its counter, not a copy
+    if entry is not None and abs((received - entry[0]).total_seconds()) <= DEDUP_WINDOW_S:
+        if key not in pending:
+            entry = pending[key] = list(entry)
+        return entry
+
+    pending[key] = [received, timestamp, row[9]]
+    return None
+
+
+def remember_readings(pending: Dict[Tuple[str, int], List[Any]]) -> None:
+    """Add the readings of a committed batch to the dedup cache"""
+    for key, entry in pending.items():
+        recent_readings[key] = entry
+        recent_readings.move_to_end(key)
+    while len(recent_readings) > DEDUP_CACHE_SIZE:
+        recent_readings.popitem(last=False)
+
+
+def update_rollups(cursor: sqlite3.Cursor, rows: List[Tuple]) -> None:
+    """Fold a batch of sensor rows into the minute and hour rollups, one upsert per bucket"""
+    assignments = ', '.join(f'{field}_sum = {field}_sum + excluded.{field}_sum, '
+                            f'{field}_count = {field}_count + excluded.{field}_count'
+                            for field in ROLLUP_FIELDS)
+    placeholders = ', '.join('?' * (3 + 2 * len(ROLLUP_FIELDS)))
+
+    for table, bucket_length in ROLLUP_TABLES.items():
+        buckets: Dict[Tuple[str, str], List[float]] = {}
+        for row in rows:
+            key = (row[0], row[1][:bucket_length])
+            totals = buckets.setdefault(key, [0] * (1 + 2 * len(ROLLUP_FIELDS)))
+            totals[0] += 1
+            for i, field in enumerate(ROLLUP_FIELDS):
+                value = row[ROLLUP_COLUMNS[field][1]]
+                if value is not None:
+                    totals[1 + 2 * i] += value
+                    totals[2 + 2 * i] += 1
+        cursor.executemany(f'''
+            INSERT INTO {table} VALUES ({placeholders})
+            ON CONFLICT (node_id, bucket) DO UPDATE SET readings = readings + excluded.readings, {assignments}
+        ''', [key + tuple(totals) for key, totals in buckets.items()])
+
+
+def save_sensor_readings(readings: List[Dict[str, Any]]) -> int:
+    """Store a batch of readings, its rollups and alerts in one transaction; returns the new rows"""
+    if not readings:
+        return 0
+    # A rolled-back batch must leave no trace in the dedup cache, or its retry is taken for copies
+    pending: Dict[Tuple[str, int], List[Any]] = {}
+    collapsed = replaced = 0
+    with db_writer_lock:
+        with db_write() as cursor:
+            rows: List[Tuple] = []
+            alert_rows: List[Tuple] = []
+            better_copies: List[Tuple] = []
+            for data in readings:
+                row = sensor_row(data)
+                copy = find_copy(row, pending)
+                if copy is None:
+                    rows.append(row)
+                    # Gateway uplinks carry their alerts on the alert lane; only gateway-less posts get them here
+                    if row[10] is None:
+                        alert_rows.extend(sensor_alerts(data))
+                    continue
+
+                # Another gateway's copy: only its radio fields matter, and only if it heard the node better
+                collapsed += 1
+                snr = row[9]
+                if snr is not None and (copy[2] is None or snr > copy[2]):
+                    copy[2] = snr
+                    replaced += 1
+                    better_copies.append((row[8], snr, row[10], row[0], copy[1], row[11]))
+
+            cursor.executemany('''
+                INSERT INTO sensor_data (
+                    node_id, timestamp, temperature_celsius, humidity_percent, distance_cm,
+                    luminosity_lux, presence_detected, battery_percent, rssi_dbm, snr_db, gateway_id, sequence
+                ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+            ''', rows)
+            cursor.executemany('''
+                UPDATE sensor_data SET rssi_dbm = ?, snr_db = ?, gateway_id = ?
+                WHERE node_id = ? AND timestamp = ? AND sequence = ?
+            ''', better_copies)
+            update_rollups(cursor, rows)
+            cursor.executemany('''
+                INSERT INTO alerts (timestamp, node_id, alert_type, message)
+                VALUES (?, ?, ?, ?)
+            ''', alert_rows)
+
+        # Committed: later uploads may now be matched against this batch
+        remember_readings(pending)
+        dedup_stats['collapsed'] += collapsed
+        dedup_stats['replaced'] += replaced
+    return len(rows)
+
+
+def save_sensor_data(data: Dict[str, Any]) -> int:
+    """Save sensor data to database"""
+    return save_sensor_readings([data])
+
+
+def decode_binary_batch(body: bytes) -> List[Dict[str, Any]]:
+    """Expand a binary batch upload into the same dicts the JSON path produces"""
+    if len(body) < BINARY_BATCH_HEADER.size:
+        raise ValueError('binary batch shorter than header')
+
+    version, gateway_id, count, base_epoch_ms = BINARY_BATCH_HEADER.unpack_from(body, 0)
+    record_struct = BINARY_BATCH_RECORDS.get(version)
+    if record_struct is None:
+        raise ValueError(f'unsupported binary batch version {version}')
+
+    expected = BINARY_BATCH_HEADER.size + count * record_struct.size
+    if len(body) != expected:
+        raise ValueError(f'binary batch length {len(body)} does not match {count} records ({expected})')
+
+    records = [record_struct.unpack_from(body, BINARY_BATCH_HEADER.size + i * record_struct.size)
+               for i in range(count)]
+    if version == 1:
+        records = [(record[0], None) + record[1:] for record in records]
+
+    # Versions 1-2 chain uint16 deltas from the previous record; version 3 has offsets from the base
+    if version < 3:
+        offset = 0
+        chained = []
+        for record in records:
+            offset += record[2]
+            chained.append(record[:2] + (offset,) + record[3:])
+        records = chained
+
+    # Sem horário sincronizado no gateway, ancora o registro mais novo no horário atual
+    if base_epoch_ms == 0 and records:
+        base_epoch_ms = int(datetime.utcnow().timestamp() * 1000) - max(record[2] for record in records)
+
+    readings: List[Dict[str, Any]] = []
+    for client_id, sequence, offset_ms, temperature, humidity, distance, luminosity, battery, rssi, snr_qdb in records:
+        epoch_ms = base_epoch_ms + offset_ms
+        readings.append({
+            'node_id': f'node-{client_id}',
+            'gateway_id': gateway_id,
+            'epoch_ms': epoch_ms,
+            'sequence': sequence,
+            'sensors': {
+                'temperature_celsius': temperature / 100.0,
+                'humidity_percent': humidity / 100.0,
+                'distance_cm': distance,
+                'luminosity_lux': luminosity,
+                'presence_detected': distance < PRESENCE_DISTANCE_CM,
+            },
+            'battery_percent': battery,
+            'radio': {
+                'rssi_dbm': float(rssi),
+                'snr_db': snr_qdb / 4.0,
+            },
+        })
+    return readings
 
 
 def save_gateway_stats(data: Dict[str, Any]) -> None:
     """Save gateway statistics to database"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
-    
     gateway_id = data.get('gateway_id', 0)
     lora = data.get('lora_stats', {})
     server = data.get('server_stats', {})
     latency = data.get('latency', {})
     
-    cursor.execute('''
-        INSERT INTO gateway_stats (
-            gateway_id, timestamp, uptime_seconds,
-            rx_total, rx_valid, rx_invalid, rx_checksum_error, packet_loss_percent,
-            tx_total, tx_success, tx_failed, server_success_rate,
-            latency_avg_ms, latency_min_ms, latency_max_ms, latency_last_ms,
-            energy_mah, wifi_rssi
-        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
-    ''', (
+    row = (
         gateway_id,
         data.get('timestamp', datetime.utcnow().isoformat()),
         data.get('uptime_seconds', 0),
@@ -162,57 +432,96 @@ def save_gateway_stats(data: Dict[str, Any]) -> None:
         latency.get('last_ms', 0),
         data.get('energy_mah', 0),
         data.get('wifi_rssi')
-    ))
-    connection.commit()
-    connection.close()
+    )
+    with db_write() as cursor:
+        cursor.execute('''
+            INSERT INTO gateway_stats (
+                gateway_id, timestamp, uptime_seconds,
+                rx_total, rx_valid, rx_invalid, rx_checksum_error, packet_loss_percent,
+                tx_total, tx_success, tx_failed, server_success_rate,
+                latency_avg_ms, latency_min_ms, latency_max_ms, latency_last_ms,
+                energy_mah, wifi_rssi
+            ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+        ''', row)
     
     gateway_stats_cache[gateway_id] = data
 
 
-def check_and_generate_alerts(data: Dict[str, Any], connection: sqlite3.Connection) -> None:
-    """Check sensor data and generate alerts if thresholds are exceeded"""
-    cursor = connection.cursor()
+def sensor_alerts(data: Dict[str, Any]) -> List[Tuple]:
+    """Alert rows for a reading whose values exceed the thresholds (mock client posts only)"""
     node_id = data.get('node_id', 'unknown')
     sensors = data.get('sensors', data)
     battery = data.get('battery_percent', 100)
     timestamp = datetime.utcnow().isoformat()
+    alerts: List[Tuple] = []
     
     if sensors.get('presence_detected'):
-        cursor.execute('''
-            INSERT INTO alerts (timestamp, node_id, alert_type, message)
-            VALUES (?, ?, ?, ?)
-        ''', (timestamp, node_id, 'presence', f'Presence detected by {node_id}'))
+        alerts.append((timestamp, node_id, 'presence', f'Presence detected by {node_id}'))
     
     if battery is not None and battery < 20:
-        cursor.execute('''
-            INSERT INTO alerts (timestamp, node_id, alert_type, message)
-            VALUES (?, ?, ?, ?)
-        ''', (timestamp, node_id, 'low_battery', f'Low battery ({battery}%) on {node_id}'))
+        alerts.append((timestamp, node_id, 'low_battery', f'Low battery ({battery}%) on {node_id}'))
     
     humidity = sensors.get('humidity_percent')
     if humidity is not None and humidity > 80:
+        alerts.append((timestamp, node_id, 'high_humidity', f'High humidity ({humidity:.1f}%) on {node_id}'))
+    
+    return alerts
+
+
+def save_alert(payload: Dict[str, Any]) -> None:
+    """Store an alert sent on the gateway's alert lane (rule engine or node alert frame)"""
+    node_id = payload.get('node_id', 'unknown')
+    alert_type = payload.get('alert_type', 'unknown')
+    epoch_ms = payload.get('epoch_ms')
+    if epoch_ms and isinstance(epoch_ms, (int, float)):
+        timestamp = datetime.utcfromtimestamp(epoch_ms / 1000).isoformat()
+    else:
+        timestamp = datetime.utcnow().isoformat()
+    
+    value = payload.get('value')
+    source = 'gateway rule' if payload.get('source') == 'gateway' else 'node'
+    message = f"{alert_type.replace('_', ' ').capitalize()} ({value}) on {node_id} [{source}]"
+    
+    with db_write() as cursor:
         cursor.execute('''
             INSERT INTO alerts (timestamp, node_id, alert_type, message)
             VALUES (?, ?, ?, ?)
-        ''', (timestamp, node_id, 'high_humidity', f'High humidity ({humidity:.1f}%) on {node_id}'))
-    
-    connection.commit()
+        ''', (timestamp, node_id, alert_type, message))
+
+
+def queue_config_update(payload: Dict[str, Any]) -> None:
+    """Merge a settings update for a gateway (and its nodes) into the pending one"""
+    gateway_id = int(payload.get('gateway_id', 1))
+    with pending_config_lock:
+        pending = pending_config.setdefault(gateway_id, {})
+        if isinstance(payload.get('config'), dict):
+            pending.setdefault('config', {}).update(payload['config'])
+        if isinstance(payload.get('node_config'), list):
+            nodes = {entry['node_id']: entry for entry in pending.get('node_config', [])}
+            for entry in payload['node_config']:
+                if isinstance(entry, dict) and 'node_id' in entry:
+                    nodes.setdefault(entry['node_id'], {}).update(entry)
+            pending['node_config'] = list(nodes.values())
+
+
+def take_config_update(gateway_id: int) -> Dict[str, Any]:
+    """Pending settings for a gateway, removed once handed out"""
+    with pending_config_lock:
+        return pending_config.pop(gateway_id, {})
 
 
 def fetch_recent_data(limit: int = 100) -> List[Dict[str, Any]]:
     """Fetch recent sensor data from database"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
-    cursor.execute('''
-        SELECT 
-            node_id, timestamp, temperature_celsius, humidity_percent, distance_cm,
-            luminosity_lux, presence_detected, battery_percent, rssi_dbm, snr_db, gateway_id
-        FROM sensor_data 
-        ORDER BY timestamp DESC 
-        LIMIT ?
-    ''', (limit,))
-    rows = cursor.fetchall()
-    connection.close()
+    with db_read() as cursor:
+        cursor.execute('''
+            SELECT 
+                node_id, timestamp, temperature_celsius, humidity_percent, distance_cm,
+                luminosity_lux, presence_detected, battery_percent, rssi_dbm, snr_db, gateway_id
+            FROM sensor_data 
+            ORDER BY timestamp DESC 
+            LIMIT ?
+        ''', (limit,))
+        rows = cursor.fetchall()
 
     data_rows: List[Dict[str, Any]] = []
     for row in rows:
@@ -236,9 +545,6 @@ def fetch_recent_data(limit: int = 100) -> List[Dict[str, Any]]:
 
 def fetch_alerts(limit: int = 50, unacknowledged_only: bool = False) -> List[Dict[str, Any]]:
     """Fetch recent alerts from database"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
-    
     query = '''
         SELECT id, timestamp, node_id, alert_type, message, acknowledged
         FROM alerts
@@ -247,9 +553,9 @@ def fetch_alerts(limit: int = 50, unacknowledged_only: bool = False) -> List[Dic
         query += ' WHERE acknowledged = FALSE'
     query += ' ORDER BY timestamp DESC LIMIT ?'
     
-    cursor.execute(query, (limit,))
-    rows = cursor.fetchall()
-    connection.close()
+    with db_read() as cursor:
+        cursor.execute(query, (limit,))
+        rows = cursor.fetchall()
     
     return [{
         'id': row[0],
@@ -262,23 +568,29 @@ def fetch_alerts(limit: int = 50, unacknowledged_only: bool = False) -> List[Dic
 
 
 def fetch_historical_data(hours: int = 24) -> Dict[str, Any]:
-    """Fetch historical sensor data for charts"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
-    
-    since = (datetime.utcnow() - timedelta(hours=hours)).isoformat()
+    """Fetch historical sensor data for charts, averaged over all nodes per rollup bucket"""
+    table = 'sensor_rollup_minute' if hours <= ROLLUP_MINUTE_MAX_HOURS else 'sensor_rollup_hour'
+    bucket_length = ROLLUP_TABLES[table]
+    since = (datetime.utcnow() - timedelta(hours=hours)).isoformat()[:bucket_length]
     
-    cursor.execute('''
-        SELECT timestamp, humidity_percent, distance_cm, battery_percent
-        FROM sensor_data
-        WHERE timestamp >= ?
-        ORDER BY timestamp ASC
-    ''', (since,))
-    rows = cursor.fetchall()
-    connection.close()
+    with db_read() as cursor:
+        cursor.execute(f'''
+            SELECT bucket,
+                   SUM(humidity_sum) / NULLIF(SUM(humidity_count), 0),
+                   SUM(distance_sum) / NULLIF(SUM(distance_count), 0),
+                   SUM(battery_sum) / NULLIF(SUM(battery_count), 0)
+            FROM {table}
+            WHERE bucket >= ?
+            GROUP BY bucket
+            ORDER BY bucket ASC
+        ''', (since,))
+        rows = cursor.fetchall()
     
+    # Bucket start as a full ISO timestamp, like the raw rows
+    suffix = ':00' if bucket_length == 16 else ':00:00'
     return {
-        'timestamps': [row[0] for row in rows],
+        'resolution': 'minute' if bucket_length == 16 else 'hour',
+        'timestamps': [row[0] + suffix for row in rows],
         'humidity': [row[1] for row in rows],
         'distance': [row[2] for row in rows],
         'battery': [row[3] for row in rows]
@@ -287,19 +599,16 @@ def fetch_historical_data(hours: int = 24) -> Dict[str, Any]:
 
 def fetch_gateway_stats_history(gateway_id: int = 1, limit: int = 100) -> List[Dict[str, Any]]:
     """Fetch gateway statistics history"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
-    
-    cursor.execute('''
-        SELECT timestamp, uptime_seconds, rx_total, rx_valid, rx_invalid,
-               packet_loss_percent, latency_avg_ms, energy_mah
-        FROM gateway_stats
-        WHERE gateway_id = ?
-        ORDER BY timestamp DESC
-        LIMIT ?
-    ''', (gateway_id, limit))
-    rows = cursor.fetchall()
-    connection.close()
+    with db_read() as cursor:
+        cursor.execute('''
+            SELECT timestamp, uptime_seconds, rx_total, rx_valid, rx_invalid,
+                   packet_loss_percent, latency_avg_ms, energy_mah
+            FROM gateway_stats
+            WHERE gateway_id = ?
+            ORDER BY timestamp DESC
+            LIMIT ?
+        ''', (gateway_id, limit))
+        rows = cursor.fetchall()
     
     return [{
         'timestamp': row[0],
@@ -315,16 +624,27 @@ def fetch_gateway_stats_history(gateway_id: int = 1, limit: int = 100) -> List[D
 
 def fetch_active_nodes_count() -> int:
     """Count unique node IDs in the database"""
-    connection = sqlite3.connect(DB_PATH)
-    cursor = connection.cursor()
-    cursor.execute('SELECT COUNT(DISTINCT node_id) FROM sensor_data')
-    count = cursor.fetchone()[0]
-    connection.close()
+    with db_read() as cursor:
+        cursor.execute('SELECT COUNT(DISTINCT node_id) FROM sensor_data')
+        count = cursor.fetchone()[0]
     return count
 
 
 class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
     """HTTP request handler for sensor data"""
+
+    # HTTP/1.1 lets gateways keep one connection open across POSTs
+    protocol_version = 'HTTP/1.1'
+
+    def _send(self, code: int, body: bytes, content_type: str = 'text/plain', cors: bool = False) -> None:
+        """Send a complete response; Content-Length is required for keep-alive"""
+        self.send_response(code)
+        self.send_header('Content-type', content_type)
+        if cors:
+            self.send_header('Access-Control-Allow-Origin', '*')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
     
     def do_POST(self) -> None:
         """Handle POST requests for sensor data"""
@@ -340,9 +660,8 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
                 if isinstance(payload, list):
                     print(f"  [BATCH] Received {len(payload)} messages")
                     for item in payload:
-                        save_sensor_data(item)
                         print(f"    - Node: {item.get('node_id', 'unknown')}")
-                    saved_count = len(payload)
+                    saved_count = save_sensor_readings(payload)
                 else:
                     sensors = payload.get('sensors', payload)
                     print(f"  Node: {payload.get('node_id', 'unknown')}")
@@ -352,28 +671,49 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
                         print(f"  Distance: {sensors.get('distance_cm')} cm")
                     if 'presence_detected' in sensors:
                         print(f"  Presence: {'✓ DETECTED' if sensors.get('presence_detected') else 'No'}")
-                    save_sensor_data(payload)
-                    saved_count = 1
+                    saved_count = save_sensor_data(payload)
                 
-                self.send_response(200, 'OK')
-                self.send_header('Content-type', 'application/json')
-                self.end_headers()
-                response = {'status': 'success', 'message': f'{saved_count} message(s) stored'}
-                self.wfile.write(json.dumps(response).encode())
+                received_count = len(payload) if isinstance(payload, list) else 1
+                if saved_count < received_count:
+                    print(f"  [DEDUP] {received_count - saved_count} copies already stored from another gateway")
+                response = {'status': 'success', 'message': f'{saved_count} message(s) stored',
+                            'duplicates': received_count - saved_count}
+                self._send(200, json.dumps(response).encode(), 'application/json')
                 
             except json.JSONDecodeError as e:
                 print(f"Error: Invalid JSON - {e}")
-                self.send_response(400, 'Bad Request')
-                self.end_headers()
-                self.wfile.write(b'Invalid JSON')
+                self._send(400, b'Invalid JSON')
                 
             except Exception as e:
                 print(f"Error: {e}")
                 import traceback
                 traceback.print_exc()
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
+                
+        elif self.path == '/api/sensor-data/bin':
+            try:
+                content_length = int(self.headers.get('Content-Length', 0))
+                request_body = self.rfile.read(content_length)
+                
+                print(f"\n[{datetime.now().strftime('%Y-%m-%d %H:%M:%S')}] Binary POST received from {self.client_address[0]}")
+                
+                readings = decode_binary_batch(request_body)
+                print(f"  [BATCH] Received {len(readings)} messages ({len(request_body)} bytes)")
+                saved_count = save_sensor_readings(readings)
+                if saved_count < len(readings):
+                    print(f"  [DEDUP] {len(readings) - saved_count} copies already stored from another gateway")
+                
+                response = {'status': 'success', 'message': f'{saved_count} message(s) stored',
+                            'duplicates': len(readings) - saved_count}
+                self._send(200, json.dumps(response).encode(), 'application/json')
+                
+            except (ValueError, struct.error) as e:
+                print(f"Error: Invalid binary batch - {e}")
+                self._send(400, f'Invalid binary batch: {e}'.encode())
+                
+            except Exception as e:
+                print(f"Error: {e}")
+                self._send(500, f'Server error: {e}'.encode())
                 
         elif self.path == '/api/gateway-stats':
             try:
@@ -394,17 +734,44 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
                 
                 save_gateway_stats(payload)
                 
-                self.send_response(200, 'OK')
-                self.send_header('Content-type', 'application/json')
-                self.end_headers()
                 response = {'status': 'success', 'message': 'Stats received'}
-                self.wfile.write(json.dumps(response).encode())
+                update = take_config_update(int(payload.get('gateway_id', 1)))
+                if update:
+                    print(f"  Config update sent: {update}")
+                    response.update(update)
+                self._send(200, json.dumps(response).encode(), 'application/json')
                 
             except Exception as e:
                 print(f"Error saving gateway stats: {e}")
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
+                
+        elif self.path == '/api/config':
+            try:
+                content_length = int(self.headers.get('Content-Length', 0))
+                payload = json.loads(self.rfile.read(content_length))
+                queue_config_update(payload)
+                self._send(200, json.dumps({'status': 'queued'}).encode(), 'application/json', cors=True)
+                
+            except (json.JSONDecodeError, TypeError, ValueError) as e:
+                self._send(400, f'Invalid config update: {e}'.encode())
+                
+        elif self.path == '/api/alerts':
+            try:
+                content_length = int(self.headers.get('Content-Length', 0))
+                payload = json.loads(self.rfile.read(content_length))
+                
+                print(f"\n[{datetime.now().strftime('%Y-%m-%d %H:%M:%S')}] ALERT from gateway {payload.get('NODE_ID')}")
+                print(f"  {payload.get('alert_type')} on {payload.get('node_id')}: {payload.get('value')} "
+                      f"(severity {payload.get('severity')}, {payload.get('age_ms', 0)} ms at gateway)")
+                save_alert(payload)
+                self._send(200, json.dumps({'status': 'success'}).encode(), 'application/json')
+                
+            except (json.JSONDecodeError, AttributeError) as e:
+                self._send(400, f'Invalid alert: {e}'.encode())
+                
+            except Exception as e:
+                print(f"Error saving alert: {e}")
+                self._send(500, f'Server error: {e}'.encode())
                 
         elif self.path == '/api/alerts/acknowledge':
             try:
@@ -414,24 +781,15 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
                 alert_id = payload.get('id')
                 
                 if alert_id:
-                    connection = sqlite3.connect(DB_PATH)
-                    cursor = connection.cursor()
-                    cursor.execute('UPDATE alerts SET acknowledged = TRUE WHERE id = ?', (alert_id,))
-                    connection.commit()
-                    connection.close()
+                    with db_write() as cursor:
+                        cursor.execute('UPDATE alerts SET acknowledged = TRUE WHERE id = ?', (alert_id,))
                 
-                self.send_response(200, 'OK')
-                self.send_header('Content-type', 'application/json')
-                self.end_headers()
-                self.wfile.write(json.dumps({'status': 'success'}).encode())
+                self._send(200, json.dumps({'status': 'success'}).encode(), 'application/json')
                 
             except Exception as e:
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         else:
-            self.send_response(404, 'Not Found')
-            self.end_headers()
+            self._send(404, b'Not Found')
 
     def do_GET(self) -> None:
         """Handle GET requests"""
@@ -445,42 +803,24 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
             try:
                 recent_data = fetch_recent_data()
                 
-                self.send_response(200)
-                self.send_header('Content-type', 'application/json')
-                self.send_header('Access-Control-Allow-Origin', '*')
-                self.end_headers()
-                self.wfile.write(json.dumps(recent_data).encode())
+                self._send(200, json.dumps(recent_data).encode(), 'application/json', cors=True)
             except Exception as e:
                 print(f"Error: {e}")
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         
         elif self.path == '/api/alerts':
             try:
                 alerts = fetch_alerts(50, False)
-                self.send_response(200)
-                self.send_header('Content-type', 'application/json')
-                self.send_header('Access-Control-Allow-Origin', '*')
-                self.end_headers()
-                self.wfile.write(json.dumps(alerts).encode())
+                self._send(200, json.dumps(alerts).encode(), 'application/json', cors=True)
             except Exception as e:
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         
         elif self.path == '/api/alerts/unacknowledged':
             try:
                 alerts = fetch_alerts(50, True)
-                self.send_response(200)
-                self.send_header('Content-type', 'application/json')
-                self.send_header('Access-Control-Allow-Origin', '*')
-                self.end_headers()
-                self.wfile.write(json.dumps(alerts).encode())
+                self._send(200, json.dumps(alerts).encode(), 'application/json', cors=True)
             except Exception as e:
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         
         elif self.path.startswith('/api/history'):
             try:
@@ -492,15 +832,9 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
                             hours = int(param.split('=')[1])
                 
                 history = fetch_historical_data(hours)
-                self.send_response(200)
-                self.send_header('Content-type', 'application/json')
-                self.send_header('Access-Control-Allow-Origin', '*')
-                self.end_headers()
-                self.wfile.write(json.dumps(history).encode())
+                self._send(200, json.dumps(history).encode(), 'application/json', cors=True)
             except Exception as e:
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         
         elif self.path == '/api/gateway-stats':
             try:
@@ -508,52 +842,30 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
                 if not stats_list:
                     stats_list = fetch_gateway_stats_history(1, 1)
                 
-                self.send_response(200)
-                self.send_header('Content-type', 'application/json')
-                self.send_header('Access-Control-Allow-Origin', '*')
-                self.end_headers()
-                self.wfile.write(json.dumps(stats_list).encode())
+                self._send(200, json.dumps(stats_list).encode(), 'application/json', cors=True)
             except Exception as e:
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         
         elif self.path == '/api/gateway-stats/history':
             try:
                 history = fetch_gateway_stats_history(1, 100)
-                self.send_response(200)
-                self.send_header('Content-type', 'application/json')
-                self.send_header('Access-Control-Allow-Origin', '*')
-                self.end_headers()
-                self.wfile.write(json.dumps(history).encode())
+                self._send(200, json.dumps(history).encode(), 'application/json', cors=True)
             except Exception as e:
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         
         elif self.path == '/api/stats':
             try:
                 active_nodes = fetch_active_nodes_count()
-                self.send_response(200)
-                self.send_header('Content-type', 'application/json')
-                self.send_header('Access-Control-Allow-Origin', '*')
-                self.end_headers()
-                self.wfile.write(json.dumps({'active_nodes': active_nodes}).encode())
+                stats = {'active_nodes': active_nodes, 'dedup': dict(dedup_stats),
+                         'dedup_cache_entries': len(recent_readings)}
+                self._send(200, json.dumps(stats).encode(), 'application/json', cors=True)
             except Exception as e:
-                self.send_response(500, 'Internal Server Error')
-                self.end_headers()
-                self.wfile.write(f'Server error: {e}'.encode())
+                self._send(500, f'Server error: {e}'.encode())
         
         elif self.path == '/health':
-            self.send_response(200)
-            self.send_header('Content-type', 'application/json')
-            self.end_headers()
-            self.wfile.write(json.dumps({'status': 'ok'}).encode())
+            self._send(200, json.dumps({'status': 'ok'}).encode(), 'application/json')
         
         elif self.path == '/api/sensor-data':
-            self.send_response(200)
-            self.send_header('Content-type', 'text/html')
-            self.end_headers()
             info = b"""
             <html>
             <head><title>API Endpoint</title></head>
@@ -565,7 +877,7 @@ class SensorServerHandler(http.server.SimpleHTTPRequestHandler):
             </body>
             </html>
             """
-            self.wfile.write(info)
+            self._send(200, info, 'text/html')
         
         else:
             super().do_GET()
@@ -584,7 +896,10 @@ def start_server() -> None:
     
     initialize_database()
     
-    with socketserver.TCPServer((HOST, PORT), SensorServerHandler) as httpd:
+    # One thread per connection: keep-alive gateways must not block the dashboard
+    socketserver.ThreadingTCPServer.allow_reuse_address = True
+    socketserver.ThreadingTCPServer.daemon_threads = True
+    with socketserver.ThreadingTCPServer((HOST, PORT), SensorServerHandler) as httpd:
         print(f"\n{'='*60}")
         print(f"  Sensor Data Server")
         print(f"{'='*60}")